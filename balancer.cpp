@@ -1,6 +1,7 @@
 
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
@@ -14,10 +15,14 @@
 #include <arpa/inet.h>  /* for sockaddr_in and inet_ntoa() */
 #include <sys/ipc.h> 
 #include <sys/msg.h> 
+#include <sys/time.h>
+#include <pthread.h>
+#include <poll.h>
 
 using namespace std;
 
 #define BASEPORT 5200
+#define RELAYPORT (BASEPORT + 600) // the relay of GPU g listens on RELAYPORT+g
 #define CONFIG_LINE_BUFFER_SIZE 50000
 
 #define EXEC 1
@@ -29,8 +34,11 @@ using namespace std;
 
 #define READS 1
 #define WRITES 2
-#define BUS_BASE_SIZE	(1*1024) // 1K cells
-#define BUFFER_SIZE (2*BUS_BASE_SIZE)
+#define RING_CAPACITY	(1024*1024) // 1M cells (8MB), must be a power of two
+#define RING_REPORT_CELLS	(16*1024*1024) // statistics every 16M cells
+
+#define RELAY_COPY 0    // cells pass through the user space ring
+#define RELAY_SPLICE 1  // bytes are moved kernel-side with splice() through a pipe
 
 //#define WORKDIR "/home/users/marcofigueiredo/dynbp/work"
 //#define SHAREDIR "/home/users/marcofigueiredo/dynbp/share"
@@ -40,12 +48,11 @@ int socketfd;
 int socketfdwrite;
 string hostname = "192.168.0.87";
 int port;
-int totalwrite = 0;
-int totalread = 0;
+long long totalwrite = 0;
+long long totalread = 0;
 char controlleradd[16];
 int comma = 0;
 string filename2;
-pthread_mutex_t lock;
 
 typedef struct {
 	int h;
@@ -55,13 +62,59 @@ typedef struct {
 	};
 } __attribute__ ((aligned (8))) cell_t;
 
-struct cell_list {
-	cell_t cell;
-	cell_list * next;
-};
-
-cell_t * bufferin, * bufferout;
-cell_list * head, * tail;
+/*
+ * Single-producer/single-consumer ring of cells between the reading thread
+ * (producer) and the writing thread (consumer). The positions are free
+ * running counters: ringTail is only written by the producer and ringHead
+ * only by the consumer, so no lock is needed. The cells are received
+ * directly into the free slots and sent directly from the filled slots.
+ * A thread that finds the ring full (or empty) sleeps on ringCond until
+ * the other one moves its position; the mutex is only taken to sleep and
+ * to wake a sleeping thread.
+ */
+cell_t * ring;
+volatile long long ringHead = 0;  // next cell to be sent
+volatile long long ringTail = 0;  // next cell to be received
+volatile int ringClosed = 0;      // producer has finished or consumer failed
+volatile int ringReaderWaiting = 0;
+volatile int ringWriterWaiting = 0;
+pthread_mutex_t ringMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ringCond = PTHREAD_COND_INITIALIZER;
+
+/* ring statistics */
+long long ringFullWaits = 0;      // times the producer found the ring full
+long long ringEmptyWaits = 0;     // times the consumer found the ring empty
+long long ringPeak = 0;           // maximum number of cells in the ring
+long long ringRecvCalls = 0;
+long long ringSendCalls = 0;
+double ringReadStart = 0;
+double ringWriteStart = 0;
+
+/*
+ * Relay mode, selected by the controller with the --relay=copy|splice token
+ * of the EXEC command. In splice mode the ring is not used: the reading
+ * thread splices the socket into a pipe and the writing thread splices the
+ * pipe into the downstream socket, so the pipe is the bounded buffer and
+ * the cells are never copied to the user space.
+ *
+ * The relay connects to the column socket of the local CUDAlign (upstream)
+ * and listens on RELAYPORT+gpu for the CUDAlign of the next GPU
+ * (downstream). These sockets are not the control connection to the
+ * controller (socketfdread).
+ */
+int relaymode = RELAY_COPY;
+int relaypipe[2] = {-1, -1};
+int relaypipesize = 0;
+int relaystarted = 0;
+int relayfdread = -1;   // upstream: column socket of the local CUDAlign
+int relayfdwrite = -1;  // downstream: CUDAlign of the next GPU
+int relayupstreamport;
+int relaylistenport;
+pthread_t relaythread;
+int ringReadPartial = 0;  // bytes of the next cell already received
+int ringWritePartial = 0; // bytes of the next cell already sent
+long long spliceBytesRead = 0;
+long long spliceBytesWritten = 0;
 
 int decode(char instruct[4]) {
         //printf ("\n\n ### Balancer: instruct: #%s# \n", instruct);
@@ -83,27 +136,160 @@ void closeSocket(int socketfd) {
     }
 }
 
-int readSocket(cell_t* buf, int len) {
-    int pos = 0;
-    while (pos < len*sizeof(cell_t)) {
-    	int ret = recv(socketfdread, (void*)(((unsigned char*)buf)+pos), len*sizeof(cell_t), 0);
-        if (ret == -1) {
-        	closeSocket(socketfdread);
+double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+long long ringLoad(volatile long long * pos) {
+    return __atomic_load_n(pos, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Publishes a new position and wakes the other thread if it sleeps. The
+ * store and the flag load are sequentially consistent, as are the flag
+ * store and the position load of ringWait, so either the sleeping thread
+ * sees the new position or this one sees its flag.
+ */
+void ringStore(volatile long long * pos, long long value, volatile int * waiting) {
+    __atomic_store_n(pos, value, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&ringMutex);
+        pthread_cond_broadcast(&ringCond);
+        pthread_mutex_unlock(&ringMutex);
+    }
+}
+
+/*
+ * Closes the ring and wakes both threads.
+ */
+void ringClose() {
+    __atomic_store_n(&ringClosed, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&ringMutex);
+    pthread_cond_broadcast(&ringCond);
+    pthread_mutex_unlock(&ringMutex);
+}
+
+/*
+ * Sleeps while the position of the other thread is still value and the
+ * ring is open.
+ */
+void ringWait(volatile long long * pos, long long value, volatile int * waiting) {
+    pthread_mutex_lock(&ringMutex);
+    __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(pos, __ATOMIC_SEQ_CST) == value
+            && !__atomic_load_n(&ringClosed, __ATOMIC_SEQ_CST))
+        pthread_cond_wait(&ringCond, &ringMutex);
+    __atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ringMutex);
+}
+
+void printRingStatistics(const char * who) {
+    double t = now();
+    if (relaymode == RELAY_SPLICE) {
+        double rt = (ringReadStart > 0) ? t - ringReadStart : 0;
+        double wt = (ringWriteStart > 0) ? t - ringWriteStart : 0;
+        printf ("Balancer: %s splice read: %lld cells (%.2f MB/s, %lld splice), "
+                "write: %lld cells (%.2f MB/s, %lld splice), pipe: %d bytes \n",
+                who,
+                totalread, rt > 0 ? spliceBytesRead/rt/1048576.0 : 0, ringRecvCalls,
+                totalwrite, wt > 0 ? spliceBytesWritten/wt/1048576.0 : 0, ringSendCalls,
+                relaypipesize);
+        return;
+    }
+    double rt = (ringReadStart > 0) ? t - ringReadStart : 0;
+    double wt = (ringWriteStart > 0) ? t - ringWriteStart : 0;
+    printf ("Balancer: %s read: %lld cells (%.2f MB/s, %lld recv), "
+            "write: %lld cells (%.2f MB/s, %lld send), "
+            "ring: %lld/%d peak, %lld full waits, %lld empty waits \n",
+            who,
+            totalread, rt > 0 ? totalread*sizeof(cell_t)/rt/1048576.0 : 0, ringRecvCalls,
+            totalwrite, wt > 0 ? totalwrite*sizeof(cell_t)/wt/1048576.0 : 0, ringSendCalls,
+            ringPeak, RING_CAPACITY, ringFullWaits, ringEmptyWaits);
+}
+
+/*
+ * Receives cells from the socket directly into the free slots of the ring.
+ * Blocks while the ring is full (backpressure on the sender). Returns the
+ * number of cells published, or -1 when the connection is finished or the
+ * writing thread failed.
+ * A partial cell received by recv stays in its slot until it is completed.
+ */
+int readSocket() {
+    int partial = ringReadPartial;
+
+    long long tail = ringTail;
+    long long used = tail - ringLoad(&ringHead);
+    while (used == RING_CAPACITY) {
+        if (__atomic_load_n(&ringClosed, __ATOMIC_ACQUIRE))
+            return -1;
+        ringFullWaits++;
+        ringWait(&ringHead, tail - RING_CAPACITY, &ringReaderWaiting);
+        used = tail - ringLoad(&ringHead);
+    }
+    int pos = tail & (RING_CAPACITY-1);
+    int span = RING_CAPACITY - used;
+    if (span > RING_CAPACITY - pos)
+        span = RING_CAPACITY - pos;
+
+    unsigned char * dst = ((unsigned char*)(ring+pos)) + partial;
+    int ret = recv(relayfdread, dst, span*sizeof(cell_t) - partial, 0);
+    ringRecvCalls++;
+    if (ret <= 0) {
+        if (ret == -1)
             fprintf(stderr, "recv: Socket error -1\n");
-            break;
-        }
-        pos += ret;
+        return -1;
+    }
+    int cells = (partial + ret) / sizeof(cell_t);
+    ringReadPartial = (partial + ret) % sizeof(cell_t);
+    if (cells > 0) {
+        ringStore(&ringTail, tail + cells, &ringWriterWaiting);
+        if (used + cells > ringPeak)
+            ringPeak = used + cells;
     }
-    return pos/sizeof(cell_t);
+    return cells;
 }
 
-int writeSocket(const cell_t* buf, int len) {
-    int ret = send(socketfdwrite, buf, len*sizeof(cell_t), 0);
+/*
+ * Sends the filled slots of the ring directly to the socket. Blocks while
+ * the ring is empty. Returns the number of cells released, or -1 when the
+ * producer has finished and the ring was drained.
+ */
+int writeSocket() {
+    int partial = ringWritePartial;
+
+    long long head = ringHead;
+    long long avail = ringLoad(&ringTail) - head;
+    while (avail == 0) {
+        if (__atomic_load_n(&ringClosed, __ATOMIC_ACQUIRE)) {
+            avail = ringLoad(&ringTail) - head;
+            if (avail == 0)
+                return -1;
+            break;
+        }
+        ringEmptyWaits++;
+        ringWait(&ringTail, head, &ringWriterWaiting);
+        avail = ringLoad(&ringTail) - head;
+    }
+    int pos = head & (RING_CAPACITY-1);
+    int span = avail;
+    if (span > RING_CAPACITY - pos)
+        span = RING_CAPACITY - pos;
+
+    const unsigned char * src = ((const unsigned char*)(ring+pos)) + partial;
+    int ret = send(relayfdwrite, src, span*sizeof(cell_t) - partial, MSG_NOSIGNAL);
+    ringSendCalls++;
     if (ret == -1) {
         fprintf(stderr, "send: Socket error: -1\n");
-        return 0;
+        ringClose(); // the reading thread must not wait for space
+        return -1;
     }
-    return ret;
+    int cells = (partial + ret) / sizeof(cell_t);
+    ringWritePartial = (partial + ret) % sizeof(cell_t);
+    if (cells > 0)
+        ringStore(&ringHead, head + cells, &ringReaderWaiting);
+    return cells;
 }
 
 
@@ -132,18 +318,14 @@ int resolveDNS(const char * hostname , char* ip) {
 }
 
 
- void initSocketRead() {
+/*
+ * Connects to addr:portread, retrying while the server is not listening.
+ * Returns the connected socket.
+ */
+ int connectSocket(const char * addr, int portread) {
     int rc;
     int sock;                        // Socket descriptor
     struct sockaddr_in echoServAddr; // Echo server address
-    int new_socket, server_fd; 
-    struct sockaddr_in address;
-    int addrlen = sizeof(controlleradd);
-
-    int opt = 1;
-
-
-    int portread = BASEPORT + 501;
 
     //printf (" \n\n *** DEBUG 1 ***");
 
@@ -170,7 +352,7 @@ int resolveDNS(const char * hostname , char* ip) {
     // Construct the server address structure
     memset(&echoServAddr, 0, sizeof(echoServAddr));     // Zero out structure
     echoServAddr.sin_family      = AF_INET;             // Internet address family
-    echoServAddr.sin_addr.s_addr = inet_addr(controlleradd);   // Server IP address
+    echoServAddr.sin_addr.s_addr = inet_addr(addr);   // Server IP address
     echoServAddr.sin_port        = htons(portread); // Server port
 
     // Establish the connection to the echo server
@@ -181,7 +363,7 @@ int resolveDNS(const char * hostname , char* ip) {
     while ((retries < max_retries) && !ok) {
 		if ((rc=connect(sock, (struct sockaddr *) &echoServAddr, sizeof(echoServAddr))) < 0) {
 			if (retries % 100 == 0) {
-				fprintf(stderr, "!!!!! ERROR connecting to Server %s:%d [Retry %d/%d]. %s\n", controlleradd, portread,
+				fprintf(stderr, "!!!!! ERROR connecting to Server %s:%d [Retry %d/%d]. %s\n", addr, portread,
 						retries, max_retries, strerror(errno));
 			}
 			retries++;
@@ -194,21 +376,26 @@ int resolveDNS(const char * hostname , char* ip) {
 		fprintf(stderr, "ERROR connecting to Server. Aborting\n");
 		exit(-1);
 	}
-    fprintf(stderr, "\n *** DEBUG: Connected to Server %s\n", inet_ntoa(echoServAddr.sin_addr));
-    
+    fprintf(stderr, "\n *** DEBUG: Connected to Server %s:%d\n", inet_ntoa(echoServAddr.sin_addr), portread);
 
-    socketfdread = sock;
+    return sock;
+}
+
+/*
+ * Connects to the control listener of the controller, used to send the
+ * READ and END messages.
+ */
+ void initSocketRead() {
+    socketfdread = connectSocket(controlleradd, BASEPORT + 501);
 }
 
- void initSocketWrite() {
+/*
+ * Creates a socket listening on portwrite. Returns the listening socket.
+ */
+ int listenSocket(int portwrite) {
      int rc;
      int servSock;                    /* Socket descriptor for server */
-     int clntSock;                    /* Socket descriptor for client */
      struct sockaddr_in echoServAddr; /* Local address */
-     struct sockaddr_in ClntAddr; /* Client address */
-     struct sockaddr_in ControlAddr; /* Controller address */
-     unsigned int clntLen;            /* Length of client address data structure */
-     int portwrite = BASEPORT + 501;
 
      if (DEBUG) printf("SocketCellsWriter: create socket\n");
 
@@ -244,6 +431,17 @@ int resolveDNS(const char * hostname , char* ip) {
      else
        printf ("\n Balancer: listening for connections on port %d \n", portwrite);
 
+     return servSock;
+ }
+
+/*
+ * Waits for a client on the listening socket servSock, which is closed.
+ * Returns the connected socket.
+ */
+ int acceptSocket(int servSock) {
+     int clntSock;                    /* Socket descriptor for client */
+     struct sockaddr_in ClntAddr; /* Client address */
+     unsigned int clntLen;            /* Length of client address data structure */
 
      /* Set the size of the in-out parameter */
      clntLen = sizeof(ClntAddr);
@@ -261,7 +459,7 @@ int resolveDNS(const char * hostname , char* ip) {
 
      closeSocket(servSock);
 
-     socketfdwrite = clntSock;
+     return clntSock;
  }
 
 
@@ -269,40 +467,20 @@ void * readcell (void * x ) {
 
    printf ("Balancer: reading thread initiated! \n");
 
-   initSocketRead();
-
+   ringReadStart = now();
+   long long nextReport = RING_REPORT_CELLS;
    int ret;
 
-   int flag = 0;
-
-   while (1) {
-           
-	   ret = readSocket(bufferin, BUS_BASE_SIZE);
-           totalread = totalread + ret;
-	   for (int i=0; i<ret; i++) {
-		  cell_list * p = (cell_list *) malloc (sizeof(cell_list));
-                  if (! p)
-                    printf ("\n\n\n ### Balancer: Allocation error! ### \n\n");
-		  memcpy(&p->cell, bufferin+i*sizeof(cell_t), sizeof(cell_t));
-		  p->next = NULL;
-                  if (!flag) {
-                     printf ("\n\n Balancer: h read: %d \n", p->cell.h);
-                     flag = 1;
-                  }
-
-		  pthread_mutex_lock(&lock);
-
-		  if (head == NULL)
-			  head = p;
-		  else
-			  tail->next = p;
-		  tail = p;
-
-		  pthread_mutex_unlock(&lock);
-	   }
-         flag = 0;
-         printf ("Balancer: READ %d cells, Total: %d cells \n", ret, totalread);
+   while ((ret = readSocket()) >= 0) {
+         totalread = totalread + ret;
+         if (totalread >= nextReport) {
+            printRingStatistics("READ");
+            nextReport += RING_REPORT_CELLS;
+         }
    }
+   ringClose();
+   printf ("Balancer: READ finished, Total: %lld cells \n", totalread);
+   return NULL;
 }
 
 
@@ -312,40 +490,214 @@ void * writecell (void * x ) {
 
    printf ("Balancer: writing thread initiated! \n");
 
-   initSocketWrite();
+   ringWriteStart = now();
+   long long nextReport = RING_REPORT_CELLS;
+   int ret;
 
-     cell_list * aux;
+   while ((ret = writeSocket()) >= 0) {
+         totalwrite = totalwrite + ret;
+         if (totalwrite >= nextReport) {
+            printRingStatistics("WRITE");
+            nextReport += RING_REPORT_CELLS;
+         }
+   }
+   printf("Balancer: WRITE finished, Total: %lld cells \n", totalwrite);
+   return NULL;
+}
+
+
+/*
+ * Moves the bytes of the upstream socket into the relay pipe. The thread
+ * waits while the pipe is full, which is the backpressure of this mode.
+ * A blocking splice from the socket keeps the pipe locked while it waits
+ * for data, stalling the writing thread, so the call is non-blocking and
+ * only made when the pipe has space and the socket has data.
+ */
+void * splicereadcell (void * x ) {
 
-    int flag = 0;
+   printf ("Balancer: splice reading thread initiated! \n");
+
+   ringReadStart = now();
+   long long nextReport = RING_REPORT_CELLS;
+   struct pollfd space = {relaypipe[1], POLLOUT, 0};
+   struct pollfd data = {relayfdread, POLLIN, 0};
 
    while (1) {
-      
-
-      int i = 0;
-
-      pthread_mutex_lock(&lock);
-      aux = head;
-      while ((aux != NULL) && (i < BUS_BASE_SIZE)) {
-    	  memcpy (bufferout+i*sizeof(cell_t), &head->cell, sizeof(cell_t));
-          if (!flag) {
-             printf ("\n\n Balancer: h write: %d \n", head->cell.h);             
-             flag = 1;
-          }
-    	  head = head->next;
-    	  free (aux);
-    	  aux = head;
-    	  i++;
-          totalwrite++;
-      }
-      flag = 0;
-      if (aux == NULL)
-         tail = NULL;
-      pthread_mutex_unlock(&lock);
-
-     int ret = writeSocket(bufferout, i);
-     printf("Balancer: WRITE %d cells , Total: %d \n", i, totalwrite);
+         poll(&space, 1, -1);
+         poll(&data, 1, -1);
+         ssize_t ret = splice(relayfdread, NULL, relaypipe[1], NULL,
+                 RING_CAPACITY*sizeof(cell_t), SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+         if (ret == -1 && (errno == EINTR || errno == EAGAIN))
+            continue;
+         if (ret <= 0) {
+            if (ret == -1)
+               fprintf(stderr, "splice: Socket error: %s\n", strerror(errno));
+            break;
+         }
+         ringRecvCalls++;
+         spliceBytesRead += ret;
+         totalread = spliceBytesRead / sizeof(cell_t);
+         if (totalread >= nextReport) {
+            printRingStatistics("READ");
+            nextReport += RING_REPORT_CELLS;
+         }
+   }
+   close(relaypipe[1]); // the writing thread sees the end of the pipe
+   printf ("Balancer: READ finished, Total: %lld cells \n", totalread);
+   return NULL;
+}
+
+/*
+ * Moves the bytes of the relay pipe into the downstream socket until the
+ * reading thread closes the pipe.
+ */
+void * splicewritecell (void * x ) {
+
+   printf ("Balancer: splice writing thread initiated! \n");
 
+   ringWriteStart = now();
+   long long nextReport = RING_REPORT_CELLS;
+
+   while (1) {
+         ssize_t ret = splice(relaypipe[0], NULL, relayfdwrite, NULL,
+                 RING_CAPACITY*sizeof(cell_t), SPLICE_F_MOVE | SPLICE_F_MORE);
+         if (ret == -1 && errno == EINTR)
+            continue;
+         if (ret <= 0) {
+            if (ret == -1)
+               fprintf(stderr, "splice: Socket error: %s\n", strerror(errno));
+            break;
+         }
+         ringSendCalls++;
+         spliceBytesWritten += ret;
+         totalwrite = spliceBytesWritten / sizeof(cell_t);
+         if (totalwrite >= nextReport) {
+            printRingStatistics("WRITE");
+            nextReport += RING_REPORT_CELLS;
+         }
    }
+   close(relaypipe[0]);
+   printf("Balancer: WRITE finished, Total: %lld cells \n", totalwrite);
+   return NULL;
+}
+
+/*
+ * Runs one relay: connects the upstream and downstream sockets, starts the
+ * reading and writing threads of the selected relay mode and forwards the
+ * messages of the downstream CUDAlign (the "finished" confirmation) back to
+ * the upstream one until the downstream connection is closed.
+ */
+void * relaycell (void * x ) {
+    pthread_t thrread, thrwrite;
+    char back[64];
+
+    // listens before connecting, so the next GPU may connect meanwhile
+    int servSock = listenSocket(relaylistenport);
+    relayfdread = connectSocket("127.0.0.1", relayupstreamport);
+    relayfdwrite = acceptSocket(servSock);
+
+    if (relaymode == RELAY_SPLICE) {
+        pthread_create(&thrread, NULL, splicereadcell, (void *) NULL);
+        pthread_create(&thrwrite, NULL, splicewritecell, (void *) NULL);
+    } else {
+        pthread_create(&thrread, NULL, readcell, (void *) NULL);
+        pthread_create(&thrwrite, NULL, writecell, (void *) NULL);
+    }
+
+    int ret;
+    while ((ret = recv(relayfdwrite, back, sizeof(back), 0)) > 0) {
+        if (send(relayfdread, back, ret, MSG_NOSIGNAL) == -1)
+            break;
+    }
+    // the upstream CUDAlign sees the disconnection if "finished" was not sent
+    shutdown(relayfdread, SHUT_WR);
+
+    pthread_join(thrread, NULL);
+    pthread_join(thrwrite, NULL);
+    printRingStatistics("END");
+    closeSocket(relayfdread);
+    closeSocket(relayfdwrite);
+    return NULL;
+}
+
+/*
+ * Starts the relay of the column flushed by the local CUDAlign on
+ * upstreamport to the next GPU, which connects to listenport. The relay of
+ * the previous EXEC is finished first. If the pipe of the splice mode
+ * cannot be created, the copy mode is used.
+ */
+void startRelay(int upstreamport, int listenport) {
+    if (relaystarted)
+        pthread_join(relaythread, NULL);
+    relaystarted = 1;
+
+    ringHead = 0;
+    ringTail = 0;
+    ringClosed = 0;
+    ringReaderWaiting = ringWriterWaiting = 0;
+    ringReadPartial = 0;
+    ringWritePartial = 0;
+    ringFullWaits = ringEmptyWaits = ringPeak = 0;
+    ringRecvCalls = ringSendCalls = 0;
+    ringReadStart = ringWriteStart = 0;
+    spliceBytesRead = spliceBytesWritten = 0;
+    totalread = totalwrite = 0;
+    relayupstreamport = upstreamport;
+    relaylistenport = listenport;
+
+    if (relaymode == RELAY_SPLICE) {
+        if (pipe(relaypipe) == -1) {
+            fprintf(stderr, "Balancer: cannot create the relay pipe (%s). Using copy relay.\n", strerror(errno));
+            relaymode = RELAY_COPY;
+        } else {
+            // a larger pipe reduces the number of splice calls; the size is
+            // halved until it is accepted (limited by /proc/sys/fs/pipe-max-size)
+            int size = RING_CAPACITY*sizeof(cell_t);
+            while (size > 65536 && fcntl(relaypipe[1], F_SETPIPE_SZ, size) == -1)
+                size /= 2;
+            relaypipesize = fcntl(relaypipe[1], F_GETPIPE_SZ);
+        }
+    }
+    printf ("Balancer: starting %s relay from port %d to port %d \n",
+            relaymode == RELAY_SPLICE ? "splice" : "copy", upstreamport, listenport);
+    pthread_create(&relaythread, NULL, relaycell, (void *) NULL);
+}
+
+/*
+ * Returns the port of the --flush-column=socket://HOST:PORT token of the
+ * command, or -1 if the column is not flushed to a socket.
+ */
+int flushSocketPort(const char * cmd) {
+    const char * p = strstr(cmd, "--flush-column=socket://");
+    if (p == NULL)
+        return -1;
+    p = strchr(p + 24, ':');
+    if (p == NULL)
+        return -1;
+    return atoi(p + 1);
+}
+
+/*
+ * Removes the --relay=MODE token from the command, selecting the relay
+ * mode. The token is only meaningful to the balancer. Returns 1 if the
+ * command has the token.
+ */
+int parseRelayMode(char * cmd) {
+    char * p = strstr(cmd, " --relay=");
+    if (p == NULL)
+        return 0;
+    char * value = p + 9;
+    int len = 0;
+    while (value[len] != ' ' && value[len] != '\0')
+        len++;
+    if (len == 6 && strncmp(value, "splice", 6) == 0)
+        relaymode = RELAY_SPLICE;
+    else if (len == 4 && strncmp(value, "copy", 4) == 0)
+        relaymode = RELAY_COPY;
+    else
+        fprintf(stderr, "Balancer: unknown relay mode %.*s. Using copy relay.\n", len, value);
+    memmove(p, value + len, strlen(value + len) + 1);
+    return 1;
 }
 
 
@@ -392,22 +744,17 @@ int main(int argc, char const *argv[])
     //char car;
     std::ostringstream np;
 
-    pthread_mutexattr_t mutexattr;
-    pthread_mutexattr_init(&mutexattr);
-    pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE_NP);
-    pthread_mutex_init(&lock, &mutexattr);
-
-
-    head = NULL;
-    tail = NULL;
 
     //FILE * fpread;
     std::ostringstream ss;
     string filename;
     //int vgpu;
 
-    bufferin = (cell_t*)malloc(BUFFER_SIZE*sizeof(cell_t));
-    bufferout = (cell_t*)malloc(BUFFER_SIZE*sizeof(cell_t));
+    ring = (cell_t*)malloc(RING_CAPACITY*sizeof(cell_t));
+    if (ring == NULL) {
+        fprintf(stderr, "Balancer: cannot allocate the cells ring\n");
+        exit(EXIT_FAILURE);
+    }
 
     int gpu = atoi(argv[1]);
     char WORKDIR[100];
@@ -480,6 +827,7 @@ int main(int argc, char const *argv[])
           instruct[k] = ' ';
         memset(new_command, 0, sizeof(new_command));
     	strncpy(new_command,command+k+1,strlen(command)-k);
+        int relay = parseRelayMode(new_command);
 
         //printf("New command: %s \n", new_command);
 
@@ -552,6 +900,9 @@ int main(int argc, char const *argv[])
     	switch (decode(instruct)) {
     	case EXEC:
     	    system(new_command);
+            // the controller requests a relay of the column flushed to the next GPU
+            if (relay && flushSocketPort(new_command) > 0)
+               startRelay(flushSocketPort(new_command), RELAYPORT + gpu);
             //string filename2;
             if (DEBUG) printf ("\n\n *** numpart: %d, numgpus: %d,  mod: %d \n", numpart, numgpus, numpart%numgpus);
             if ((strstr(new_command, flushsocket)==NULL)) { //last GPU
@@ -598,13 +949,11 @@ int main(int argc, char const *argv[])
     	    system(new_command);
     	    break;
     	case READ:
-    		//printf ("\n\n *** Initiating writing thread... *** \n\n");
-    		//if (!wr) {
-    		//   pthread_create(&thrwrite, NULL, writecell, (void *) NULL);
-    		//   wr = 1;
-    		//}
+    		// the relay is started by EXEC (see startRelay)
             break;
     	case END:
+    		if (totalread > 0)
+    		   printRingStatistics("END");
     		close(new_socket);
     		close(socketfdread);
     		//close(socketfdwrite);
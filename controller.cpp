@@ -36,7 +36,9 @@ using namespace std;
 #define MODEL 7
 #define PROG 8
 #define GFLOPS 9
+#define RELAY 10
 #define BASEPORT 5200
+#define RELAYPORT (BASEPORT + 600) // the balancer relay of GPU g listens on RELAYPORT+g
 #define ERROR -1
 
 #define READS 1
@@ -44,6 +46,7 @@ using namespace std;
 
 #define DEBUG 0
 #define LIMIT 2
+#define MIN_COMPUTED 0.05 // bounds the weight gained by a heavily pruned partition
 
 typedef struct {
 	int h;
@@ -69,6 +72,8 @@ struct config_struct {
     char model[MAX_CONFIG_VARIABLE_LEN];
     char prog[MAX_CONFIG_VARIABLE_LEN];
     char gflops[MAX_GPUS][MAX_IP_LEN];
+    char relay[MAX_IP_LEN]; // balancer relay mode: none, copy or splice
+    int shm; // neighbours of the same host exchange columns by shared memory
 
 } config;
 
@@ -118,6 +123,8 @@ void read_str_from_config_line(char* config_line, int op) {
         sscanf(tok, "%s", config.model);
     else if (op == PROG)
         sscanf(tok, "%s", config.prog);
+    else if (op == RELAY)
+        sscanf(tok, "%14s", config.relay);
     else {
     	int count = 0;
     	while ((tok != NULL) && (count < MAX_GPUS)) {
@@ -144,6 +151,8 @@ int read_config_file(char* config_filename) {
     FILE *fp;
     char buf[CONFIG_LINE_BUFFER_SIZE];
     config.blockpruning = 1;
+    strcpy(config.relay, "none");
+    config.shm = 0;
     if ((fp=fopen(config_filename, "r")) == NULL) {
         fprintf(stderr, "Failed to open config file %s", config_filename);
         exit(EXIT_FAILURE);
@@ -190,6 +199,12 @@ int read_config_file(char* config_filename) {
         if (strstr(buf, "GFLOPS ")) {
             read_str_from_config_line(buf, GFLOPS);
         }
+        if (strstr(buf, "RELAY ")) {
+            read_str_from_config_line(buf, RELAY);
+        }
+        if (strstr(buf, "SHM ")) {
+            config.shm = read_int_from_config_line(buf);
+        }
 
     }
     fclose(fp);
@@ -208,6 +223,8 @@ int read_config_file(char* config_filename) {
     printf("SEQ 1 = %s \n", config.seq1);
     printf("MODEL = %s \n", config.model);
     printf("PROG = %s \n", config.prog);
+    printf("RELAY = %s \n", config.relay);
+    printf("SHM = %d \n", config.shm);
     //printf("DYN = %d \n", dyn);
     /* for (int j=0; j<config.gpus;j++)
        printf("IP[%d] =  %s \n", j, config.ips[j]);
@@ -417,6 +434,39 @@ float readlastline(string filename)
 
 }
 
+/* Reads the last line of the performance.log written by a CUDAlign instance
+ * during stage 1 and returns the split weight it can sustain in the next
+ * iteration: its rate of non-pruned cells divided by the fraction of cells
+ * it still computes under the current pruning. Returns 0 if the instance
+ * did not report its throughput. */
+float readperformance(string filename, FILE* fpr)
+{
+    ifstream fin;
+    fin.open (filename.c_str(), std::ifstream::in);
+    while (!fin) {
+        sleep(6);
+        fin.open (filename.c_str(), std::ifstream::in);
+    }
+
+    string line, last;
+    while (std::getline(fin, line)) {
+        if (line.length() > 0 && line[0] != '#')
+            last = line;
+    }
+    fin.close();
+
+    float t, rate, pruned;
+    long long cells, prunedcells;
+    if (sscanf(last.c_str(), "%f %lld %lld %f %f", &t, &cells, &prunedcells, &rate, &pruned) != 5)
+        return 0;
+
+    float computed = 1.0f - pruned;
+    if (computed < MIN_COMPUTED)
+        computed = MIN_COMPUTED;
+    fprintf (fpr, " %s: time: %.1f, cells/s: %.4e, pruned: %.4f, weight: %.4e \n", filename.c_str(), t, rate, pruned, rate/computed);
+    return rate/computed;
+}
+
 void closeterminals() {
     int i;
     char close_terminals[50];
@@ -943,7 +993,16 @@ int main(int argc, char *argv[]) {
              }
     	     else {
                 ss <<  config.ports[i-1];
-      	        command = command + " --load-column=socket://" + config.ips[i-1] + ":" + ss.str();
+                if (config.shm && strcmp(config.ips[i-1], config.ips[i]) == 0) // same host
+                   command = command + " --load-column=shm://masa-" + ss.str();
+                else if (strcmp(config.relay, "none") != 0) { // through the balancer of the previous GPU
+                   ss.str("");
+                   ss.clear();
+                   ss << RELAYPORT + config.gpu_number[i-1];
+      	           command = command + " --load-column=socket://" + config.ips[i-1] + ":" + ss.str();
+                }
+                else
+      	           command = command + " --load-column=socket://" + config.ips[i-1] + ":" + ss.str();
                 // int po = atoi(config.ports[x]) + 100;
                 // ss.str("");
                 // ss.clear();
@@ -978,7 +1037,15 @@ int main(int argc, char *argv[]) {
               }
     	      else {
                  ss <<  config.ports[i];
-      	         command = command + " --flush-column=socket://" + config.ips[i+1] + ":" + ss.str();
+                 if (config.shm && strcmp(config.ips[i], config.ips[i+1]) == 0) // same host
+                    command = command + " --flush-column=shm://masa-" + ss.str();
+                 else {
+      	            command = command + " --flush-column=socket://" + config.ips[i+1] + ":" + ss.str();
+                    // the balancer relays the column to the next GPU; the token is
+                    // removed by the balancer before execution
+                    if (strcmp(config.relay, "none") != 0)
+                       command = command + " --relay=" + config.relay;
+                 }
              }
     	  }
           else { //pseudo breakpoint from last iteration. It is here just to detect failure on last iteration.
@@ -1077,7 +1144,27 @@ int main(int argc, char *argv[]) {
           fpr = fopen (fprname.c_str(),"at");
 
 
-          if (!unbalanced)
+          if (!unbalanced && strcmp(config.model,"pruning") == 0) {
+             // weights from the live non-pruned cell rate of each instance
+             float weight[MAX_GPUS];
+             float sum = 0;
+             for (int jj=0; jj<config.gpus; jj++) {
+                ss2.str("");
+                ss2.clear();
+                ss2 << WORKDIR << "/work" << ((kk*config.gpus)+jj+1) << "/performance.log";
+                weight[jj] = readperformance(ss2.str(), fpr);
+                if (weight[jj] <= 0)
+                   unbalanced = 1;
+                sum += weight[jj];
+             }
+             if (!unbalanced)
+                for (int jj=0; jj<config.gpus; jj++) {
+                   splitnew[part+jj] = (int) (1000*weight[jj]/sum);
+                   if (splitnew[part+jj] < 1)
+                      splitnew[part+jj] = 1;
+                }
+          }
+          else if (!unbalanced)
    	         // read last line of performance log files
     	     for (int jj=0; jj<config.gpus; jj++) { 
                 ss2.str("");
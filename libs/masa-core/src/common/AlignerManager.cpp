@@ -40,6 +40,7 @@ AlignerManager::AlignerManager(IAligner* aligner) {
 	this->firstRowFile = NULL;
 
 	this->specialRowsPartition = NULL;
+	this->specialRowsFlusher = NULL;
 	this->bestScoreList = NULL;
 	this->bestScoreLocation = AT_NOWHERE;
 	this->goalScore = -INF;
@@ -175,6 +176,9 @@ void AlignerManager::alignPartition(Partition partition, int start_type) {
 		partition_adj.seq1_size = s1size;
 		aligner->alignPartition(partition_adj);
 	}
+	if (specialRowsFlusher != NULL) {
+		specialRowsFlusher->flush();
+	}
 }
 
 /*
@@ -322,6 +326,13 @@ void AlignerManager::setSpecialRowsPartition(SpecialRowsPartition* specialRowsPa
 	this->specialRowsPartition = specialRowsPartition;
 }
 
+/*
+ * @see definition on header file
+ */
+void AlignerManager::setSpecialRowsFlusher(SpecialRowsFlusher* specialRowsFlusher) {
+	this->specialRowsFlusher = specialRowsFlusher;
+}
+
 /*
  * @see definition on header file
  */
@@ -390,7 +401,11 @@ void AlignerManager::dispatchRow(int i, const cell_t* buffer, int len) {
 	i += seq0_offset;
 	if (DEBUG) printf ( "AlignerManager::dispatchRow (%d,..,%d) %d %s\n", i, len, partition.getI1(), i==partition.getI1()?"LAST ROW":"");
 	if (mustDispatchSpecialRows()) {
-		specialRowsPartition->write(i, buffer, len);
+		if (specialRowsFlusher != NULL) {
+			specialRowsFlusher->write(specialRowsPartition, i, buffer, len);
+		} else {
+			specialRowsPartition->write(i, buffer, len);
+		}
 	}
 	if (i == partition.getI1()) {
 		if (lastRowWriter != NULL) {
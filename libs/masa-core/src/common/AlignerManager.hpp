@@ -30,6 +30,7 @@
 #include "io/CellsReader.hpp"
 #include "io/CellsWriter.hpp"
 #include "sra/SpecialRowsPartition.hpp"
+#include "sra/SpecialRowsFlusher.hpp"
 #include "BlocksFile.hpp"
 #include "BestScoreList.hpp"
 #include "Job.hpp"
@@ -123,6 +124,13 @@ public:
 	 */
 	void setSpecialRowsPartition(SpecialRowsPartition* specialRowsPartition);
 
+	/**
+	 * Defines the flusher that writes the special rows asynchronously.
+	 * If NULL, the special rows are written by the aligner thread.
+	 * @param specialRowsFlusher the special rows flusher.
+	 */
+	void setSpecialRowsFlusher(SpecialRowsFlusher* specialRowsFlusher);
+
 	/**
 	 * Defines the list to store the best scores.
 	 * @param bestScoreList the list to store the best scores.
@@ -339,6 +347,9 @@ private:
 	/** Partition where the Special Rows are stored */
 	SpecialRowsPartition* specialRowsPartition;
 
+	/** Asynchronous writer of the special rows */
+	SpecialRowsFlusher* specialRowsFlusher;
+
 	/** List with the best scores */
 	BestScoreList* bestScoreList;
 
@@ -22,23 +22,48 @@
 #include "AlignerPool.hpp"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <sys/file.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* Maximum time (ms) blocked waiting an event before peeking the signal file
+ * again. Events are lost for changes made by nodes in other hosts, so this is
+ * the latency of the event modes in that case. */
+#define POOL_SIGNAL_TIMEOUT		(100)
 
 extern int rightdyn;
 extern int leftdyn;
 
-AlignerPool::AlignerPool(string sharedPath) {
+AlignerPool::AlignerPool(string sharedPath, int signalMode) {
 	this->sharedPath = sharedPath;
+	this->sharedKey = sharedPath;
+	this->signalMode = signalMode;
+	pthread_key_create(&watchKey, closeSignalWatch);
 	this->crosspointIdSentCounter = 0;
 	this->crosspointIdRecvCounter = 0;
+	this->bestScoreSentCounter = 0;
+	this->bestScoreRecvCounter = 0;
+	this->bestScoreDynSentCounter = 0;
+	this->bestScoreDynRecvCounter = 0;
 	this->bestNodeScore.score = -INF;
 	this->bestNodeScore.i = -1;
 	this->bestNodeScore.j = -1;
 }
 
 AlignerPool::~AlignerPool() {
-
+	void* watch = pthread_getspecific(watchKey);
+	if (watch != NULL) {
+		closeSignalWatch(watch);
+	}
+	pthread_key_delete(watchKey);
 }
 
 void AlignerPool::waitId(int id) {
@@ -58,7 +83,7 @@ void AlignerPool::dispatchScore(score_t score) {
 }
 
 void AlignerPool::dispatchBestScore(int score) {
-        string filename = getMsgFile("score", right);
+        string filename = getMsgFile("score", right, bestScoreSentCounter++);
         //printf ("*** right: %d *** \n", right);
         FILE* file = fopen(filename.c_str(), "wt");
         fprintf(file, "%d\n", score);
@@ -69,7 +94,7 @@ void AlignerPool::dispatchBestScore(int score) {
 }
 
 void AlignerPool::dispatchBestScoreDyn(int score) {
-        string filename = getMsgFile("scoredyn", rightdyn);
+        string filename = getMsgFile("scoredyn", rightdyn, bestScoreDynSentCounter++);
         //printf ("*** right: %d *** \n", right);
         FILE* file = fopen(filename.c_str(), "wt");
         fprintf(file, "%d\n", score);
@@ -96,10 +121,15 @@ score_t AlignerPool::receiveScore() {
 int AlignerPool::receiveBestScore() {
         int score;
 
-        string filename = getMsgFile("score", left);
+        string filename = getMsgFile("score", left, bestScoreRecvCounter++);
         //printf ("*** left: %d *** \n", left);
         waitSignal(filename);
 
+        /* Scores only increase, so only the newest one matters */
+        while (peekSignal(getMsgFile("score", left, bestScoreRecvCounter))) {
+                filename = getMsgFile("score", left, bestScoreRecvCounter++);
+        }
+
         FILE* file = fopen(filename.c_str(), "rt");
         fscanf(file, "%d\n", &score);
         fclose(file);
@@ -110,9 +140,12 @@ int AlignerPool::receiveBestScore() {
 int AlignerPool::receiveBestScoreDyn() {
         int score;
 
-        string filename = getMsgFile("scoredyn", leftdyn);
+        string filename = getMsgFile("scoredyn", leftdyn, bestScoreDynRecvCounter++);
         //printf (" \n\n !!! rightdyn: %d - filename: %s  !!! \n\n", leftdyn, filename.c_str());
         waitSignal(filename);
+        while (peekSignal(getMsgFile("scoredyn", leftdyn, bestScoreDynRecvCounter))) {
+                filename = getMsgFile("scoredyn", leftdyn, bestScoreDynRecvCounter++);
+        }
         FILE* file = fopen(filename.c_str(), "rt");
         fscanf(file, "%d\n", &score);
         fclose(file);
@@ -199,7 +232,20 @@ string AlignerPool::getLoadURL(int id) {
 
 
 void AlignerPool::initialize() {
+	/* The socket names are derived from the shared path, so all the nodes
+	 * must see the same string even if they received different relative
+	 * paths. */
+	char* path = realpath(sharedPath.c_str(), NULL);
+	if (path != NULL) {
+		sharedKey = path;
+		free(path);
+	}
 
+	if (signalMode == POOL_SIGNAL_INOTIFY && getSignalWatch() == -1) {
+		fprintf(stderr, "Could not watch %s (%s). Using file polling.\n",
+				sharedPath.c_str(), strerror(errno));
+		signalMode = POOL_SIGNAL_FILE;
+	}
 }
 
 string AlignerPool::getMsgFile(string prefix, int id, int count) {
@@ -217,13 +263,130 @@ string AlignerPool::getSignalFile(string msgFile) {
 }
 
 void AlignerPool::sendSignal(string msgFile) {
+	/* Only the message and its signal must reach the shared file system
+	 * before the receiver is woken; a global sync() would also flush every
+	 * other writer of the host. */
+	syncFile(msgFile);
+
 	string signalFile = getSignalFile(msgFile);
-	FILE* file = fopen(signalFile.c_str(), "wt");
-	fclose(file);
-	sync();
+	int fd = open(signalFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "Could not create signal %s: %s\n",
+				signalFile.c_str(), strerror(errno));
+		exit(1);
+	}
+	fsync(fd);
+	close(fd);
+
+	if (signalMode == POOL_SIGNAL_SOCKET) {
+		notifySignal(msgFile);
+	}
 	//printf("[%d] Signal Sent: %s\n", getpid(), signalFile.c_str());
 }
 
+void AlignerPool::syncFile(string filename) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd != -1) {
+		fsync(fd);
+		close(fd);
+	}
+}
+
+void AlignerPool::getSignalAddress(string msgFile, void* addr, int* len) {
+	/* FNV-1a of the canonical message name, so the address fits sun_path
+	 * regardless of the length of the shared path. */
+	string key = sharedKey + msgFile.substr(sharedPath.length());
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t k = 0; k < key.length(); k++) {
+		hash = (hash ^ (unsigned char)key[k]) * 1099511628211ULL;
+	}
+
+	struct sockaddr_un* un = (struct sockaddr_un*)addr;
+	memset(un, 0, sizeof(struct sockaddr_un));
+	un->sun_family = AF_UNIX;
+	/* Abstract namespace (leading '\0'): nothing is left in the file system
+	 * and the name is released when the socket is closed. */
+	int n = snprintf(un->sun_path + 1, sizeof(un->sun_path) - 1,
+			"masa-pool.%016llx", hash);
+	*len = offsetof(struct sockaddr_un, sun_path) + 1 + n;
+}
+
+int AlignerPool::openSignalSocket(string msgFile) {
+	struct sockaddr_un addr;
+	int len;
+	getSignalAddress(msgFile, &addr, &len);
+
+	int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd != -1 && bind(fd, (struct sockaddr*)&addr, len) == -1) {
+		close(fd);
+		fd = -1;
+	}
+	return fd;
+}
+
+void AlignerPool::notifySignal(string msgFile) {
+	struct sockaddr_un addr;
+	int len;
+	getSignalAddress(msgFile, &addr, &len);
+
+	int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (fd == -1) {
+		return;
+	}
+	/* Fails if the receiver is not waiting yet (or is in another host); it
+	 * will find the signal file before blocking. */
+	char c = 0;
+	sendto(fd, &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL, (struct sockaddr*)&addr, len);
+	close(fd);
+}
+
+int AlignerPool::getSignalWatch() {
+	/* One instance per waiting thread: the score receiver threads and the
+	 * main thread wait concurrently, and a shared instance would let one of
+	 * them drain the events that should wake the others. The instance is
+	 * kept until the thread exits, since closing it costs some milliseconds.
+	 * The key stores fd+1, so that NULL means no instance. */
+	void* watch = pthread_getspecific(watchKey);
+	if (watch != NULL) {
+		return (int)(intptr_t)watch - 1;
+	}
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd != -1 && inotify_add_watch(fd, sharedPath.c_str(),
+			IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE) == -1) {
+		int error = errno;
+		close(fd);
+		errno = error;
+		fd = -1;
+	}
+	if (fd != -1) {
+		pthread_setspecific(watchKey, (void*)(intptr_t)(fd + 1));
+	}
+	return fd;
+}
+
+void AlignerPool::closeSignalWatch(void* watch) {
+	close((int)(intptr_t)watch - 1);
+}
+
+bool AlignerPool::waitEvent(int fd, bool datagram) {
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	int ret = poll(&pfd, 1, POOL_SIGNAL_TIMEOUT);
+	if (ret <= 0) {
+		return false;
+	}
+
+	char buffer[4096];
+	if (datagram) {
+		while (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0);
+	} else {
+		while (read(fd, buffer, sizeof(buffer)) > 0);
+	}
+	return true;
+}
+
 bool AlignerPool::isFirstNode() {
 	return left == -1;
 }
@@ -252,18 +415,42 @@ bool AlignerPool::peekSignal(string msgFile) {
 }
 
 void AlignerPool::waitSignal(string msgFile) {
+	int fd = -1;
+	bool datagram = false;
+	int tries = 1000;
+	/* Bound (or watched) before the first peek, so a signal sent after the
+	 * peek always wakes this waiter. */
+	if (signalMode == POOL_SIGNAL_SOCKET) {
+		fd = openSignalSocket(msgFile);
+		datagram = true;
+	} else if (signalMode == POOL_SIGNAL_INOTIFY) {
+		fd = getSignalWatch();
+	}
+	if (fd != -1) {
+		tries = 10000 / POOL_SIGNAL_TIMEOUT;
+	}
+
 	int count = 0;
 	bool signalOk = false;
 	while (!signalOk) {
-		if (count % 1000 == 0) {
+		/* Only reports waits longer than the first period, so that
+		 * blocking receivers (e.g., the best score channel) stay quiet. */
+		if (count > 0 && count % tries == 0) {
 			fprintf(stderr,"[%d] Waiting Signal for msg: %s\n", getpid(), msgFile.c_str());
 		}
 		signalOk = peekSignal(msgFile);
 		if (!signalOk) {
-			usleep(10000);
-			count++;
+			if (fd == -1) {
+				usleep(10000);
+				count++;
+			} else if (!waitEvent(fd, datagram)) {
+				count++;
+			}
 		}
 	}
+
+	if (datagram && fd != -1) {
+		close(fd);
+	}
 	//printf("[%d] Signal Received for msg: %s\n", getpid(), msgFile.c_str());
 }
-
@@ -23,14 +23,16 @@
 #define ALIGNERPOOL_HPP_
 
 #include <string>
+#include <pthread.h>
 using namespace std;
 
 #include "../libmasa/libmasaTypes.hpp"
 #include "CrosspointsFile.hpp"
+#include "configs/Configs.hpp"
 
 class AlignerPool {
 public:
-	AlignerPool(string sharedPath);
+	AlignerPool(string sharedPath, int signalMode=POOL_SIGNAL_FILE);
 	virtual ~AlignerPool();
 
 	virtual void initialize();
@@ -62,16 +64,30 @@ public:
 
 private:
 	string sharedPath;
+	string sharedKey;
+	int signalMode;
+	pthread_key_t watchKey;
 	int right;
 	int left;
 	int crosspointIdSentCounter;
 	int crosspointIdRecvCounter;
+	int bestScoreSentCounter;
+	int bestScoreRecvCounter;
+	int bestScoreDynSentCounter;
+	int bestScoreDynRecvCounter;
 	score_t bestNodeScore;
 
 	string getSignalFile(string msgFile);
 	void sendSignal(string msgFile);
 	void waitSignal(string msgFile);
 	bool peekSignal(string msgFile);
+	void syncFile(string filename);
+	void getSignalAddress(string msgFile, void* addr, int* len);
+	int openSignalSocket(string msgFile);
+	int getSignalWatch();
+	static void closeSignalWatch(void* watch);
+	void notifySignal(string msgFile);
+	bool waitEvent(int fd, bool datagram);
 };
 
 #endif /* ALIGNERPOOL_HPP_ */
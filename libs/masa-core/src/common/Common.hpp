@@ -41,5 +41,4 @@
 
 #define SHARE (1)
 #define DUMP (0)
-#define DIAG (200)
 #define DEBUGM (0)
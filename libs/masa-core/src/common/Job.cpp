@@ -27,6 +27,7 @@ using namespace std;
 
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <algorithm>
 #include <sys/stat.h>
 #include <errno.h>
@@ -34,6 +35,7 @@ using namespace std;
 #include <wordexp.h>
 #include "Properties.hpp"
 #include "SpecialRowWriter.hpp"
+#include "sra/SpecialRowCompressed.hpp"
 #include "exceptions/exceptions.hpp"
 
 #define DEBUG (0)
@@ -47,8 +49,11 @@ Job::Job(int sequencesCount) {
     //this->alignment = new Alignment(alignment_params);
     this->special_rows_path = "";
     this->aligner = NULL;
+    this->configs = NULL;
     this->flushIntervals = NULL;
     this->maxFlushDeep = 20;
+    this->predictedCells = NULL;
+    this->plannedCellRate = 0;
     this->pool_wait_id = -1;
     this->bufferLimit = 0;
     this->split = 0;
@@ -138,11 +143,13 @@ void Job::initializeWorkPath() {
 	this->dump_pruning_text_filename = work_path + "/pruning_dump.txt";
 	this->outputBufferLogFile = work_path + "/outputBuffer.log";
 	this->inputBufferLogFile = work_path + "/inputBuffer.log";
+	this->performanceLogFile = work_path + "/performance.log";
     this->crosspoints_path = work_path + "/crosspoints";
     if (this->special_rows_path.length() == 0) {
     	this->special_rows_path = work_path + "/special_rows";
     }
     this->info_filename = work_path + "/info";
+    this->planner_filename = work_path + "/planner";
     this->status_filename = work_path + "/status";
 
 	createPath(this->work_path);
@@ -227,7 +234,11 @@ void Job::clearSpecialRowsArea(SpecialRowsArea** area) {
 AlignerPool* Job::getAlignerPool() {
 	if (alignerPool == NULL) {
 		if (flush_column_url.length() > 0 || load_column_url.length() > 0) {
-			alignerPool = new AlignerPool(pool_shared_path);
+			int signalMode = POOL_SIGNAL_FILE;
+			if (configs != NULL) {
+				signalMode = configs->getPoolSignal();
+			}
+			alignerPool = new AlignerPool(pool_shared_path, signalMode);
 			alignerPool->initialize();
 		}
 	}
@@ -238,6 +249,10 @@ void Job::calculateFlushIntervals(int max_deep, long long limit, int seq0_len, i
 	if (flushIntervals != NULL) {
 		delete flushIntervals;
 	}
+	if (predictedCells != NULL) {
+		delete[] predictedCells;
+		predictedCells = NULL;
+	}
 	flushIntervals = new int[max_deep];
 	if (limit < seq1_len*sizeof(cell_t)*2) {
 		limit = seq1_len*sizeof(cell_t)*2;
@@ -262,6 +277,152 @@ void Job::calculateFlushIntervals(int max_deep, long long limit, int seq0_len, i
     }
 }
 
+/*
+ * Stores the rates measured in stage 1, used to plan the intervals of the
+ * next stages even if they are executed by another process. The cell rate
+ * counts only the computed cells, i.e., not the pruned blocks.
+ */
+void Job::saveStage1Measurements(double cellRate, double writeBandwidth) {
+	savePlanner(cellRate, writeBandwidth, SpecialRowCompressed::getCompressionRatio(), 0, 0);
+}
+
+void Job::savePlanner(double cellRate, double writeBandwidth, float ratio, int end_i, int end_j) {
+	FILE* f = fopen(planner_filename.c_str(), "wt");
+	if (f == NULL) {
+		return;
+	}
+	fprintf(f, "cell_rate=%.0f\n", cellRate);
+	fprintf(f, "write_bandwidth=%.0f\n", writeBandwidth);
+	fprintf(f, "compression_ratio=%.4f\n", ratio);
+	if (end_i > 0 && end_j > 0) {
+		fprintf(f, "end_i=%d\n", end_i);
+		fprintf(f, "end_j=%d\n", end_j);
+	}
+	fclose(f);
+}
+
+/*
+ * Repeats the planning done in stage 2, so that the stages executed by
+ * another process use the same intervals.
+ */
+void Job::replanFlushIntervals(FILE* stats) {
+	Properties prop;
+	if (!prop.initialize(planner_filename.c_str())) {
+		return;
+	}
+	int end_i = prop.get_property_int("end_i");
+	int end_j = prop.get_property_int("end_j");
+	if (end_i > 0 && end_j > 0) {
+		planFlushIntervals(end_i, end_j, stats);
+	}
+}
+
+/*
+ * Replans the intervals of stage 2 and later once the end of the alignment
+ * is known. The initial plan assumes that the traceback may cross the whole
+ * matrix, but the path is bounded by the stage 1 crosspoint (end_i,end_j),
+ * so the SRA budget is spread over the lengths that can be traversed.
+ *
+ * For each step the interval is the smallest one that fits in the budget.
+ * If the rows go to disk and the write bandwidth is known, the interval is
+ * enlarged up to the point where the time to write the rows equals the
+ * time saved in the recomputation of the next step, i.e.
+ * sqrt(interval_prev*sizeof(cell_t)*cell_rate/bandwidth).
+ *
+ * Nothing is planned if the stage 1 cell rate is unknown.
+ */
+void Job::planFlushIntervals(int end_i, int end_j, FILE* stats) {
+	if (flushIntervals == NULL) {
+		return;
+	}
+	long long limit = getSRALimit();
+	if (limit <= 0) {
+		return;
+	}
+	double cellRate = 0;
+	double bandwidth = 0;
+	float ratio = 1.0f;
+	Properties prop;
+	if (prop.initialize(planner_filename.c_str())) {
+		cellRate = atof(prop.get_property("cell_rate").c_str());
+		bandwidth = atof(prop.get_property("write_bandwidth").c_str());
+		ratio = atof(prop.get_property("compression_ratio").c_str());
+	}
+	if (cellRate <= 0) {
+		return;
+	}
+
+	long long len0 = end_i - (alignment_params->getSequence(0)->getTrimStart()-1);
+	long long len1 = end_j - (alignment_params->getSequence(1)->getTrimStart()-1);
+	if (len0 < 1) len0 = 1;
+	if (len1 < 1) len1 = 1;
+
+	if (predictedCells == NULL) {
+		predictedCells = new double[maxFlushDeep];
+	}
+	plannedCellRate = cellRate;
+	savePlanner(cellRate, bandwidth, ratio, end_i, end_j);
+	predictedCells[0] = 0;
+	fprintf(stats, "Interval planner: path bounded by (%lld x %lld), %.2f MCUPS, %.2f MB/s, compression %.2fx\n",
+			len0, len1, cellRate/1000000.0, bandwidth/1000000.0, ratio);
+
+	for (int i=1; i<maxFlushDeep; i++) {
+		int stage = (i == 1) ? STAGE_2 : STAGE_3;
+		long long budget = limit;
+		if (disk_limit > 0 && configs != NULL && configs->getSRACompression(stage) != SRA_COMPRESSION_NONE
+				&& ratio > 1.0f) {
+			// keeps a margin, since the next stages may compress worse
+			budget = ram_limit + (long long)(disk_limit*(1 + (ratio-1)*0.8f));
+		}
+		long long len = (i%2==1) ? len1 : len0;
+		long long minimum = ((long long)flushIntervals[i-1])*len*sizeof(cell_t)/budget + 1;
+		long long interval = minimum;
+		if (disk_limit > 0 && bandwidth > 0 && cellRate > 0) {
+			long long balanced = (long long)sqrt(flushIntervals[i-1]*sizeof(cell_t)*cellRate/bandwidth);
+			if (interval < balanced) {
+				interval = balanced;
+			}
+		}
+		if (i >= 2 && interval > flushIntervals[i-2]/2) {
+			interval = flushIntervals[i-2]/2; // Ensure that each even step decreases at least twice
+		}
+		if (interval < 1) {
+			interval = 1;
+		}
+		long long previous = flushIntervals[i];
+		flushIntervals[i] = (int)interval;
+
+		/* Stage 2 sweeps the area below the path (half of the bounded
+		 * matrix for a diagonal path). Each later step recomputes the
+		 * partitions between the crosspoints of the previous step, whose
+		 * heights are the interval of the rows used by that step. */
+		if (i == 1) {
+			predictedCells[i] = ((double)len0)*len1/2;
+		} else {
+			predictedCells[i] = ((double)flushIntervals[i-2])*((i%2==0) ? len1 : len0);
+		}
+		if (i <= 4) {
+			fprintf(stats, "  step %d: interval %d (initial %lld, memory bound %lld), predicted %.4e cells\n",
+					i, flushIntervals[i], previous, minimum, predictedCells[i]);
+		}
+	}
+	fflush(stats);
+}
+
+double Job::getPredictedCells(int step) {
+	if (predictedCells == NULL || step <= 0 || step >= maxFlushDeep) {
+		return 0;
+	}
+	return predictedCells[step];
+}
+
+double Job::getPredictedTime(int step) {
+	if (plannedCellRate <= 0) {
+		return 0;
+	}
+	return getPredictedCells(step)/plannedCellRate;
+}
+
 long long Job::getFlushInterval(int step) {
 	if (step < maxFlushDeep) {
 		return flushIntervals[step];
@@ -296,6 +457,9 @@ SpecialRowsArea* Job::getSpecialRowsArea(int stage, int id, int deep) {
     	}
     	printf(" Job::getSpecialRowsArea(%d, %d, %d) -> %d/%d\n", stage, id, deep, ram_limit, disk);
     	area = new SpecialRowsArea(name, ram_limit, disk, aligner->getScoreParameters());
+    	if (configs != NULL) {
+    		area->setCompression(configs->getSRACompression(stage));
+    	}
     	specialRowsAreas[name] = area;
     } else {
     	//area->reload();
@@ -77,6 +77,7 @@ public:
 	int stage6_output_format;
 	string outputBufferLogFile;
 	string inputBufferLogFile;
+	string performanceLogFile;
 
 	IAligner* aligner;
 	Configs* configs;
@@ -125,6 +126,11 @@ public:
 
 	long long getSRALimit();
 	long long getFlushInterval(int step);
+	void saveStage1Measurements(double cellRate, double writeBandwidth);
+	void planFlushIntervals(int end_i, int end_j, FILE* stats);
+	void replanFlushIntervals(FILE* stats);
+	double getPredictedCells(int step);
+	double getPredictedTime(int step);
 	AlignerPool* getAlignerPool();
 	int getPoolWaitId() const;
 	void setPoolWaitId(int id);
@@ -144,6 +150,10 @@ private:
 	string special_rows_path;
 	int* flushIntervals;
 	int maxFlushDeep;
+	double* predictedCells;
+	double plannedCellRate;
+	string planner_filename;
+	void savePlanner(double cellRate, double writeBandwidth, float ratio, int end_i, int end_j);
 	AlignerPool* alignerPool;
 	string pool_shared_path;
 	int pool_wait_id;
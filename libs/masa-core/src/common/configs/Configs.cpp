@@ -128,6 +128,20 @@ Configs::Configs() {
 					"",
 					ConfigParser::parse_int, NULL},
 
+			{"[stage1]", "sra-flush-threads", &stage1_sra_flush_threads,
+					"",
+					ConfigParser::parse_int, NULL},
+			{"[stage1]", "sra-flush-buffer", &stage1_sra_flush_buffer,
+					"",
+					ConfigParser::parse_longlong_size, NULL},
+			{"[stage1]", "score-share-margin", &stage1_score_share_margin,
+					"",
+					ConfigParser::parse_int, NULL},
+
+			{"[stage2]", "sra-read-ahead", &stage2_sra_read_ahead,
+					"",
+					ConfigParser::parse_longlong_size, NULL},
+
 			{"[stage3]", "max-partition-size", &max_partition_size[3],
 					"",
 					ConfigParser::parse_int, NULL},
@@ -142,10 +156,24 @@ Configs::Configs() {
 					"",
 					ConfigParser::parse_int, NULL},
 
+			{"[stage3]", "workers", &workers[3],
+					"",
+					ConfigParser::parse_int, NULL},
+			{"[stage4]", "workers", &workers[4],
+					"",
+					ConfigParser::parse_int, NULL},
+			{"[stage5]", "workers", &workers[5],
+					"",
+					ConfigParser::parse_int, NULL},
+
 			{"[stage4]", "execution-type", &stage4_execution_type,
 					"",
 					ConfigParser::parse_int_enum, STAGE_4_EXECUTION_TYPE_ENUM},
 
+			{"[global]", "pool-signal", &pool_signal,
+					"",
+					ConfigParser::parse_int_enum, POOL_SIGNAL_ENUM},
+
 			{"[global]", "work-path", (void*)&work_path,
 					"",
 					ConfigParser::parse_path, NULL},
@@ -162,10 +190,16 @@ Configs::Configs() {
 		block_pruning[i] = CONFIG_NOT_SET;
 		max_iterations[i] = CONFIG_NOT_SET;
 		max_partition_size[i] = CONFIG_NOT_SET;
+		workers[i] = 1;
 		sra_path[i] = "";
 	}
 	stage1_pruning_initial_score = CONFIG_NOT_SET;
+	stage1_sra_flush_threads = 0;
+	stage1_sra_flush_buffer = 0;
+	stage2_sra_read_ahead = 0;
+	stage1_score_share_margin = 0;
 	stage4_execution_type = CONFIG_NOT_SET;
+	pool_signal = POOL_SIGNAL_FILE;
 	work_path = "";
 
 	loadConfigs(DEFAULT_CONFIGS);
@@ -270,10 +304,34 @@ int Configs::getMaxPartitionSize(int stage) {
 	return max_partition_size[stage];
 }
 
+int Configs::getWorkers(int stage) {
+	return workers[stage];
+}
+
 int Configs::getPruningInitialScore() {
 	return stage1_pruning_initial_score;
 }
 
+int Configs::getSRAFlushThreads() {
+	return stage1_sra_flush_threads;
+}
+
+long long Configs::getSRAFlushBuffer() {
+	return stage1_sra_flush_buffer;
+}
+
+long long Configs::getSRAReadAhead() {
+	return stage2_sra_read_ahead;
+}
+
+int Configs::getScoreShareMargin() {
+	return stage1_score_share_margin;
+}
+
+int Configs::getPoolSignal() {
+	return pool_signal;
+}
+
 int main_test(int argc, const char** argv) {
 
 	Configs configs;
@@ -45,6 +45,11 @@ using namespace std;
 #define STAGE_4_EXECUTION_INTERLEAVED	(2)
 #define STAGE_4_EXECUTION_TYPE_ENUM		"parallel;orthogonal;interleaved"
 
+#define POOL_SIGNAL_FILE		(0)
+#define POOL_SIGNAL_INOTIFY		(1)
+#define POOL_SIGNAL_SOCKET		(2)
+#define POOL_SIGNAL_ENUM		"file;inotify;socket"
+
 // TODO duplicado do Job.hpp
 #define GLOBAL	   (0)
 #define STAGE_1   (1)
@@ -73,8 +78,14 @@ public:
 	bool isBlockPruningEnabled(int stage);
 	int getMaxIterations(int stage);
 	int getMaxPartitionSize(int stage);
+	int getWorkers(int stage);
 
 	int getPruningInitialScore();
+	int getSRAFlushThreads();
+	long long getSRAFlushBuffer();
+	long long getSRAReadAhead();
+	int getScoreShareMargin();
+	int getPoolSignal();
 
 private:
 	int sra_strategy[7];
@@ -84,9 +95,15 @@ private:
 	int block_pruning[7];
 	int max_iterations[7];
 	int max_partition_size[7];
+	int workers[7];
 
 	int stage1_pruning_initial_score;
+	int stage1_sra_flush_threads;
+	long long stage1_sra_flush_buffer;
+	long long stage2_sra_read_ahead;
+	int stage1_score_share_margin;
 	int stage4_execution_type;
+	int pool_signal;
 
 	/* Paths */
 	string sra_path[7];
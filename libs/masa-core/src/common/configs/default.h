@@ -6,15 +6,20 @@
   "sra-disk-size\t\tnone",
   "sra-ram-size\t\t4G",
   "block-pruning\t\tenabled",
+  "pool-signal\t\tfile",
   "[stage1]",
   "sra-disk-size\t\tnone",
   "sra-ram-size\t\t2G",
   "pruning-initial-score\t4000",
+  "sra-flush-threads\t1",
+  "sra-flush-buffer\t64M",
+  "score-share-margin\t1000",
   "[stage2]",
   "sra-disk-size\t\tnone",
   "sra-ram-size\t\t2G",
   "sra-compression\t\tvlc",
   "block-pruning\t\tenabled",
+  "sra-read-ahead\t\t1M",
   "[stage3]",
   "max-iterations\t\t5",
   "max-partition-size\t1024",
@@ -22,7 +27,11 @@
   "sra-ram-size\t\t2G",
   "sra-compression\t\tvlc",
   "block-pruning\t\tenabled",
+  "workers\t\t\t1",
   "[stage4]",
   "max-partition-size\t1024",
   "execution-type\tinterleaved",
   "max-partition-size\t16",
+  "workers\t\t\t4",
+  "[stage5]",
+  "workers\t\t\t4",
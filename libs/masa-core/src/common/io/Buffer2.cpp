@@ -55,6 +55,7 @@ Buffer2::Buffer2(int buffer_max) {
 	stats.blockingReadTime = 0;
 	stats.totalWriteBytes = 0;
 	stats.blockingWriteTime = 0;
+	stats.ioOperations = 0;
 
 	tempBlockingReadTime = -1;
 	tempBlockingWriteTime = -1;
@@ -112,9 +113,8 @@ int Buffer2::circularLoad(cell_t* dst, int len) {
     	memcpy(dst+(buffer_size-buffer_start), buffer, (len-(buffer_size-buffer_start))*sizeof(cell_t));
         buffer_start = len-(buffer_size-buffer_start);
     }
-    if (sizeUsed() > 0) {
-        pthread_cond_signal(&notFullCond);
-    } else {
+    pthread_cond_signal(&notFullCond);
+    if (sizeUsed() == 0) {
         pthread_cond_signal(&emptyCond);
 	}
     return len;
@@ -127,9 +127,8 @@ int Buffer2::circularSkip(int len) {
     } else {
         buffer_start = len-(buffer_size-buffer_start);
     }
-    if (sizeUsed() > 0) {
-        pthread_cond_signal(&notFullCond);
-    } else {
+    pthread_cond_signal(&notFullCond);
+    if (sizeUsed() == 0) {
         pthread_cond_signal(&emptyCond);
 	}
     return len;
@@ -230,6 +229,80 @@ int Buffer2::writeBuffer(const cell_t* data, int nmemb)
     return size_total-size_left;
 }
 
+int Buffer2::peekBuffer(const cell_t** seg0, int* len0, const cell_t** seg1, int* len1,
+		int minLen, int maxLen, float deadline) {
+	pthread_mutex_lock(&mutex);
+	if (DEBUG) printf("Buffer2::peekBuffer(%d,%d) - buf: %d\n", minLen, maxLen, sizeUsed());
+	while (sizeUsed() == 0 && !destroyed) {
+		float t0 = Timer::getGlobalTime();
+		tempBlockingReadTime = t0;
+		pthread_cond_wait (&notEmptyCond, &mutex);
+		tempBlockingReadTime = -1;
+		float t1 = Timer::getGlobalTime();
+		stats.blockingReadTime += (t1-t0);
+	}
+	if (sizeUsed() < minLen && deadline > 0 && !destroyed) {
+		timeval event;
+		gettimeofday(&event, NULL);
+
+		struct timespec time;
+		time.tv_sec = event.tv_sec + (int)deadline;
+		time.tv_nsec = event.tv_usec*1000 + (int)((deadline - floor(deadline))*1000000000);
+		if (time.tv_nsec >= 1000000000) {
+			time.tv_nsec -= 1000000000;
+			time.tv_sec++;
+		}
+
+		float t0 = Timer::getGlobalTime();
+		tempBlockingReadTime = t0;
+		while (sizeUsed() < minLen && !destroyed) {
+			if (pthread_cond_timedwait(&notEmptyCond, &mutex, &time) != 0) {
+				break;
+			}
+		}
+		tempBlockingReadTime = -1;
+		float t1 = Timer::getGlobalTime();
+		stats.blockingReadTime += (t1-t0);
+	}
+
+	int len = 0;
+	*len0 = 0;
+	*len1 = 0;
+	if (!destroyed) {
+		len = sizeUsed();
+		if (len > maxLen) {
+			len = maxLen;
+		}
+		*seg0 = buffer+buffer_start;
+		if (buffer_start+len <= buffer_size) {
+			*len0 = len;
+		} else {
+			*len0 = buffer_size-buffer_start;
+			*seg1 = buffer;
+			*len1 = len - *len0;
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+	return len;
+}
+
+void Buffer2::consumeBuffer(int nmemb) {
+	pthread_mutex_lock(&mutex);
+	circularSkip(nmemb);
+	stats.bufferUsage = sizeUsed();
+	if (stats.totalReadBytes == 0) {
+		pthread_cond_signal(&loggerCond);
+	}
+	stats.totalReadBytes += nmemb;
+	pthread_mutex_unlock(&mutex);
+}
+
+void Buffer2::addIOOperations(int count) {
+	pthread_mutex_lock(&mutex);
+	stats.ioOperations += count;
+	pthread_mutex_unlock(&mutex);
+}
+
 void *Buffer2::staticLogThread(void *arg) {
     Buffer2* buffer = (Buffer2*)arg;
     buffer->logThread();
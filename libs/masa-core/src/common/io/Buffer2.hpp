@@ -37,6 +37,7 @@ struct buffer2_statistics_t {
 	float blockingReadTime;
 	int totalWriteBytes;
 	float blockingWriteTime;
+	int ioOperations;
 
 	const buffer2_statistics_t operator-(const buffer2_statistics_t &other) const {
 		buffer2_statistics_t ret;
@@ -46,6 +47,7 @@ struct buffer2_statistics_t {
 		ret.blockingReadTime = this->blockingReadTime - other.blockingReadTime;
 		ret.totalWriteBytes = this->totalWriteBytes - other.totalWriteBytes;
 		ret.blockingWriteTime = this->blockingWriteTime - other.blockingWriteTime;
+		ret.ioOperations = this->ioOperations - other.ioOperations;
 		return ret;
 	}
 };
@@ -60,6 +62,41 @@ public:
 	int readBuffer(cell_t* data, int nmemb);
 	int writeBuffer(const cell_t* data, int nmemb);
 	void waitEmptyBuffer();
+
+	/**
+	 * Returns the cells available for reading without removing them from
+	 * the buffer. The cells are given in up to two contiguous segments
+	 * (the second one is used when the cells wrap around the circular
+	 * buffer) and they must be released with the consumeBuffer method.
+	 *
+	 * The method blocks until there is at least one cell in the buffer.
+	 * Then, it waits up to the deadline for minLen cells to be available.
+	 *
+	 * @param seg0 returns the first segment.
+	 * @param len0 returns the number of cells in the first segment.
+	 * @param seg1 returns the second segment.
+	 * @param len1 returns the number of cells in the second segment.
+	 * @param minLen number of cells that ends the coalescing wait.
+	 * @param maxLen maximum number of cells to be returned.
+	 * @param deadline maximum coalescing wait, in seconds.
+	 * @return the total number of cells returned, or 0 if the buffer
+	 * 	was destroyed.
+	 */
+	int peekBuffer(const cell_t** seg0, int* len0, const cell_t** seg1, int* len1,
+			int minLen, int maxLen, float deadline);
+
+	/**
+	 * Removes the first nmemb cells returned by the peekBuffer method.
+	 * @param nmemb number of cells to be removed.
+	 */
+	void consumeBuffer(int nmemb);
+
+	/**
+	 * Accounts the operations executed by the stream on the underlying
+	 * reader/writer (e.g. socket system calls).
+	 * @param count number of operations.
+	 */
+	void addIOOperations(int count);
 	
 	void destroy();
 	bool isDestroyed();
@@ -33,6 +33,7 @@ BufferLogger::BufferLogger(string file)
 	prev_stats.blockingWriteTime = 0;
 	prev_stats.totalReadBytes = 0;
 	prev_stats.totalWriteBytes = 0;
+	prev_stats.ioOperations = 0;
 
 	this->file = fopen(file.c_str(), "wt");
 	if (this->file == NULL) {
@@ -72,7 +73,7 @@ void BufferLogger::logBuffer(buffer2_statistics_t &curr_stats) {
 		psi_out = ((float)delta_stats.totalWriteBytes/size)/delta_stats.time*delta_stats.blockingWriteTime/(delta_stats.time-delta_stats.blockingWriteTime);
 	}
 
-	fprintf(file, "%.2f\t%d\t%d\t%d\t%.2f\t%.2f\t%.2f\t%d\t%d\t%d\t%.2f\t%.2f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",
+	fprintf(file, "%.2f\t%d\t%d\t%d\t%.2f\t%.2f\t%.2f\t%d\t%d\t%d\t%.2f\t%.2f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%d\t%d\n",
 			curr_stats.time,  // 1
 			curr_stats.bufferUsage/size, // 2
 			curr_stats.totalReadBytes/size, curr_stats.totalWriteBytes/size,    // 3 4
@@ -84,7 +85,8 @@ void BufferLogger::logBuffer(buffer2_statistics_t &curr_stats) {
 			delta,  psi_in, psi_out, // 13 14 15
 			(delta_stats.totalReadBytes/size)/delta_stats.time, // 16
 			(delta_stats.totalWriteBytes/size)/delta_stats.time, // 17
-			delta+psi_in, delta+psi_out); // 18 19
+			delta+psi_in, delta+psi_out, // 18 19
+			curr_stats.ioOperations, delta_stats.ioOperations); // 20 21
 
 	fflush(file);
 }
@@ -26,13 +26,15 @@
 
 #define DEBUG (0)
 
-BufferedCellsReader::BufferedCellsReader(CellsReader* reader, int bufferLimit) {
+BufferedCellsReader::BufferedCellsReader(CellsReader* reader, int bufferLimit,
+		int batchSize) {
     if (reader == NULL){
         printf("BufferedCellsReader::ERROR; null reader\n");
         exit(-1);
     }
 	this->reader = reader;
 	this->offset = 0;
+	this->batchSize = batchSize > 0 ? batchSize : DEFAULT_STREAM_BATCH;
 
 	initBuffer(bufferLimit);
 }
@@ -73,13 +75,15 @@ int BufferedCellsReader::getOffset() {
 }
 
 void BufferedCellsReader::bufferLoop() {
+	cell_t* cells = (cell_t*)malloc(batchSize*sizeof(cell_t));
     while (!isBufferDestroyed()) {
-    	cell_t cell;
-    	int len = reader->read(&cell, 1);
+    	int len = reader->readAvailable(cells, batchSize);
         if (len <= 0) break;
-        len = writeBuffer(&cell, 1);
+        addIOOperations(1);
+        len = writeBuffer(cells, len);
         if (len <= 0) break;
     }
+    free(cells);
 	if (DEBUG) printf("BufferedCellsReader::bufferLoop() - DONE\n");
 }
 
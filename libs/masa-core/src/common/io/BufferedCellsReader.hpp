@@ -29,7 +29,14 @@
 
 class BufferedCellsReader: public SeekableCellsReader, public BufferedStream {
 public:
-	BufferedCellsReader(CellsReader* reader, int bufferLimit);
+	/**
+	 * @param reader the source of the cells.
+	 * @param bufferLimit capacity of the buffer, in cells.
+	 * @param batchSize maximum number of cells requested in each read
+	 * 	operation of the source reader.
+	 */
+	BufferedCellsReader(CellsReader* reader, int bufferLimit,
+			int batchSize = DEFAULT_STREAM_BATCH);
 	virtual ~BufferedCellsReader();
 	virtual void close();
 
@@ -40,6 +47,7 @@ public:
 private:
 	CellsReader* reader;
 	int offset;
+	int batchSize;
 
     void bufferLoop();
 };
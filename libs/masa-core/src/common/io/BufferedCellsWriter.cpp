@@ -26,12 +26,15 @@
 
 #define DEBUG (0)
 
-BufferedCellsWriter::BufferedCellsWriter(CellsWriter* writer, int bufferLimit) {
+BufferedCellsWriter::BufferedCellsWriter(CellsWriter* writer, int bufferLimit,
+		int batchSize, float flushDeadline) {
     if (writer == NULL){
         printf("BufferedCellsWriter::ERROR; null writer\n");
         exit(-1);
     }
 	this->writer = writer;
+	this->batchSize = batchSize > 0 ? batchSize : DEFAULT_STREAM_BATCH;
+	this->flushDeadline = flushDeadline;
 	if (writer != NULL) {
 		initBuffer(bufferLimit);
 	}
@@ -57,11 +60,16 @@ int BufferedCellsWriter::write(const cell_t* buf, int len) {
 void BufferedCellsWriter::bufferLoop() {
 
     while (!isBufferDestroyed()) {
-    	cell_t cell;
-        int len = readBuffer(&cell, 1);
-        if (len <= 0) break;
-    	len = writer->write(&cell, 1);
+    	const cell_t* bufs[2];
+    	int lens[2];
+        int len = peekBuffer(&bufs[0], &lens[0], &bufs[1], &lens[1],
+        		batchSize, batchSize, flushDeadline);
         if (len <= 0) break;
+        // the cells are written directly from the buffer, in one or two segments
+    	int ret = writer->writeVector(bufs, lens, lens[1] > 0 ? 2 : 1);
+        if (ret <= 0) break;
+        addIOOperations(1);
+        consumeBuffer(len);
     }
 	if (DEBUG) printf("BufferedCellsWriter::bufferLoop() - DONE\n");
 }
@@ -27,7 +27,17 @@
 
 class BufferedCellsWriter: public CellsWriter, public BufferedStream {
 public:
-	BufferedCellsWriter(CellsWriter* writer, int bufferLimit);
+	/**
+	 * @param writer the destination of the cells.
+	 * @param bufferLimit capacity of the buffer, in cells.
+	 * @param batchSize maximum number of cells given to each write
+	 * 	operation of the destination writer.
+	 * @param flushDeadline maximum time (in seconds) that the cells wait
+	 * 	in the buffer to coalesce batchSize cells. If zero, the available
+	 * 	cells are written immediately.
+	 */
+	BufferedCellsWriter(CellsWriter* writer, int bufferLimit,
+			int batchSize = DEFAULT_STREAM_BATCH, float flushDeadline = 0);
 	virtual ~BufferedCellsWriter();
 	virtual void close();
 
@@ -35,6 +45,8 @@ public:
 
 private:
 	CellsWriter* writer;
+	int batchSize;
+	float flushDeadline;
 
     void bufferLoop();
 };
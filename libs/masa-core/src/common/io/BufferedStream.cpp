@@ -57,6 +57,19 @@ int BufferedStream::writeBuffer(const cell_t* buf, int len) {
 	return buffer->writeBuffer(buf, len);
 }
 
+int BufferedStream::peekBuffer(const cell_t** seg0, int* len0, const cell_t** seg1, int* len1,
+		int minLen, int maxLen, float deadline) {
+	return buffer->peekBuffer(seg0, len0, seg1, len1, minLen, maxLen, deadline);
+}
+
+void BufferedStream::consumeBuffer(int len) {
+	buffer->consumeBuffer(len);
+}
+
+void BufferedStream::addIOOperations(int count) {
+	buffer->addIOOperations(count);
+}
+
 void BufferedStream::initBuffer(int bufferLimit) {
 	this->buffer = new Buffer2(bufferLimit);
 
@@ -25,6 +25,9 @@
 #include "Buffer2.hpp"
 #include "BufferLogger.hpp"
 
+/** Default number of cells moved in each operation of the stream thread */
+#define DEFAULT_STREAM_BATCH	(4*1024)
+
 class BufferedStream {
 public:
 	BufferedStream();
@@ -38,6 +41,10 @@ protected:
 	bool isBufferDestroyed();
 	int readBuffer(cell_t* buf, int len);
 	int writeBuffer(const cell_t* buf, int len);
+	int peekBuffer(const cell_t** seg0, int* len0, const cell_t** seg1, int* len1,
+			int minLen, int maxLen, float deadline);
+	void consumeBuffer(int len);
+	void addIOOperations(int count);
     virtual void bufferLoop() = 0;
 
 private:
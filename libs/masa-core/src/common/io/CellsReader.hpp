@@ -34,6 +34,17 @@ public:
 	virtual void close() = 0;
 	virtual int getType() = 0;
 	virtual int read(cell_t* buf, int len) = 0;
+
+	/**
+	 * Reads up to len cells, returning as soon as some cells are available.
+	 * Readers that cannot return partial data read len cells.
+	 *
+	 * @return the number of cells read, or a non-positive value in
+	 * 	the end of the stream.
+	 */
+	virtual int readAvailable(cell_t* buf, int len) {
+		return read(buf, len);
+	}
 };
 
 
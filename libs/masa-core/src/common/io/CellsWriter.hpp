@@ -32,6 +32,24 @@ public:
 	virtual ~CellsWriter() {};
 	virtual int write(const cell_t* buf, int len) = 0;
 	virtual void close() = 0;
+
+	/**
+	 * Writes the cells of count buffers, in order. Writers that are able to
+	 * gather the buffers in a single operation should override this method.
+	 *
+	 * @return the number of cells written, or a non-positive value in
+	 * 	case of error.
+	 */
+	virtual int writeVector(const cell_t** bufs, const int* lens, int count) {
+		int total = 0;
+		for (int i = 0; i < count; i++) {
+			if (lens[i] == 0) continue;
+			int ret = write(bufs[i], lens[i]);
+			if (ret <= 0) return ret;
+			total += lens[i];
+		}
+		return total;
+	}
 };
 
 
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include "ShmCellsReader.hpp"
+
+#include <stdio.h>
+#include <unistd.h>
+
+ShmCellsReader::ShmCellsReader(string name, string shared_path) {
+	this->name = name;
+	this->failure_signal_path = shared_path+"/failure.txt";
+	removeOldFiles();
+	this->ring = new ShmCellsRing(name, false);
+}
+
+ShmCellsReader::~ShmCellsReader() {
+	close();
+}
+
+void ShmCellsReader::removeOldFiles() {
+	remove(failure_signal_path.c_str());
+}
+
+void ShmCellsReader::close() {
+	if (ring != NULL) {
+		ring->close();
+		delete ring;
+		ring = NULL;
+	}
+}
+
+int ShmCellsReader::getType() {
+	return INIT_WITH_CUSTOM_DATA;
+}
+
+void ShmCellsReader::failureSignal() {
+	/* Signalizes a failure to the controller by writing a failure.txt file in the shared dir. */
+	if (access(failure_signal_path.c_str(), F_OK) != 0) {
+		printf("Failure Signal Sent!\n");
+		FILE* fd_failure = fopen(failure_signal_path.c_str(), "wb");
+		if (fd_failure != NULL) {
+			fclose(fd_failure);
+		}
+	}
+}
+
+int ShmCellsReader::read(cell_t* buf, int len) {
+	int ret = ring->read(buf, len, false);
+	if (ret == -1) {
+		printf("~~~~Connection Lost!~~~~\n");
+		failureSignal();
+	}
+	return ret;
+}
+
+int ShmCellsReader::readAvailable(cell_t* buf, int len) {
+	int ret = ring->read(buf, len, true);
+	if (ret == -1) {
+		printf("~~~~Connection Lost!~~~~\n");
+		failureSignal();
+	}
+	return ret;
+}
@@ -0,0 +1,54 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef SHMCELLSREADER_HPP_
+#define SHMCELLSREADER_HPP_
+
+#include "CellsReader.hpp"
+#include "ShmCellsRing.hpp"
+#include <string>
+using namespace std;
+
+/**
+ * Receives the cells of a ShmCellsWriter of the same host through a shared
+ * memory ring (URL shm://NAME).
+ */
+class ShmCellsReader : public CellsReader {
+public:
+	ShmCellsReader(string name, string shared_path);
+	virtual ~ShmCellsReader();
+	virtual void close();
+
+	virtual int getType();
+	virtual int read(cell_t* buf, int len);
+	virtual int readAvailable(cell_t* buf, int len);
+
+private:
+	string name;
+	string failure_signal_path;
+	ShmCellsRing* ring;
+
+	void failureSignal();
+	void removeOldFiles();
+};
+
+#endif /* SHMCELLSREADER_HPP_ */
@@ -0,0 +1,321 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "ShmCellsRing.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define DEBUG (0)
+
+#define SHM_MAGIC			(0x4D415341) // "MASA"
+
+/* Attach retries of the reader (same limit of the SocketCellsReader) */
+#define SHM_MAX_RETRIES		(1500)
+#define SHM_RETRY_USECS		(10000)
+
+/* Period (ms) to check if the other process is alive while blocked */
+#define SHM_WAIT_MS			(1000)
+
+static long long atomicLoad(volatile long long* p) {
+	return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static void atomicStore(volatile long long* p, long long v) {
+	__atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+static int atomicLoad(volatile int* p) {
+	return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static void atomicStore(volatile int* p, int v) {
+	__atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+ShmCellsRing::ShmCellsRing(string name, bool writer) {
+	if (name.size() == 0 || name.find('/') != string::npos) {
+		fprintf(stderr, "ShmCellsRing: Wrong shared memory name: %s\n", name.c_str());
+		exit(1);
+	}
+	this->name = "/" + name;
+	this->writer = writer;
+	this->header = NULL;
+	this->cells = NULL;
+	this->mapSize = 0;
+	this->statCells = 0;
+	this->statWaits = 0;
+	this->statWakes = 0;
+
+	if (writer) {
+		create();
+	} else {
+		attach();
+	}
+}
+
+ShmCellsRing::~ShmCellsRing() {
+	close();
+}
+
+void ShmCellsRing::create() {
+	/* removes the segment of a previous execution */
+	shm_unlink(name.c_str());
+
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd == -1) {
+		fprintf(stderr, "ShmCellsRing: could not create %s: %s\n", name.c_str(), strerror(errno));
+		exit(1);
+	}
+	mapSize = sizeof(shm_ring_header_t) + SHM_RING_CAPACITY*sizeof(cell_t);
+	if (ftruncate(fd, mapSize) == -1) {
+		fprintf(stderr, "ShmCellsRing: could not resize %s: %s\n", name.c_str(), strerror(errno));
+		exit(1);
+	}
+	void* ptr = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "ShmCellsRing: could not map %s: %s\n", name.c_str(), strerror(errno));
+		exit(1);
+	}
+	header = (shm_ring_header_t*)ptr;
+	cells = (cell_t*)(header+1);
+
+	memset(header, 0, sizeof(shm_ring_header_t));
+	header->capacity = SHM_RING_CAPACITY;
+	header->writerPid = getpid();
+	/* the magic number is the last field to be set: the reader only
+	 * uses the ring after seeing it. */
+	atomicStore(&header->magic, SHM_MAGIC);
+	fprintf(stderr, "ShmCellsRing: created %s (%d cells)\n", name.c_str(), SHM_RING_CAPACITY);
+}
+
+void ShmCellsRing::attach() {
+	int retries = 0;
+	while (retries < SHM_MAX_RETRIES) {
+		int fd = shm_open(name.c_str(), O_RDWR, 0600);
+		if (fd != -1) {
+			struct stat st;
+			void* ptr = MAP_FAILED;
+			if (fstat(fd, &st) == 0 && st.st_size > (off_t)sizeof(shm_ring_header_t)) {
+				ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			}
+			::close(fd);
+			if (ptr != MAP_FAILED) {
+				shm_ring_header_t* h = (shm_ring_header_t*)ptr;
+				/* the segment must be initialized and not belong to a
+				 * finished execution */
+				if (atomicLoad(&h->magic) == SHM_MAGIC && !atomicLoad(&h->readerClosed)) {
+					header = h;
+					cells = (cell_t*)(header+1);
+					mapSize = st.st_size;
+					header->readerPid = getpid();
+					fprintf(stderr, "ShmCellsRing: attached to %s\n", name.c_str());
+					return;
+				}
+				munmap(ptr, st.st_size);
+			}
+		}
+		if (retries % 100 == 0) {
+			fprintf(stderr, "ShmCellsRing: waiting for %s [Retry %d/%d].\n", name.c_str(),
+					retries, SHM_MAX_RETRIES);
+		}
+		retries++;
+		usleep(SHM_RETRY_USECS);
+	}
+	fprintf(stderr, "ShmCellsRing: could not attach to %s. Aborting\n", name.c_str());
+	exit(-1);
+}
+
+bool ShmCellsRing::isPeerAlive() {
+	int pid = writer ? header->readerPid : header->writerPid;
+	if (pid == 0) {
+		return true; // the reader did not attach yet
+	}
+	return !(kill(pid, 0) == -1 && errno == ESRCH);
+}
+
+/*
+ * Sleeps until the futex word seq changes. The waiting flag is raised
+ * before the condition is checked again by the caller, so a change made
+ * by the other side after this point is always followed by a wake.
+ * Returns false if the other process is gone.
+ */
+bool ShmCellsRing::waitChange(volatile int* seq, volatile int* waiting, bool forData) {
+	int value = atomicLoad(seq);
+	atomicStore(waiting, 1);
+
+	/* checks the condition again after raising the flag */
+	bool ready;
+	if (forData) {
+		ready = atomicLoad(&header->tail) != header->head || atomicLoad(&header->writerClosed);
+	} else {
+		ready = header->tail - atomicLoad(&header->head) < header->capacity || atomicLoad(&header->readerClosed);
+	}
+	if (!ready) {
+		struct timespec timeout;
+		timeout.tv_sec = SHM_WAIT_MS/1000;
+		timeout.tv_nsec = (SHM_WAIT_MS%1000)*1000000L;
+		statWaits++;
+		syscall(SYS_futex, seq, FUTEX_WAIT, value, &timeout, NULL, 0);
+	}
+	atomicStore(waiting, 0);
+	return isPeerAlive();
+}
+
+/*
+ * Sleeps until the reader closes the ring. The reader raises readerClosed
+ * before it changes spaceSeq and wakes it, so reading the futex word before
+ * checking the flag does not miss the close. Returns false if the reader
+ * is gone.
+ */
+bool ShmCellsRing::waitReaderClosed() {
+	while (true) {
+		int value = atomicLoad(&header->spaceSeq);
+		if (atomicLoad(&header->readerClosed)) {
+			return true;
+		}
+		struct timespec timeout;
+		timeout.tv_sec = SHM_WAIT_MS/1000;
+		timeout.tv_nsec = (SHM_WAIT_MS%1000)*1000000L;
+		statWaits++;
+		syscall(SYS_futex, &header->spaceSeq, FUTEX_WAIT, value, &timeout, NULL, 0);
+		if (!isPeerAlive()) {
+			return false;
+		}
+	}
+}
+
+void ShmCellsRing::wake(volatile int* seq, volatile int* waiting) {
+	if (atomicLoad(waiting)) {
+		__atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+		statWakes++;
+	}
+}
+
+int ShmCellsRing::write(const cell_t* buf, int len) {
+	if (header == NULL) return -1;
+	int capacity = header->capacity;
+	int done = 0;
+	while (done < len) {
+		long long tail = header->tail;
+		long long free = capacity - (tail - atomicLoad(&header->head));
+		if (free == 0) {
+			if (atomicLoad(&header->readerClosed)) {
+				fprintf(stderr, "ShmCellsRing: reader of %s finished before the end of the stream.\n", name.c_str());
+				return -1;
+			}
+			if (!waitChange(&header->spaceSeq, &header->writerWaiting, false)) {
+				fprintf(stderr, "ShmCellsRing: reader of %s is gone.\n", name.c_str());
+				return -1;
+			}
+			continue;
+		}
+		int n = len-done;
+		if (n > free) n = free;
+		int pos = tail & (capacity-1);
+		int n0 = capacity - pos;
+		if (n0 > n) n0 = n;
+		memcpy(cells+pos, buf+done, n0*sizeof(cell_t));
+		memcpy(cells, buf+done+n0, (n-n0)*sizeof(cell_t));
+		atomicStore(&header->tail, tail+n);
+		wake(&header->dataSeq, &header->readerWaiting);
+		done += n;
+	}
+	statCells += len;
+	return len;
+}
+
+int ShmCellsRing::read(cell_t* buf, int len, bool partial) {
+	if (header == NULL) return 0;
+	int capacity = header->capacity;
+	int done = 0;
+	while (done < len) {
+		long long head = header->head;
+		long long avail = atomicLoad(&header->tail) - head;
+		if (avail == 0) {
+			if (done > 0 && partial) {
+				break;
+			}
+			if (atomicLoad(&header->writerClosed) && atomicLoad(&header->tail) == head) {
+				break; // end of stream
+			}
+			if (!waitChange(&header->dataSeq, &header->readerWaiting, true)) {
+				fprintf(stderr, "ShmCellsRing: writer of %s is gone.\n", name.c_str());
+				return -1;
+			}
+			continue;
+		}
+		int n = len-done;
+		if (n > avail) n = avail;
+		int pos = head & (capacity-1);
+		int n0 = capacity - pos;
+		if (n0 > n) n0 = n;
+		memcpy(buf+done, cells+pos, n0*sizeof(cell_t));
+		memcpy(buf+done+n0, cells, (n-n0)*sizeof(cell_t));
+		atomicStore(&header->head, head+n);
+		wake(&header->spaceSeq, &header->writerWaiting);
+		done += n;
+	}
+	statCells += done;
+	return done;
+}
+
+void ShmCellsRing::close() {
+	if (header == NULL) return;
+	if (writer) {
+		atomicStore(&header->writerClosed, 1);
+		__atomic_add_fetch(&header->dataSeq, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, &header->dataSeq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+
+		/* As the SocketCellsWriter, waits for the reader to finish */
+		fprintf(stderr, "ShmCellsRing: waiting for the reader of %s to finish...\n", name.c_str());
+		if (!waitReaderClosed()) {
+			fprintf(stderr, "ShmCellsRing: reader of %s is gone.\n", name.c_str());
+		}
+		shm_unlink(name.c_str());
+	} else {
+		atomicStore(&header->readerClosed, 1);
+		__atomic_add_fetch(&header->spaceSeq, 1, __ATOMIC_SEQ_CST);
+		syscall(SYS_futex, &header->spaceSeq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+	fprintf(stderr, "ShmCellsRing::close(): %s - %s\n", name.c_str(), getStatistics().c_str());
+	munmap(header, mapSize);
+	header = NULL;
+	cells = NULL;
+}
+
+string ShmCellsRing::getStatistics() {
+	char str[200];
+	sprintf(str, "%lld cells, %lld futex waits, %lld futex wakes", statCells, statWaits, statWakes);
+	return string(str);
+}
@@ -0,0 +1,122 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef SHMCELLSRING_HPP_
+#define SHMCELLSRING_HPP_
+
+#include "../../libmasa/libmasaTypes.hpp"
+#include <string>
+using namespace std;
+
+/** Capacity (in cells) of the rings created by the writers (8MB) */
+#define SHM_RING_CAPACITY	(1024*1024)
+
+/**
+ * Header of the shared memory segment. The producer and consumer positions
+ * are kept in different cache lines.
+ */
+struct shm_ring_header_t {
+	int magic;
+	int capacity;
+	int writerPid;
+	int readerPid;
+	char pad0[48];
+
+	/* written by the writer */
+	volatile long long tail;
+	volatile int writerClosed;
+	volatile int dataSeq;       // futex word: changes when cells are published
+	volatile int writerWaiting;
+	char pad1[44];
+
+	/* written by the reader */
+	volatile long long head;
+	volatile int readerClosed;
+	volatile int spaceSeq;      // futex word: changes when cells are consumed
+	volatile int readerWaiting;
+	char pad2[44];
+};
+
+/**
+ * Single-producer/single-consumer ring of cells in a POSIX shared memory
+ * segment, used to exchange the border columns between processes of the
+ * same host. The blocked side sleeps in a futex, that is only woken if it
+ * announced that it is waiting, so the fast path has no system call.
+ *
+ * The writer creates the segment and the reader attaches to it, waiting
+ * for its creation. While blocked, each side periodically checks if the
+ * other process is still alive.
+ */
+class ShmCellsRing {
+public:
+	/**
+	 * Creates (writer) or attaches to (reader) the shared ring.
+	 *
+	 * @param name name of the ring (without slashes).
+	 * @param writer true for the producer side.
+	 */
+	ShmCellsRing(string name, bool writer);
+	virtual ~ShmCellsRing();
+
+	/**
+	 * Stores len cells, blocking while the ring is full.
+	 * @return len, or -1 if the reader process is gone.
+	 */
+	int write(const cell_t* buf, int len);
+
+	/**
+	 * Loads up to len cells, blocking while the ring is empty.
+	 *
+	 * @param partial if true, returns as soon as some cells were loaded.
+	 * @return the number of cells loaded (0 after the end of the stream),
+	 * 	or -1 if the writer process is gone.
+	 */
+	int read(cell_t* buf, int len, bool partial);
+
+	/**
+	 * Finishes this side of the ring. The writer waits for the reader to
+	 * finish before removing the segment.
+	 */
+	void close();
+
+	/** @return a short description of the transfer statistics */
+	string getStatistics();
+
+private:
+	string name;
+	bool writer;
+	shm_ring_header_t* header;
+	cell_t* cells;
+	size_t mapSize;
+
+	long long statCells;
+	long long statWaits;
+	long long statWakes;
+
+	void create();
+	void attach();
+	bool waitChange(volatile int* seq, volatile int* waiting, bool forData);
+	bool waitReaderClosed();
+	void wake(volatile int* seq, volatile int* waiting);
+	bool isPeerAlive();
+};
+
+#endif /* SHMCELLSRING_HPP_ */
@@ -0,0 +1,50 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef SHMCELLSWRITER_HPP_
+#define SHMCELLSWRITER_HPP_
+
+#include "CellsWriter.hpp"
+#include "ShmCellsRing.hpp"
+#include <string>
+using namespace std;
+
+/**
+ * Sends the cells to a ShmCellsReader of the same host through a shared
+ * memory ring (URL shm://NAME).
+ */
+class ShmCellsWriter: public CellsWriter {
+public:
+	ShmCellsWriter(string name, string shared_path);
+	virtual ~ShmCellsWriter();
+	virtual void close();
+
+	virtual int write(const cell_t* buf, int len);
+private:
+	string name;
+	string failure_signal_path;
+	ShmCellsRing* ring;
+
+	void failureSignal();
+};
+
+#endif /* SHMCELLSWRITER_HPP_ */
@@ -34,6 +34,8 @@ SocketCellsReader::SocketCellsReader(string hostname, int port, string shared_pa
     this->hostname = hostname;
     this->port = port;
     this->socketfd = -1;
+    this->statCells = 0;
+    this->statSyscalls = 0;
     this->failure_signal_path = shared_path+"/failure.txt";
     removeOldFiles();
     init();
@@ -49,7 +51,8 @@ void SocketCellsReader::removeOldFiles() {
 
 void SocketCellsReader::close() {
     sendFinishMessage();
-    fprintf(stderr, "SocketCellsReader::close(): %d\n", socketfd);
+    fprintf(stderr, "SocketCellsReader::close(): %d - %lld cells in %lld recv calls (%.1f cells/call)\n",
+    		socketfd, statCells, statSyscalls, statSyscalls > 0 ? (float)statCells/statSyscalls : 0.0f);
     if (socketfd != -1) {
         ::close(socketfd);
         socketfd = -1;
@@ -82,38 +85,69 @@ void SocketCellsReader::sendFinishMessage() {
     send(socketfd, verification, 10, MSG_NOSIGNAL);
 }
 
-int SocketCellsReader::read(cell_t* buf, int len) {
-    int pos=0, tries=3;//, tentativas = 0;
-    FILE* end_exec_signal; FILE* close_socket;
-    bool signalOk;
-
-    while (pos < len*sizeof(cell_t)) {
-    	int ret = recv(socketfd, (void*)(((unsigned char*)buf)+pos), len*sizeof(cell_t), 0);
+/*
+ * Receives up to len bytes with a single recv call. Returns the number of
+ * bytes received or -1 if the connection was lost. The tries counter is
+ * shared by all the calls of the same read operation.
+ */
+int SocketCellsReader::receive(unsigned char* buf, int len, int* tries) {
+    int ret = recv(socketfd, (void*)buf, len, 0);
+    statSyscalls++;
 
     /* This region of the function was created in order to check the return of the recv function.
     *  If the return is 0, it means that a package of 0 bytes has been received, which probably
     * indicates a disconnection. If the socket was in fact closed, after some tries, the return
     * of recv will be -1, which means for sure that the connection was closed.
     */
-        while(ret == 0 && tries > 0) { //if amount of bytes received is zero, most likely the socket has been closed
-            ret = recv(socketfd, (void*)(((unsigned char*)buf)+pos), len*sizeof(cell_t), MSG_NOSIGNAL);
-            tries --;
-            printf("SCR: Trying %d \n", 3-tries);
-            sleep(2);
-        } 
-        if (tries == 0) {
-            printf("~~~~Connection Lost!~~~~\n");
-            ::close(socketfd);
-            failureSignal();
-            break;
-        }
-        if (ret == -1) {
-        	::close(socketfd);
-            fprintf(stderr, "recv: Socket error -1\n");
-            break;
-        }
+    while(ret == 0 && *tries > 0) { //if amount of bytes received is zero, most likely the socket has been closed
+        ret = recv(socketfd, (void*)buf, len, MSG_NOSIGNAL);
+        statSyscalls++;
+        (*tries)--;
+        printf("SCR: Trying %d \n", 3-*tries);
+        sleep(2);
+    } 
+    if (*tries == 0) {
+        printf("~~~~Connection Lost!~~~~\n");
+        ::close(socketfd);
+        failureSignal();
+        return -1;
+    }
+    if (ret == -1) {
+    	::close(socketfd);
+        fprintf(stderr, "recv: Socket error -1\n");
+        return -1;
+    }
+    return ret;
+}
+
+int SocketCellsReader::read(cell_t* buf, int len) {
+    int pos=0, tries=3;
+    int size = len*sizeof(cell_t);
+
+    while (pos < size) {
+        int ret = receive(((unsigned char*)buf)+pos, size-pos, &tries);
+        if (ret == -1) break;
         pos += ret; 
     }
+    statCells += pos/sizeof(cell_t);
+    return pos/sizeof(cell_t);
+}
+
+int SocketCellsReader::readAvailable(cell_t* buf, int len) {
+    int tries=3;
+
+    /* A single recv returns all the bytes already received by the kernel
+     * (up to len cells). Only the last partial cell must be completed. */
+    int pos = receive((unsigned char*)buf, len*sizeof(cell_t), &tries);
+    if (pos == -1) {
+        return -1;
+    }
+    while (pos % sizeof(cell_t) != 0) {
+        int ret = receive(((unsigned char*)buf)+pos, sizeof(cell_t) - pos%sizeof(cell_t), &tries);
+        if (ret == -1) break;
+        pos += ret;
+    }
+    statCells += pos/sizeof(cell_t);
     return pos/sizeof(cell_t);
 }
 
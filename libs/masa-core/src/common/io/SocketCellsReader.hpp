@@ -34,6 +34,7 @@ public:
 
 	virtual int getType();
 	virtual int read(cell_t* buf, int len);
+	virtual int readAvailable(cell_t* buf, int len);
 	virtual int readInt(global_score_t* score);
 
 private:
@@ -42,7 +43,12 @@ private:
     int port;
     int socketfd;
 
+    /** Statistics: cells read and recv system calls */
+    long long statCells;
+    long long statSyscalls;
+
     void init();
+    int receive(unsigned char* buf, int len, int* tries);
 	void sendFinishMessage();
 	void failureSignal();
 	void removeOldFiles();
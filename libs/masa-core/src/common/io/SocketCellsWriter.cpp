@@ -27,16 +27,25 @@
 #include <stdlib.h>
 
 #include <sys/socket.h> /* for socket(), bind(), and connect() */
+#include <sys/uio.h>    /* for iovec */
 #include <arpa/inet.h>  /* for sockaddr_in and inet_ntoa() */
 #include <errno.h>
 
 #define DEBUG (0)
 
+/* Maximum number of segments gathered in each sendmsg call */
+#define MAX_IOV (16)
+
+/* Seconds waiting for the socket to accept more data before a retry */
+#define ISOPEN_TIMEOUT (2)
+
 SocketCellsWriter::SocketCellsWriter(string hostname, int port, string shared_path) {
     this->failure_signal_path = shared_path+"/failure.txt";
     this->hostname = hostname;
     this->port = port;
     this->socketfd = -1;
+    this->statCells = 0;
+    this->statSyscalls = 0;
     init();
 }
 
@@ -46,7 +55,8 @@ SocketCellsWriter::~SocketCellsWriter() {
 
 void SocketCellsWriter::close() {
     waitForFinishMessage();
-    fprintf(stderr, "SocketCellsWriter::close(): %d\n", socketfd);
+    fprintf(stderr, "SocketCellsWriter::close(): %d - %lld cells in %lld send calls (%.1f cells/call)\n",
+    		socketfd, statCells, statSyscalls, statSyscalls > 0 ? (float)statCells/statSyscalls : 0.0f);
     if (socketfd != -1) {
         ::close(socketfd);
         socketfd = -1;
@@ -54,7 +64,9 @@ void SocketCellsWriter::close() {
 }
 
 int SocketCellsWriter::isopen(int socket) {
-    struct timeval waiting_time; waiting_time.tv_usec = 1;
+    /* A full send buffer only means that the receiver is slower; the socket
+     * must be blocked for ISOPEN_TIMEOUT seconds to count as a failure. */
+    struct timeval waiting_time; waiting_time.tv_sec = ISOPEN_TIMEOUT; waiting_time.tv_usec = 0;
     int bytes_in_buffer = 0, ret_select;
 
     fd_set write_descriptor; //stores amount of descriptors to be analyzed
@@ -107,6 +119,38 @@ void SocketCellsWriter::failureSignal() {
 }
 
 int SocketCellsWriter::write(const cell_t* buf, int len) {
+    return writeVector(&buf, &len, 1);
+}
+
+int SocketCellsWriter::writeVector(const cell_t** bufs, const int* lens, int count) {
+    struct iovec iov[MAX_IOV];
+    int total = 0;
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (lens[i] == 0) continue;
+        iov[n].iov_base = (void*)bufs[i];
+        iov[n].iov_len = lens[i]*sizeof(cell_t);
+        n++;
+        total += lens[i];
+        if (n == MAX_IOV) {
+            if (sendVector(iov, n) == -1) {
+                return -1;
+            }
+            n = 0;
+        }
+    }
+    if (n > 0 && sendVector(iov, n) == -1) {
+        return -1;
+    }
+    statCells += total;
+    return total;
+}
+
+/*
+ * Sends all the bytes of the segments with sendmsg, resuming partial sends.
+ * Returns 0 on success or -1 if the connection was lost.
+ */
+int SocketCellsWriter::sendVector(struct iovec* iov, int count) {
     int tries=3, ret;
 
     /* This function was modified in order to detect a fail on the receiver GPU. In order to do this,
@@ -117,10 +161,17 @@ int SocketCellsWriter::write(const cell_t* buf, int len) {
     *  the 3 tries are over.
     */
 
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
     ret = -1;
-    while(ret==-1 && tries > 0) { //Checks if socket is closed for 3 times in order to check if connection is just slow
+    while(msg.msg_iovlen > 0 && tries > 0) { //Checks if socket is closed for 3 times in order to check if connection is just slow
+        ret = -1;
         if (isopen(socketfd)>0) {
-            ret = send(socketfd, buf, len*sizeof(cell_t), MSG_NOSIGNAL);
+            ret = sendmsg(socketfd, &msg, MSG_NOSIGNAL);
+            statSyscalls++;
             if(ret==-1) perror("send");
         }
         if (ret==-1) {
@@ -128,14 +179,27 @@ int SocketCellsWriter::write(const cell_t* buf, int len) {
             printf("SCW: Trying %d \n", 3-tries);
             perror("isopen or send");
             sleep(2);
+            continue;
+        }
+        tries = 3;
+        /* partial send: skips the segments already sent */
+        while (msg.msg_iovlen > 0 && ret >= (int)msg.msg_iov->iov_len) {
+            ret -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = ((unsigned char*)msg.msg_iov->iov_base) + ret;
+            msg.msg_iov->iov_len -= ret;
         }
     } 
     if (tries == 0) {
         printf("~~~~Connection Lost!~~~~\n");
         ::close(socketfd);
         failureSignal();
+        return -1;
     }
-    return ret;
+    return 0;
 }
 
 int SocketCellsWriter::writeInt(global_score_t* score) {
@@ -33,6 +33,7 @@ public:
 	virtual void close();
 
 	virtual int write(const cell_t* buf, int len);
+	virtual int writeVector(const cell_t** bufs, const int* lens, int count);
 	virtual int writeInt(global_score_t* score);
 private:
     string hostname;
@@ -40,7 +41,12 @@ private:
     int port;
     int socketfd;
 
+    /** Statistics: cells written and sendmsg system calls */
+    long long statCells;
+    long long statSyscalls;
+
     void init();
+    int sendVector(struct iovec* iov, int count);
 	int isopen(int socket);
 	void waitForFinishMessage();
 	void failureSignal();
@@ -24,6 +24,7 @@
 #include "FileCellsReader.hpp"
 #include "DummyCellsReader.hpp"
 #include "SocketCellsReader.hpp"
+#include "ShmCellsReader.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -37,6 +38,24 @@ URLCellsReader::URLCellsReader(string url, string shared_path) {
 	string type = url.substr(0, pos1);
 	string param = url.substr(pos1+3);
 
+	batchSize = 0;
+	int pos3 = param.find_first_of("?");
+	if (pos3 != -1) {
+		string options = param.substr(pos3+1);
+		param = param.substr(0, pos3);
+		while (options.size() > 0) {
+			int pos4 = options.find_first_of("&");
+			string option = options.substr(0, pos4);
+			options = (pos4 == -1) ? "" : options.substr(pos4+1);
+			if (option.compare(0, 6, "batch=") == 0) {
+				batchSize = atoi(option.substr(6).c_str());
+			} else {
+				fprintf(stderr, "URLCellsReader: Unknown URL option: %s\n", option.c_str());
+				exit(1);
+			}
+		}
+	}
+
 
 	fprintf(stderr, "%s:   %s - %s\n", url.c_str(), type.c_str(), param.c_str());
 	if (type == "socket") {
@@ -50,6 +69,8 @@ URLCellsReader::URLCellsReader(string url, string shared_path) {
 			hostname = param;
 		}
 		reader = new SocketCellsReader(hostname, port, shared_path);
+	} else if (type == "shm") {
+		reader = new ShmCellsReader(param, shared_path);
 	} else if (type == "file") {
 		reader = new FileCellsReader(param);
 	} else if (type == "null") {
@@ -79,3 +100,11 @@ int URLCellsReader::getType() {
 int URLCellsReader::read(cell_t* buf, int len) {
 	return reader->read(buf, len);
 }
+
+int URLCellsReader::readAvailable(cell_t* buf, int len) {
+	return reader->readAvailable(buf, len);
+}
+
+int URLCellsReader::getBatchSize() const {
+	return batchSize;
+}
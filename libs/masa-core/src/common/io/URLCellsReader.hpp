@@ -34,9 +34,17 @@ public:
 
 	virtual int getType();
 	virtual int read(cell_t* buf, int len);
+	virtual int readAvailable(cell_t* buf, int len);
+
+	/**
+	 * @return the batch size given by the "batch" option of the URL
+	 * 	(e.g. socket://hostname:5000?batch=8192), or 0.
+	 */
+	int getBatchSize() const;
 
 private:
 	CellsReader* reader;
+	int batchSize;
 
 };
 
@@ -23,6 +23,7 @@
 #include "FileCellsWriter.hpp"
 #include "DummyCellsWriter.hpp"
 #include "SocketCellsWriter.hpp"
+#include "ShmCellsWriter.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,6 +39,27 @@ URLCellsWriter::URLCellsWriter(string url, string shared_path) {
 	string type = url.substr(0, pos1);
 	string param = url.substr(pos1+3);
 
+	batchSize = 0;
+	flushDeadline = 0;
+	int pos3 = param.find_first_of("?");
+	if (pos3 != -1) {
+		string options = param.substr(pos3+1);
+		param = param.substr(0, pos3);
+		while (options.size() > 0) {
+			int pos4 = options.find_first_of("&");
+			string option = options.substr(0, pos4);
+			options = (pos4 == -1) ? "" : options.substr(pos4+1);
+			if (option.compare(0, 6, "batch=") == 0) {
+				batchSize = atoi(option.substr(6).c_str());
+			} else if (option.compare(0, 9, "deadline=") == 0) {
+				flushDeadline = atof(option.substr(9).c_str())/1000.0f;
+			} else {
+				fprintf(stderr, "URLCellsWriter: Unknown URL option: %s\n", option.c_str());
+				exit(1);
+			}
+		}
+	}
+
 
 	fprintf(stderr, "%s:   %s - %s\n", url.c_str(), type.c_str(), param.c_str());
 	if (type == "socket") {
@@ -51,6 +73,8 @@ URLCellsWriter::URLCellsWriter(string url, string shared_path) {
 			hostname = param;
 		}
 		writer = new SocketCellsWriter(hostname, port, shared_path);
+	} else if (type == "shm") {
+		writer = new ShmCellsWriter(param, shared_path);
 	} else if (type == "file") {
 		lastgpu = 1;
 		//printf("#### @F: LAST GPU! ####\n");
@@ -77,3 +101,15 @@ void URLCellsWriter::close() {
 int URLCellsWriter::write(const cell_t* buf, int len) {
 	return writer->write(buf, len);
 }
+
+int URLCellsWriter::writeVector(const cell_t** bufs, const int* lens, int count) {
+	return writer->writeVector(bufs, lens, count);
+}
+
+int URLCellsWriter::getBatchSize() const {
+	return batchSize;
+}
+
+float URLCellsWriter::getFlushDeadline() const {
+	return flushDeadline;
+}
@@ -33,9 +33,24 @@ public:
 	virtual void close();
 
 	virtual int write(const cell_t* buf, int len);
+	virtual int writeVector(const cell_t** bufs, const int* lens, int count);
+
+	/**
+	 * @return the batch size given by the "batch" option of the URL
+	 * 	(e.g. socket://0.0.0.0:5000?batch=8192&deadline=0.5), or 0.
+	 */
+	int getBatchSize() const;
+
+	/**
+	 * @return the flush deadline (in seconds) given in milliseconds by
+	 * 	the "deadline" option of the URL, or 0.
+	 */
+	float getFlushDeadline() const;
 
 private:
 	CellsWriter* writer;
+	int batchSize;
+	float flushDeadline;
 };
 
 #endif /* URLCELLSWRITER_HPP_ */
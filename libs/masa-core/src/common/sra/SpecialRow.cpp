@@ -49,6 +49,12 @@ int SpecialRow::getType() {
 	return INIT_WITH_CUSTOM_DATA;
 }
 
+/*
+ * @see description on header file
+ */
+void SpecialRow::prefetch() {
+}
+
 /*
  * @see description on header file
  */
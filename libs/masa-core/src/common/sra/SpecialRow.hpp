@@ -121,6 +121,13 @@ public:
 	 */
 	virtual void truncateRow(int size) = 0;
 
+	/**
+	 * Hints that the row will be read soon. Rows stored in files ask the
+	 * kernel to start reading them in background; the default
+	 * implementation does nothing.
+	 */
+	virtual void prefetch();
+
 protected:
 
 	/**
@@ -0,0 +1,516 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include "SpecialRowCompressed.hpp"
+#include "../configs/Configs.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEBUG (0)
+
+/** "SRZ1" */
+#define COMPRESSED_ROW_MAGIC	(0x315A5253)
+
+/** Escape markers of the fixed size modes */
+#define ESCAPE_8BITS	(-128)
+#define ESCAPE_4BITS	(-8)
+
+long long SpecialRowCompressed::totalRawBytes = 0;
+long long SpecialRowCompressed::totalCompressedBytes = 0;
+
+/*
+ * The differences are computed in unsigned arithmetic, so any pair of
+ * values (including -INF) is reversible.
+ */
+static inline unsigned int zigzag(unsigned int d) {
+	return (d << 1) ^ (unsigned int)(((int)d) >> 31);
+}
+
+static inline unsigned int unzigzag(unsigned int z) {
+	return (z >> 1) ^ (0u - (z & 1));
+}
+
+static inline unsigned char* putVarint(unsigned char* p, unsigned int v) {
+	while (v >= 0x80) {
+		*p++ = (v & 0x7F) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+static inline const unsigned char* getVarint(const unsigned char* p, unsigned int* v) {
+	unsigned int value = 0;
+	int shift = 0;
+	while (*p & 0x80) {
+		value |= (*p++ & 0x7F) << shift;
+		shift += 7;
+	}
+	*v = value | (*p++ << shift);
+	return p;
+}
+
+static inline unsigned char* putInt(unsigned char* p, unsigned int v) {
+	memcpy(p, &v, sizeof(v));
+	return p + sizeof(v);
+}
+
+static inline const unsigned char* getInt(const unsigned char* p, unsigned int* v) {
+	memcpy(v, p, sizeof(*v));
+	return p + sizeof(*v);
+}
+
+/*
+ * @see description on header file
+ */
+SpecialRowCompressed::SpecialRowCompressed(string* path, string filename) {
+	this->path = path;
+	this->filename = filename.substr(0, 8);
+	this->file = NULL;
+	this->cells = NULL;
+	this->data = NULL;
+	memset(&header, 0, sizeof(header));
+	int id = -1;
+	if (filename.length() == 8 + 2 && isCompressedFilename(filename)) {
+		sscanf(filename.c_str(), "%X", &id);
+	} else if (isCompressedFilename(filename)) {
+		string fullFile = ((*path) + "/" + filename);
+		remove(fullFile.c_str());
+	}
+	setId(id);
+}
+
+/*
+ * @see description on header file
+ */
+SpecialRowCompressed::SpecialRowCompressed(string* path, int id, int mode) {
+	this->path = path;
+	this->file = NULL;
+	this->cells = NULL;
+	this->data = NULL;
+	memset(&header, 0, sizeof(header));
+	header.mode = mode;
+	setId(id);
+
+	char str[256];
+	sprintf(str, "%08X", id);
+	this->filename = string(str);
+}
+
+/*
+ * @see description on header file
+ */
+SpecialRowCompressed::~SpecialRowCompressed() {
+	close();
+}
+
+/*
+ * @see description on header file
+ */
+bool SpecialRowCompressed::isCompressedFilename(string filename) {
+	if (filename.length() == 8 + 2) {
+		return filename.compare(8, 2, SRA_COMPRESSED_SUFFIX) == 0;
+	} else if (filename.length() == 8 + 2 + 4) {
+		return filename.compare(8, 6, SRA_COMPRESSED_SUFFIX ".tmp") == 0;
+	}
+	return false;
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowCompressed::initialize(bool readOnly, int) {
+	string filename = getFullFilename(!readOnly);
+	file = fopen(filename.c_str(), readOnly ? "rb" : "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not %s special row: %s\n", readOnly?"open":"create",
+				filename.c_str());
+		perror("fopen()");
+		exit(1);
+	}
+	index.clear();
+	if (readOnly) {
+		readHeader();
+	} else {
+		int mode = header.mode;
+		memset(&header, 0, sizeof(header));
+		header.magic = COMPRESSED_ROW_MAGIC;
+		header.mode = mode;
+		header.blockSize = SRA_COMPRESSED_BLOCK_SIZE;
+		fwrite(&header, sizeof(header), 1, file);
+		fileOffset = sizeof(header);
+		pending = 0;
+	}
+	cells = (cell_t*)malloc(header.blockSize*sizeof(cell_t));
+	data = (unsigned char*)malloc(maxEncodedSize(header.blockSize));
+	cachedBlock = -1;
+}
+
+/*
+ * Loads the header and the blocks index of the opened file.
+ */
+void SpecialRowCompressed::readHeader() {
+	if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != COMPRESSED_ROW_MAGIC) {
+		fprintf(stderr, "Invalid compressed special row: %s\n", getFullFilename(false).c_str());
+		exit(1);
+	}
+	index.resize(header.blockCount);
+	fseek(file, header.indexOffset, SEEK_SET);
+	if (header.blockCount > 0 && fread(&index[0], sizeof(long long), header.blockCount, file) != (size_t)header.blockCount) {
+		fprintf(stderr, "Could not read the index of the special row: %s\n", getFullFilename(false).c_str());
+		exit(1);
+	}
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowCompressed::close() {
+	if (file != NULL) {
+		bool writing = (header.indexOffset == 0);
+		if (writing) {
+			flushBlock();
+			header.indexOffset = fileOffset;
+			header.blockCount = index.size();
+			if (header.blockCount > 0) {
+				fwrite(&index[0], sizeof(long long), header.blockCount, file);
+			}
+			fseek(file, 0, SEEK_SET);
+			fwrite(&header, sizeof(header), 1, file);
+
+			__sync_add_and_fetch(&totalRawBytes, header.length*(long long)sizeof(cell_t));
+			__sync_add_and_fetch(&totalCompressedBytes,
+					(long long)(header.indexOffset + header.blockCount*sizeof(long long)));
+		}
+		fclose(file);
+		file = NULL;
+		if (writing) {
+			string filenameTmp = getFullFilename(true);
+			string filenameDef = getFullFilename(false);
+			rename(filenameTmp.c_str(), filenameDef.c_str());
+		}
+		index.clear();
+	}
+	if (cells != NULL) {
+		free(cells);
+		cells = NULL;
+	}
+	if (data != NULL) {
+		free(data);
+		data = NULL;
+	}
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowCompressed::prefetch() {
+	int fd = ::open(getFullFilename(false).c_str(), O_RDONLY);
+	if (fd != -1) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		::close(fd);
+	}
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowCompressed::truncateRow(int size) {
+	string filenameDef = getFullFilename(false);
+	if (size == 0) {
+		remove(filenameDef.c_str());
+		return;
+	}
+	FILE* f = fopen(filenameDef.c_str(), "r+b");
+	if (f == NULL) {
+		return;
+	}
+	compressed_row_header_t h;
+	if (fread(&h, sizeof(h), 1, f) == 1 && h.magic == COMPRESSED_ROW_MAGIC && size < h.length) {
+		/* Keeps the blocks containing the first size cells and rewrites
+		 * the index just after them. */
+		int blocks = (size + h.blockSize - 1)/h.blockSize;
+		vector<long long> idx(h.blockCount);
+		fseek(f, h.indexOffset, SEEK_SET);
+		if (fread(&idx[0], sizeof(long long), h.blockCount, f) == (size_t)h.blockCount) {
+			h.indexOffset = (blocks < h.blockCount) ? idx[blocks] : h.indexOffset;
+			h.blockCount = blocks;
+			h.length = size;
+			fseek(f, h.indexOffset, SEEK_SET);
+			fwrite(&idx[0], sizeof(long long), blocks, f);
+			fseek(f, 0, SEEK_SET);
+			fwrite(&h, sizeof(h), 1, f);
+			fflush(f);
+			if (ftruncate(fileno(f), h.indexOffset + blocks*sizeof(long long))) {
+				perror("ftruncate()");
+			}
+		}
+	}
+	fclose(f);
+}
+
+/*
+ * @see description on header file
+ */
+int SpecialRowCompressed::write(const cell_t* buf, int, int len) {
+	int pos = 0;
+	while (pos < len) {
+		int n = header.blockSize - pending;
+		if (n > len-pos) {
+			n = len-pos;
+		}
+		memcpy(cells+pending, buf+pos, n*sizeof(cell_t));
+		pending += n;
+		pos += n;
+		if (pending == header.blockSize) {
+			flushBlock();
+		}
+	}
+	header.length += len;
+	return len;
+}
+
+/*
+ * Encodes the pending cells and appends them to the file.
+ */
+void SpecialRowCompressed::flushBlock() {
+	if (pending == 0) return;
+	int size = encode(header.mode, cells, pending, data);
+	if (fwrite(data, 1, size, file) != (size_t)size) {
+		fprintf(stderr, "Could not write bytes to special row: %s\n", filename.c_str());
+		perror("SpecialRowCompressed::flushBlock");
+		exit(1);
+	}
+	index.push_back(fileOffset);
+	fileOffset += size;
+	pending = 0;
+}
+
+/*
+ * @see description on header file
+ */
+int SpecialRowCompressed::read(cell_t* buf, int offset, int len) {
+	if (DEBUG) printf("SpecialRowCompressed::read(%p, %d, %d): %s\n", buf, offset, len, filename.c_str());
+	if (offset + len > header.length) {
+		len = header.length - offset;
+	}
+	int pos = 0;
+	while (pos < len) {
+		int block = (offset+pos)/header.blockSize;
+		int k = (offset+pos) - block*header.blockSize;
+		loadBlock(block);
+		int n = header.blockSize - k;
+		if (n > len-pos) {
+			n = len-pos;
+		}
+		memcpy(buf+pos, cells+k, n*sizeof(cell_t));
+		pos += n;
+	}
+	return pos;
+}
+
+/*
+ * Decodes a block into the cells buffer.
+ */
+void SpecialRowCompressed::loadBlock(int block) {
+	if (block == cachedBlock) return;
+	long long start = index[block];
+	long long end = (block+1 < header.blockCount) ? index[block+1] : header.indexOffset;
+	fseek(file, start, SEEK_SET);
+	if (fread(data, 1, end-start, file) != (size_t)(end-start)) {
+		fprintf(stderr, "Error: could not read block %d of special row %s.\n", block, filename.c_str());
+		exit(1);
+	}
+	int n = header.length - block*header.blockSize;
+	if (n > header.blockSize) {
+		n = header.blockSize;
+	}
+	decode(header.mode, data, cells, n);
+	cachedBlock = block;
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowCompressed::extract(string filename, string destination) {
+	int slash = filename.find_last_of('/');
+	string dir = filename.substr(0, slash);
+	SpecialRowCompressed row(&dir, filename.substr(slash+1));
+	row.open(true);
+	FILE* out = fopen(destination.c_str(), "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Could not create file (%s).\n", destination.c_str());
+		exit(1);
+	}
+	cell_t* buf = (cell_t*)malloc(row.header.blockSize*sizeof(cell_t));
+	for (int offset = 0; offset < row.header.length; ) {
+		int n = row.read(buf, offset, row.header.blockSize);
+		fwrite(buf, sizeof(cell_t), n, out);
+		offset += n;
+	}
+	free(buf);
+	fclose(out);
+	row.close();
+}
+
+/*
+ * @see description on header file
+ */
+float SpecialRowCompressed::getCompressionRatio() {
+	if (totalCompressedBytes == 0) {
+		return 1.0f;
+	}
+	return (float)totalRawBytes/totalCompressedBytes;
+}
+
+/*
+ * Maximum size of an encoded block: the first cell plus two escaped
+ * differences per cell.
+ */
+int SpecialRowCompressed::maxEncodedSize(int len) {
+	return sizeof(cell_t) + len*2*(1+sizeof(int));
+}
+
+/*
+ * Encodes len cells in the data vector, returning the number of bytes used.
+ */
+int SpecialRowCompressed::encode(int mode, const cell_t* cells, int len, unsigned char* data) {
+	unsigned char* p = data;
+	if (mode == SRA_COMPRESSION_NONE) {
+		memcpy(p, cells, len*sizeof(cell_t));
+		return len*sizeof(cell_t);
+	}
+	memcpy(p, &cells[0], sizeof(cell_t));
+	p += sizeof(cell_t);
+
+	unsigned int h0 = cells[0].h;
+	unsigned int e0 = cells[0].e;
+	for (int i=1; i<len; i++) {
+		unsigned int h1 = cells[i].h;
+		unsigned int e1 = cells[i].e;
+		unsigned int dh = h1 - h0;
+		unsigned int de = e1 - e0;
+		switch (mode) {
+		case SRA_COMPRESSION_8BITS:
+			if ((int)dh > ESCAPE_8BITS && (int)dh <= 127) {
+				*p++ = (unsigned char)dh;
+			} else {
+				*p++ = (unsigned char)ESCAPE_8BITS;
+				p = putInt(p, dh);
+			}
+			if ((int)de > ESCAPE_8BITS && (int)de <= 127) {
+				*p++ = (unsigned char)de;
+			} else {
+				*p++ = (unsigned char)ESCAPE_8BITS;
+				p = putInt(p, de);
+			}
+			break;
+		case SRA_COMPRESSION_4BITS: {
+			bool eh = !((int)dh > ESCAPE_4BITS && (int)dh <= 7);
+			bool ee = !((int)de > ESCAPE_4BITS && (int)de <= 7);
+			*p++ = (((eh ? ESCAPE_4BITS : dh) & 0xF) << 4) | ((ee ? ESCAPE_4BITS : de) & 0xF);
+			if (eh) p = putInt(p, dh);
+			if (ee) p = putInt(p, de);
+			break;
+		}
+		case SRA_COMPRESSION_2_STEPS:
+			/* E follows H closely, so the distance H-E barely changes */
+			de = (h1 - e1) - (h0 - e0);
+			p = putVarint(p, zigzag(dh));
+			p = putVarint(p, zigzag(de));
+			break;
+		case SRA_COMPRESSION_VLC:
+		default:
+			p = putVarint(p, zigzag(dh));
+			p = putVarint(p, zigzag(de));
+			break;
+		}
+		h0 = h1;
+		e0 = e1;
+	}
+	return p - data;
+}
+
+/*
+ * Decodes len cells from the data vector.
+ */
+void SpecialRowCompressed::decode(int mode, const unsigned char* data, cell_t* cells, int len) {
+	const unsigned char* p = data;
+	if (mode == SRA_COMPRESSION_NONE) {
+		memcpy(cells, p, len*sizeof(cell_t));
+		return;
+	}
+	memcpy(&cells[0], p, sizeof(cell_t));
+	p += sizeof(cell_t);
+
+	unsigned int h = cells[0].h;
+	unsigned int e = cells[0].e;
+	for (int i=1; i<len; i++) {
+		unsigned int dh;
+		unsigned int de;
+		switch (mode) {
+		case SRA_COMPRESSION_8BITS:
+			dh = (int)(signed char)*p++;
+			if ((int)dh == ESCAPE_8BITS) p = getInt(p, &dh);
+			de = (int)(signed char)*p++;
+			if ((int)de == ESCAPE_8BITS) p = getInt(p, &de);
+			break;
+		case SRA_COMPRESSION_4BITS: {
+			signed char b = *p++;
+			dh = (int)(b >> 4);                       // arithmetic shift keeps the sign
+			de = (int)((signed char)(b << 4) >> 4);
+			if ((int)dh == ESCAPE_4BITS) p = getInt(p, &dh);
+			if ((int)de == ESCAPE_4BITS) p = getInt(p, &de);
+			break;
+		}
+		case SRA_COMPRESSION_VLC:
+		case SRA_COMPRESSION_2_STEPS:
+		default:
+			p = getVarint(p, &dh);
+			p = getVarint(p, &de);
+			dh = unzigzag(dh);
+			de = unzigzag(de);
+			break;
+		}
+		if (mode == SRA_COMPRESSION_2_STEPS) {
+			unsigned int d = (h - e) + de;
+			h += dh;
+			e = h - d;
+		} else {
+			h += dh;
+			e += de;
+		}
+		cells[i].h = h;
+		cells[i].e = e;
+	}
+}
+
+string SpecialRowCompressed::getFullFilename(bool temp) {
+	if (temp) {
+		return (*path) + "/" + filename + SRA_COMPRESSED_SUFFIX ".tmp";
+	} else {
+		return (*path) + "/" + filename + SRA_COMPRESSED_SUFFIX;
+	}
+}
@@ -0,0 +1,189 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#ifndef SPECIALROWCOMPRESSED_HPP_
+#define SPECIALROWCOMPRESSED_HPP_
+
+#include "SpecialRow.hpp"
+
+#include <vector>
+using namespace std;
+
+/** Number of cells encoded in each block of a compressed row */
+#define SRA_COMPRESSED_BLOCK_SIZE	(4096)
+
+/** Suffix of the compressed special row files */
+#define SRA_COMPRESSED_SUFFIX		".z"
+
+/**
+ * Header of the compressed special row file.
+ */
+struct compressed_row_header_t {
+	int magic;
+	int mode;			// SRA_COMPRESSION_* constant
+	int length;			// number of cells in the row
+	int blockSize;		// cells per block
+	int blockCount;
+	int reserved;
+	long long indexOffset;	// file position of the blocks index
+};
+
+/** @brief Class that stores an Special Row in the disk in a compressed format.
+ *
+ * Consecutive cells of a special row differ by small amounts, so the row is
+ * stored as the difference of each cell to the previous one. The cells are
+ * grouped in blocks of SRA_COMPRESSED_BLOCK_SIZE cells, each block starting
+ * with an uncompressed cell. An index with the file position of each block
+ * is stored at the end of the file, so any offset may be read decoding a
+ * single block.
+ *
+ * The differences are stored according to the SRA_COMPRESSION_* mode:
+ * <ul>
+ * <li>8bits: one signed byte for H and one for E;</li>
+ * <li>4bits: one byte per cell, with a signed nibble for H and E;</li>
+ * <li>vlc: variable length integers (7 bits per byte) for H and E;</li>
+ * <li>vlc-hilo: as vlc, but E is stored relative to the H of the same cell.</li>
+ * </ul>
+ * In the fixed size modes, the values that do not fit are escaped and
+ * stored in 4 bytes after the cell.
+ *
+ * As in the SpecialRowFile, a temporary file (*.z.tmp) is used while
+ * the row is in write mode.
+ */
+class SpecialRowCompressed : public SpecialRow {
+public:
+	/**
+	 * Creates a new Special Row associated with a given file.
+	 *
+	 * @param path the path to save this file.
+	 * @param filename the name of this file. The rowId is extracted from this
+	 *   name. If the filename is not a valid row name, rowId is set to -1.
+	 */
+	SpecialRowCompressed(string* path, string filename);
+
+	/**
+	 * Creates a new Special Row associated with a given rowId.
+	 *
+	 * @param path the path to save this file.
+	 * @param id the rowId of this file, relative to the partition.
+	 * @param mode the SRA_COMPRESSION_* mode used to store the row.
+	 */
+	SpecialRowCompressed(string* path, int id, int mode);
+
+	/**
+	 * Destroys any allocated resource previously allocated by this object.
+	 */
+	virtual ~SpecialRowCompressed();
+
+	/**
+	 * Closes the file. In write mode, the pending block and the index
+	 * are stored before closing.
+	 */
+	virtual void close();
+
+	/**
+	 * Truncates the file, discarding the blocks after the given size.
+	 *
+	 * @param size the number of cells to keep in the file.
+	 */
+	virtual void truncateRow(int size);
+
+	/**
+	 * Starts the readahead of the file (posix_fadvise WILLNEED).
+	 */
+	virtual void prefetch();
+
+	/**
+	 * Returns true if the filename is the name of a compressed row
+	 * (or of its temporary file).
+	 */
+	static bool isCompressedFilename(string filename);
+
+	/**
+	 * Decompresses a row file into a file of raw cells.
+	 *
+	 * @param filename the compressed row.
+	 * @param destination the file that will receive the cells.
+	 */
+	static void extract(string filename, string destination);
+
+	/**
+	 * Returns the ratio between the raw and the compressed size of all
+	 * the rows closed by this process.
+	 */
+	static float getCompressionRatio();
+
+private:
+	/** Dynamic path name of the partition. */
+	string* path;
+
+	/** File name basic prefix*/
+	string filename;
+
+	/** Opened file descriptor */
+	FILE* file;
+
+	/** Header of the file (in read mode) or the header being written. */
+	compressed_row_header_t header;
+
+	/** File position of each block */
+	vector<long long> index;
+
+	/** Cells of the block being written, or the last block decoded */
+	cell_t* cells;
+
+	/** Number of cells in the block being written */
+	int pending;
+
+	/** Block currently decoded in the cells buffer (read mode) */
+	int cachedBlock;
+
+	/** Encoded bytes of a block */
+	unsigned char* data;
+
+	/** Next write position of the file */
+	long long fileOffset;
+
+	/** Raw and compressed bytes of the closed rows (statistics) */
+	static long long totalRawBytes;
+	static long long totalCompressedBytes;
+
+	virtual void initialize(bool readOnly, int length);
+	virtual int write(const cell_t* buf, int offset, int len);
+	virtual int read(cell_t* buf, int offset, int len);
+
+	void flushBlock();
+	void loadBlock(int block);
+	void readHeader();
+
+	static int encode(int mode, const cell_t* cells, int len, unsigned char* data);
+	static void decode(int mode, const unsigned char* data, cell_t* cells, int len);
+	static int maxEncodedSize(int len);
+
+	/**
+	 * Returns the complete filename (with path) of the special row.
+	 * @param temp indicates if the filename is temporary or definitive.
+	 */
+	string getFullFilename(bool temp);
+};
+
+#endif /* SPECIALROWCOMPRESSED_HPP_ */
@@ -24,10 +24,19 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define DEBUG (0)
 
+/** Bytes requested ahead of the (backward) reading position */
+#define MMAP_READAHEAD		(8*1024*1024)
+
+/** Bytes consumed before they are released */
+#define MMAP_RELEASE		(8*1024*1024)
+
 /*
  * @see description on header file
  */
@@ -36,6 +45,8 @@ SpecialRowFile::SpecialRowFile(string* path, string filename)
 	this->path = path;
 	this->filename = filename;
 	this->file = NULL;
+	this->map = NULL;
+	this->mapCells = 0;
 	int id = -1;
 	if (filename.length() == 8) {
 		sscanf(filename.c_str(), "%X", &id);
@@ -54,6 +65,8 @@ SpecialRowFile::SpecialRowFile(string* path, int id)
 {
 	this->path = path;
 	this->file = NULL;
+	this->map = NULL;
+	this->mapCells = 0;
 	setId(id);
 
 	char str[256];
@@ -75,6 +88,9 @@ SpecialRowFile::~SpecialRowFile()
  */
 void SpecialRowFile::initialize(bool readOnly, int length) {
 	string filename = getFullFilename(!readOnly);
+	if (readOnly && mapFile(filename)) {
+		return;
+	}
 	file = fopen(filename.c_str(), readOnly ? "rb" : "wb");
 	if (file == NULL) {
 		fprintf(stderr, "Could not %s special row: %s\n", readOnly?"open":"create",
@@ -91,6 +107,16 @@ void SpecialRowFile::initialize(bool readOnly, int length) {
  * @see description on header file
  */
 void SpecialRowFile::close() {
+	if (map != NULL) {
+		munmap(map, mapCells*sizeof(cell_t));
+		map = NULL;
+		/* The row was consumed: drops it from the page cache. */
+		int fd = ::open(getFullFilename(false).c_str(), O_RDONLY);
+		if (fd != -1) {
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			::close(fd);
+		}
+	}
 	if (file != NULL) {
 		fclose(file);
 		file = NULL;
@@ -101,6 +127,17 @@ void SpecialRowFile::close() {
 	}
 }
 
+/*
+ * @see description on header file
+ */
+void SpecialRowFile::prefetch() {
+	int fd = ::open(getFullFilename(false).c_str(), O_RDONLY);
+	if (fd != -1) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		::close(fd);
+	}
+}
+
 /*
  * @see description on header file
  */
@@ -131,6 +168,14 @@ int SpecialRowFile::write(const cell_t* buf, int offset, int len) {
  */
 int SpecialRowFile::read(cell_t* buf, int offset, int len) {
 	if (DEBUG) printf("SpecialRowFile::read(%p, %d, %d): %s\n", buf, offset, len, filename.c_str());
+	if (map != NULL) {
+		if (offset + len > mapCells) {
+			len = (offset < mapCells) ? mapCells - offset : 0;
+		}
+		adviseMap(offset, len);
+		memcpy(buf, map + offset, len*sizeof(cell_t));
+		return len;
+	}
 	fseek(file, offset*sizeof(cell_t), SEEK_SET);
 	int pos = 0;
 	while (pos<len) {
@@ -143,6 +188,64 @@ int SpecialRowFile::read(cell_t* buf, int offset, int len) {
 	return pos;
 }
 
+/*
+ * @see description on header file
+ */
+bool SpecialRowFile::mapFile(const string& filename) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(cell_t)) {
+		::close(fd);
+		return false;
+	}
+	void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (ptr == MAP_FAILED) {
+		return false;
+	}
+	map = (cell_t*)ptr;
+	mapCells = st.st_size/sizeof(cell_t);
+	adviseOffset = mapCells;
+	adviseHigh = 0;
+	releaseOffset = mapCells;
+	// the forward readahead of the kernel is useless for backward reads
+	madvise(map, mapCells*sizeof(cell_t), MADV_RANDOM);
+	return true;
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowFile::adviseMap(int offset, int len) {
+	static const long page = sysconf(_SC_PAGESIZE);
+	const int readahead = MMAP_READAHEAD/sizeof(cell_t);
+	const int release = MMAP_RELEASE/sizeof(cell_t);
+
+	if ((adviseOffset > 0 && offset - adviseOffset < readahead/2) || offset + len > adviseHigh) {
+		int low = offset - readahead;
+		if (low < 0) low = 0;
+		unsigned long start = ((unsigned long)(map + low)) & ~(page-1);
+		madvise((void*)start, ((unsigned long)(map + offset + len)) - start, MADV_WILLNEED);
+		adviseOffset = low;
+		adviseHigh = offset + len;
+	}
+	if (offset + len > releaseOffset) {
+		releaseOffset = offset + len;
+	} else if (releaseOffset - offset > 2*release) {
+		/* releases the pages above the last chunk read */
+		int low = offset + release;
+		unsigned long start = (((unsigned long)(map + low)) + page-1) & ~(page-1);
+		unsigned long end = ((unsigned long)(map + releaseOffset)) & ~(page-1);
+		if (end > start) {
+			madvise((void*)start, end - start, MADV_DONTNEED);
+		}
+		releaseOffset = low;
+	}
+}
+
 string SpecialRowFile::getFullFilename(bool temp) {
 	if (temp) {
 		return (*path) + "/" + filename + ".tmp";
@@ -32,6 +32,13 @@
  * While the special row is in write mode, a temporary file (*.tmp) store the
  * cells. As soon as the row turn to read mode, the temporary file is closed
  * and renamed to the definitive name.
+ *
+ * In read mode, the file is memory-mapped. Since the rows are read from the
+ * end to the beginning, the kernel readahead is disabled and the pages
+ * below the reading position are requested explicitly (MADV_WILLNEED).
+ * The pages already consumed are released while reading and the file is
+ * dropped from the page cache when the row is closed, so many large rows
+ * may be read without filling the memory.
  */
 class SpecialRowFile : public SpecialRow {
 public:
@@ -71,6 +78,11 @@ public:
 	 */
 	virtual void truncateRow(int size);
 
+	/**
+	 * Starts the readahead of the file (posix_fadvise WILLNEED).
+	 */
+	virtual void prefetch();
+
 private:
 	/** Dynamic path name of the partition. */
 	string* path; // this string changes when the partition changes its name.
@@ -81,6 +93,32 @@ private:
 	/** Opened file descriptor */
 	FILE* file;
 
+	/** Mapped cells of the file (read mode) */
+	cell_t* map;
+
+	/** Number of cells in the mapping */
+	int mapCells;
+
+	/** Range of offsets already requested with MADV_WILLNEED */
+	int adviseOffset;
+	int adviseHigh;
+
+	/** Lowest offset already released with MADV_DONTNEED */
+	int releaseOffset;
+
+	/**
+	 * Maps the file for read access.
+	 * @return true if the file was mapped.
+	 */
+	bool mapFile(const string& filename);
+
+	/**
+	 * Gives the kernel hints about the reading position.
+	 * @param offset the position being read.
+	 * @param len the number of cells being read.
+	 */
+	void adviseMap(int offset, int len);
+
 	/**
 	 * Opens the file for read or write mode.
 	 * @param readOnly true if it must be opened for read mode, false otherwise.
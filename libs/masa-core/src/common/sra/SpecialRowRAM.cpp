@@ -64,6 +64,20 @@ void SpecialRowRAM::close() {
 void SpecialRowRAM::truncateRow(int size) {
 }
 
+/*
+ * @see description on header file
+ */
+const cell_t* SpecialRowRAM::getCells() const {
+	return row;
+}
+
+/*
+ * @see description on header file
+ */
+int SpecialRowRAM::getLength() const {
+	return length;
+}
+
 /*
  * @see description on header file
  */
@@ -56,6 +56,17 @@ public:
 	 */
 	virtual void truncateRow(int size);
 
+	/**
+	 * Returns the cells stored in memory, used to move the row to
+	 * another storage.
+	 */
+	const cell_t* getCells() const;
+
+	/**
+	 * Returns the number of cells allocated for this row.
+	 */
+	int getLength() const;
+
 private:
 	/** Allocated memory. */
 	cell_t* row;
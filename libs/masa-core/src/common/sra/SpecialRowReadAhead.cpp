@@ -0,0 +1,210 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "SpecialRowReadAhead.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define DEBUG (0)
+
+static double now() {
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec/1000000.0;
+}
+
+SpecialRowReadAhead::SpecialRowReadAhead(SpecialRow* row, int bufferCells) {
+	if (row == NULL) {
+		fprintf(stderr, "SpecialRowReadAhead: null special row.\n");
+		exit(1);
+	}
+	this->row = row;
+	this->ringSize = bufferCells > READ_AHEAD_BATCH ? bufferCells : READ_AHEAD_BATCH;
+	this->ring = (cell_t*)malloc(ringSize*sizeof(cell_t));
+	if (ring == NULL) {
+		fprintf(stderr, "SpecialRowReadAhead: could not allocate %d cells.\n", ringSize);
+		exit(1);
+	}
+	this->running = false;
+	this->stop = false;
+	this->statWaitTime = 0;
+	this->statReadCells = 0;
+
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&dataCond, NULL);
+	pthread_cond_init(&spaceCond, NULL);
+
+	start(row->getOffset());
+}
+
+SpecialRowReadAhead::~SpecialRowReadAhead() {
+	close();
+	free(ring);
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&dataCond);
+	pthread_cond_destroy(&spaceCond);
+}
+
+void SpecialRowReadAhead::close() {
+	join();
+}
+
+int SpecialRowReadAhead::getType() {
+	return row->getType();
+}
+
+/*
+ * The cells of offset k are stored in ring[k % ringSize]. Since the row is
+ * read in reverse order, the ring holds the offsets [rowOffset, ringOffset).
+ */
+int SpecialRowReadAhead::read(cell_t* buf, int len) {
+	if (offset == 0) {
+		fprintf(stderr, "Error: Special Row overflow: %d (%08X).\n", len, row->getId());
+		exit(1);
+	}
+	if (len > offset) {
+		len = offset;
+	}
+	int target = offset - len;
+
+	pthread_mutex_lock(&mutex);
+	if (rowOffset > target) {
+		double t0 = now();
+		while (rowOffset > target) {
+			pthread_cond_wait(&dataCond, &mutex);
+		}
+		statWaitTime += now() - t0;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	if (buf != NULL) {
+		for (int k = 0; k < len; k++) {
+			buf[k] = ring[(offset-1-k) % ringSize];
+		}
+	}
+
+	pthread_mutex_lock(&mutex);
+	offset = target;
+	// Keeps the last cell, so the full-gap test may seek back one cell.
+	if (ringOffset > offset+1) {
+		ringOffset = offset+1;
+		pthread_cond_signal(&spaceCond);
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return len;
+}
+
+void SpecialRowReadAhead::seek(int position) {
+	pthread_mutex_lock(&mutex);
+	bool buffered = (position <= ringOffset && position >= rowOffset);
+	if (buffered) {
+		offset = position;
+		if (ringOffset > offset+1) {
+			ringOffset = offset+1;
+			pthread_cond_signal(&spaceCond);
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+
+	if (!buffered) {
+		if (DEBUG) fprintf(stderr, "SpecialRowReadAhead: restart at %d\n", position);
+		join();
+		start(position);
+	}
+}
+
+int SpecialRowReadAhead::getOffset() {
+	return offset;
+}
+
+double SpecialRowReadAhead::getWaitTime() const {
+	return statWaitTime;
+}
+
+long long SpecialRowReadAhead::getReadCells() const {
+	return statReadCells;
+}
+
+void SpecialRowReadAhead::start(int position) {
+	row->seek(position);
+	offset = position;
+	ringOffset = position;
+	rowOffset = position;
+	stop = false;
+
+	int rc = pthread_create(&thread, NULL, threadFunction, (void*)this);
+	if (rc) {
+		fprintf(stderr, "SpecialRowReadAhead: pthread_create() returned %d\n", rc);
+		exit(1);
+	}
+	running = true;
+}
+
+void SpecialRowReadAhead::join() {
+	if (!running) {
+		return;
+	}
+	pthread_mutex_lock(&mutex);
+	stop = true;
+	pthread_cond_signal(&spaceCond);
+	pthread_mutex_unlock(&mutex);
+	pthread_join(thread, NULL);
+	running = false;
+}
+
+void SpecialRowReadAhead::run() {
+	cell_t cells[READ_AHEAD_BATCH];
+	pthread_mutex_lock(&mutex);
+	while (!stop && rowOffset > 0) {
+		int len = READ_AHEAD_BATCH;
+		if (len > rowOffset) {
+			len = rowOffset;
+		}
+		while (!stop && (ringOffset - (rowOffset - len)) > ringSize) {
+			pthread_cond_wait(&spaceCond, &mutex);
+		}
+		if (stop) {
+			break;
+		}
+		pthread_mutex_unlock(&mutex);
+
+		// The special row returns the cells in reverse order.
+		row->read(cells, len);
+		for (int k = 0; k < len; k++) {
+			ring[(rowOffset-1-k) % ringSize] = cells[k];
+		}
+
+		pthread_mutex_lock(&mutex);
+		rowOffset -= len;
+		statReadCells += len;
+		pthread_cond_signal(&dataCond);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void* SpecialRowReadAhead::threadFunction(void* arg) {
+	SpecialRowReadAhead* _this = (SpecialRowReadAhead*)arg;
+	_this->run();
+	return NULL;
+}
@@ -0,0 +1,108 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+class SpecialRowReadAhead;
+
+#ifndef SPECIALROWREADAHEAD_HPP_
+#define SPECIALROWREADAHEAD_HPP_
+
+#include "SpecialRow.hpp"
+
+#include <pthread.h>
+
+/** Number of cells read from the special row in each I/O operation */
+#define READ_AHEAD_BATCH	(4*1024)
+
+/** @brief Reads a special row in a background thread.
+ *
+ * The special rows are read in reverse order, from the seek offset down
+ * to the beginning of the row, so the cells that the aligner will need
+ * are known in advance. This class reads (and decompresses) the cells of
+ * the row into a bounded ring buffer while the aligner computes the
+ * partition, so the alignment only stalls if the disk is slower than
+ * the aligner.
+ *
+ * Seeking back to an offset that was already read (the full-gap test of
+ * the AlignerManager) or forward inside the buffered cells does not
+ * restart the I/O thread.
+ */
+class SpecialRowReadAhead : public SeekableCellsReader {
+public:
+	/**
+	 * Starts reading the row from its current offset.
+	 *
+	 * @param row the special row, that must be opened for reading.
+	 * @param bufferCells capacity of the ring buffer, in cells.
+	 */
+	SpecialRowReadAhead(SpecialRow* row, int bufferCells);
+
+	/**
+	 * Stops the I/O thread. The special row is not closed.
+	 */
+	virtual ~SpecialRowReadAhead();
+
+	virtual void close();
+	virtual int getType();
+	virtual int read(cell_t* buf, int len);
+	virtual void seek(int position);
+	virtual int getOffset();
+
+	/**
+	 * @return the time that the reader waited for the I/O thread, in
+	 * seconds.
+	 */
+	double getWaitTime() const;
+
+	/**
+	 * @return the number of cells read from the special row. The count is
+	 * final only after close().
+	 */
+	long long getReadCells() const;
+
+private:
+	SpecialRow* row;
+	cell_t* ring;
+	int ringSize;
+
+	/** First offset (in the row) that is still in the ring buffer */
+	int ringOffset;
+	/** Offset of the reader, always in [rowOffset, ringOffset] */
+	int offset;
+	/** Offset of the next cells to be read by the I/O thread */
+	int rowOffset;
+
+	bool running;
+	bool stop;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t dataCond;
+	pthread_cond_t spaceCond;
+
+	double statWaitTime;
+	long long statReadCells;
+
+	void start(int position);
+	void join();
+	void run();
+	static void* threadFunction(void* arg);
+};
+
+#endif /* SPECIALROWREADAHEAD_HPP_ */
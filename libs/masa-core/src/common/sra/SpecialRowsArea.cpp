@@ -23,6 +23,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <algorithm>
 
 #include <dirent.h>
@@ -32,18 +33,48 @@
 
 #include "../io/SplitCellsReader.hpp"
 #include "../io/InitialCellsReader.hpp"
+#include "../configs/Configs.hpp"
 
 #define DEBUG (0)
 
+#define INDEX_FILENAME	"index"
+#define INDEX_HEADER	"MASA-SRA-INDEX 1"
+
+static bool sort_index(const sra_index_partition_t& a, const sra_index_partition_t& b) {
+	if (a.i0 == b.i0) {
+		return a.j0 < b.j0;
+	} else {
+		return a.i0 < b.i0;
+	}
+}
+
+static bool index_before_row(const sra_index_partition_t& p, int i) {
+	return p.i0 < i;
+}
+
+/* FNV-1a hash, used to detect a damaged index */
+static unsigned int index_checksum(const string& text) {
+	unsigned int hash = 2166136261u;
+	for (size_t k = 0; k < text.size(); k++) {
+		hash ^= (unsigned char)text[k];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 SpecialRowsArea::SpecialRowsArea(string directory, long long ram_limit, long long disk_limit, const score_params_t* score_params) {
 	this->directory = directory;
 	this->ram_limit = ram_limit;
+	this->ram_usage = 0;
+	this->compression = SRA_COMPRESSION_NONE;
 	this->disk_limit = disk_limit;
 	//printf("SpecialRowsArea::SpecialRowsArea   directory: %s\n", directory.c_str());
 	this->partitions.clear();
 	this->rowsCount = 0;
 	this->score_params = score_params;
 	this->persistentPartitions = true;//(ram_limit+disk_limit) > 0; // FIXME or TODO
+	this->indexLoaded = false;
+	this->indexMissing = false;
 }
 
 SpecialRowsArea::~SpecialRowsArea() {
@@ -55,8 +86,11 @@ SpecialRowsArea::~SpecialRowsArea() {
 
 SpecialRowsPartition* SpecialRowsArea::createPartition(int i0, int j0, int i1, int j1) {
 	string path = getPartitionPath(i0, j0, i1, j1);
+	invalidateIndex();
 	SpecialRowsPartition* partition = new SpecialRowsPartition(path, i0, j0, i1, j1, false, score_params);
 	partition->setRamProportion(ram_limit, disk_limit);
+	partition->setRamUsage(&ram_usage);
+	partition->setCompression(compression);
 
 	partitions[path] = partition;
 	return partition;
@@ -65,7 +99,9 @@ SpecialRowsPartition* SpecialRowsArea::createPartition(int i0, int j0, int i1, i
 SpecialRowsPartition* SpecialRowsArea::openPartition(int i0, int j0, int i1, int j1) {
 	string path = getPartitionPath(i0, j0, i1, j1);
 	if (partitions[path] == NULL) {
-		SpecialRowsPartition* partition = new SpecialRowsPartition(path, i0, j0, i1, j1, true, score_params);
+		const sra_index_partition_t* indexed = findIndexPartition(i0, j0, i1, j1);
+		SpecialRowsPartition* partition = new SpecialRowsPartition(path, i0, j0, i1, j1, true, score_params,
+				indexed == NULL ? NULL : &indexed->entries);
 		partitions[path] = partition;
 		return partition;
 	} else {
@@ -77,6 +113,7 @@ SpecialRowsPartition* SpecialRowsArea::openPartition(int i0, int j0, int i1, int
 }
 
 void SpecialRowsArea::truncatePartition(SpecialRowsPartition* partition, int max_i, int max_j) {
+	invalidateIndex();
 	partition->truncate(max_i, max_j);
 
 	string old_path = partition->getPath();
@@ -113,7 +150,24 @@ void SpecialRowsArea::setPersistentPartitions(bool persistent) {
 	this->persistentPartitions = persistent;
 }
 
+void SpecialRowsArea::setCompression(int compression) {
+	this->compression = compression;
+}
+
 SpecialRowsPartition* SpecialRowsArea::openPartition(int i, int j) {
+	if (loadIndex()) {
+		// Only the partitions before the first i0 >= i may contain (i,j).
+		int lo = lower_bound(index.begin(), index.end(), i, index_before_row) - index.begin();
+		for (int k = lo-1; k >= 0; k--) {
+			const sra_index_partition_t& p = index[k];
+			if (p.i0 < i && i <= p.i1 && p.j0 < j && j <= p.j1) {
+				if (DEBUG) printf("DEBUG: INDEX >>>>>> (%d,%d,%d,%d)\n", p.i0, p.j0, p.i1, p.j1);
+				return openPartition(p.i0, p.j0, p.i1, p.j1);
+			}
+		}
+		// not indexed: falls back to the directory scan
+	}
+
 	DIR *dir = NULL;
 	//printf("Opening Dir: %s\n", path.c_str());
 	dir = opendir (directory.c_str());
@@ -226,6 +280,157 @@ static bool sort_f(const SpecialRowsPartition* a, const SpecialRowsPartition* b)
 	}
 }
 
+string SpecialRowsArea::getIndexFilename() {
+	return directory + "/" + INDEX_FILENAME;
+}
+
+/*
+ * @see description on header file
+ *
+ * Format: a header line, one "P i0.j0.i1.j1 count" line per partition
+ * followed by the names of its files, and a "C checksum" line covering all
+ * the previous lines. Every special row is a file named by its row id, so
+ * the names are the row ids and there are no offsets inside a shared file.
+ * The rows themselves are not checksummed: it would require reading the
+ * whole area again at the end of each stage, and the stages only read
+ * parts of the rows, so the checksum could not be verified cheaply.
+ */
+void SpecialRowsArea::saveIndex() {
+	if (!persistentPartitions) {
+		return;
+	}
+	vector<sra_index_partition_t> entries;
+	for (map<string, SpecialRowsPartition*>::iterator it = partitions.begin(); it != partitions.end(); it++) {
+		SpecialRowsPartition* partition = it->second;
+		if (partition == NULL) {
+			continue;
+		}
+		partition->waitSpills();
+		sra_index_partition_t p;
+		p.i0 = partition->getI0();
+		p.j0 = partition->getJ0();
+		p.i1 = partition->getI1();
+		p.j1 = partition->getJ1();
+		p.entries = partition->listEntries();
+		sort(p.entries.begin(), p.entries.end());
+		entries.push_back(p);
+	}
+	sort(entries.begin(), entries.end(), sort_index);
+
+	string text = INDEX_HEADER "\n";
+	char str[100];
+	for (vector<sra_index_partition_t>::iterator it = entries.begin(); it != entries.end(); it++) {
+		sprintf(str, "P %08X.%08X.%08X.%08X %d\n", it->i0, it->j0, it->i1, it->j1, (int)it->entries.size());
+		text += str;
+		for (vector<string>::iterator e = it->entries.begin(); e != it->entries.end(); e++) {
+			text += *e + "\n";
+		}
+	}
+	sprintf(str, "C %08X\n", index_checksum(text));
+	text += str;
+
+	// The index is replaced atomically, so readers never see a partial file.
+	string filename = getIndexFilename();
+	string tmp = filename + ".tmp";
+	FILE* file = fopen(tmp.c_str(), "wt");
+	if (file == NULL) {
+		fprintf(stderr, "Could not create the SRA index: %s\n", tmp.c_str());
+		return;
+	}
+	fwrite(text.c_str(), 1, text.size(), file);
+	fclose(file);
+	rename(tmp.c_str(), filename.c_str());
+
+	index = entries;
+	indexLoaded = true;
+	indexMissing = false;
+}
+
+/*
+ * Loads the index once. Returns false if there is no valid index.
+ */
+bool SpecialRowsArea::loadIndex() {
+	if (indexLoaded) {
+		return true;
+	}
+	if (indexMissing) {
+		return false;
+	}
+	FILE* file = fopen(getIndexFilename().c_str(), "rt");
+	if (file == NULL) {
+		indexMissing = true;
+		return false;
+	}
+	string text;
+	char line[512];
+	bool valid = false;
+	vector<sra_index_partition_t> entries;
+	int pending = 0;
+	while (fgets(line, sizeof(line), file) != NULL) {
+		unsigned int checksum;
+		if (text.size() == 0) {
+			valid = (strcmp(line, INDEX_HEADER "\n") == 0);
+			if (!valid) break;
+		} else if (pending > 0) {
+			string name(line);
+			if (name.size() <= 1 || name[name.size()-1] != '\n') {
+				valid = false;
+				break;
+			}
+			entries.back().entries.push_back(name.substr(0, name.size()-1));
+			pending--;
+		} else if (sscanf(line, "C %08X", &checksum) == 1) {
+			valid = (checksum == index_checksum(text));
+			break;
+		} else {
+			sra_index_partition_t p;
+			if (sscanf(line, "P %08X.%08X.%08X.%08X %d", &p.i0, &p.j0, &p.i1, &p.j1, &pending) != 5) {
+				valid = false;
+				break;
+			}
+			entries.push_back(p);
+		}
+		text += line;
+		valid = false; // the checksum line is mandatory
+	}
+	fclose(file);
+	if (!valid) {
+		fprintf(stderr, "Invalid SRA index: %s. Scanning the directory.\n", getIndexFilename().c_str());
+		indexMissing = true;
+		return false;
+	}
+	sort(entries.begin(), entries.end(), sort_index);
+	index = entries;
+	indexLoaded = true;
+	return true;
+}
+
+/*
+ * Removes the index, since the area is being changed.
+ */
+void SpecialRowsArea::invalidateIndex() {
+	if (persistentPartitions) {
+		unlink(getIndexFilename().c_str());
+	}
+	index.clear();
+	indexLoaded = false;
+	indexMissing = true;
+}
+
+const sra_index_partition_t* SpecialRowsArea::findIndexPartition(int i0, int j0, int i1, int j1) {
+	if (!loadIndex()) {
+		return NULL;
+	}
+	sra_index_partition_t key;
+	key.i0 = i0;
+	key.j0 = j0;
+	vector<sra_index_partition_t>::iterator it = lower_bound(index.begin(), index.end(), key, sort_index);
+	if (it != index.end() && it->i0 == i0 && it->j0 == j0 && it->i1 == i1 && it->j1 == j1) {
+		return &(*it);
+	}
+	return NULL;
+}
+
 vector<SpecialRowsPartition*> SpecialRowsArea::getSortedPartitions() {
 	vector<SpecialRowsPartition*> sortedPartitions;
 	for (map<string, SpecialRowsPartition*>::iterator it = partitions.begin(); it != partitions.end(); ++it) {
@@ -32,6 +32,18 @@ class SpecialRowsArea;
 #include <vector>
 using namespace std;
 
+/**
+ * Entry of the area index: the bounds of a partition and the names of
+ * its files.
+ */
+struct sra_index_partition_t {
+	int i0;
+	int j0;
+	int i1;
+	int j1;
+	vector<string> entries;
+};
+
 class SpecialRowsArea {
 public:
 	SpecialRowsArea(string directory, long long ram_limit, long long disk_limit, const score_params_t* score_params);
@@ -46,20 +58,41 @@ public:
 	int getPartitionsCount() const;
 	const string& getDirectory() const;
 	void setPersistentPartitions(bool persistent);
+	void setCompression(int compression);
 
 	vector<SpecialRowsPartition*> getSortedPartitions();
 
+	/**
+	 * Writes the index of the area, listing all its partitions and rows,
+	 * so that the next stages do not need to scan the directories. Must
+	 * be called when all the partitions of the area are finished.
+	 */
+	void saveIndex();
+
 private:
 
 	bool persistentPartitions;
 	string directory;
 	long long disk_limit;
 	long long ram_limit;
+	/** RAM used by the special rows of all the partitions */
+	long long ram_usage;
+	int compression;
 	map<string, SpecialRowsPartition*> partitions;
 	int rowsCount;
 	const score_params_t* score_params;
 
+	/** Partitions of the index, sorted by (i0,j0) */
+	vector<sra_index_partition_t> index;
+	bool indexLoaded;
+	/** The index was not found or is invalid: use the directory scan */
+	bool indexMissing;
+
 	string getPartitionPath(int i0, int j0, int i1, int j1);
+	string getIndexFilename();
+	bool loadIndex();
+	void invalidateIndex();
+	const sra_index_partition_t* findIndexPartition(int i0, int j0, int i1, int j1);
 };
 
 #endif /* SPECIALROWSAREA_HPP_ */
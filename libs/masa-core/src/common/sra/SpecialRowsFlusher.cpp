@@ -0,0 +1,292 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+#include "SpecialRowsFlusher.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define DEBUG (0)
+
+static double now() {
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return t.tv_sec + t.tv_usec/1000000.0;
+}
+
+/*
+ * @see description on header file
+ */
+SpecialRowsFlusher::SpecialRowsFlusher(int threads, long long poolSize) {
+	this->threadsCount = threads < 1 ? 1 : threads;
+	this->bufferCells = FLUSHER_BUFFER_CELLS;
+	this->buffersCount = poolSize/(bufferCells*sizeof(cell_t));
+	if (buffersCount < 2*threadsCount) {
+		buffersCount = 2*threadsCount;
+	}
+	this->inFlight = 0;
+	this->stop = false;
+
+	statCells = 0;
+	statBuffers = 0;
+	statPoolWaits = 0;
+	statBuffersInUse = 0;
+	statPeakBuffers = 0;
+	statBlockedTime = 0;
+	statFlushTime = 0;
+	statWriteTime = 0;
+
+	buffers = new flush_buffer_t[buffersCount];
+	freeList = NULL;
+	for (int k = 0; k < buffersCount; k++) {
+		buffers[k].cells = (cell_t*)malloc(bufferCells*sizeof(cell_t));
+		if (buffers[k].cells == NULL) {
+			fprintf(stderr, "SpecialRowsFlusher: could not allocate the buffers pool.\n");
+			exit(1);
+		}
+		buffers[k].len = 0;
+		buffers[k].next = freeList;
+		freeList = &buffers[k];
+	}
+
+	pthread_mutex_init(&mutex, NULL);
+	pthread_cond_init(&freeCond, NULL);
+	pthread_cond_init(&workCond, NULL);
+	pthread_cond_init(&doneCond, NULL);
+
+	this->threads = new io_thread_t[threadsCount];
+	for (int t = 0; t < threadsCount; t++) {
+		this->threads[t].flusher = this;
+		this->threads[t].id = t;
+		this->threads[t].head = NULL;
+		this->threads[t].tail = NULL;
+		int rc = pthread_create(&this->threads[t].thread, NULL, threadFunction, (void*)&this->threads[t]);
+		if (rc) {
+			fprintf(stderr, "SpecialRowsFlusher: pthread_create() error: %d\n", rc);
+			exit(1);
+		}
+	}
+	if (DEBUG) printf("SpecialRowsFlusher: %d threads, %d buffers\n", threadsCount, buffersCount);
+}
+
+/*
+ * @see description on header file
+ */
+SpecialRowsFlusher::~SpecialRowsFlusher() {
+	flush();
+
+	pthread_mutex_lock(&mutex);
+	stop = true;
+	pthread_cond_broadcast(&workCond);
+	pthread_mutex_unlock(&mutex);
+	for (int t = 0; t < threadsCount; t++) {
+		pthread_join(threads[t].thread, NULL);
+	}
+	delete[] threads;
+
+	for (int k = 0; k < buffersCount; k++) {
+		free(buffers[k].cells);
+	}
+	delete[] buffers;
+
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&freeCond);
+	pthread_cond_destroy(&workCond);
+	pthread_cond_destroy(&doneCond);
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowsFlusher::write(SpecialRowsPartition* partition, int i, const cell_t* buf, int len) {
+	const int rowLength = partition->getJ1() - partition->getJ0() + 1;
+	pair<SpecialRowsPartition*, int> key(partition, i);
+
+	pthread_mutex_lock(&mutex);
+	statCells += len;
+	while (len > 0) {
+		pending_row_t& row = pending[key];
+		if (row.buffer == NULL) {
+			row.buffer = acquire();
+			row.buffer->partition = partition;
+			row.buffer->i = i;
+		}
+		flush_buffer_t* buffer = row.buffer;
+		int n = bufferCells - buffer->len;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(buffer->cells + buffer->len, buf, n*sizeof(cell_t));
+		buffer->len += n;
+		row.written += n;
+		buf += n;
+		len -= n;
+
+		if (buffer->len == bufferCells || row.written >= rowLength) {
+			submit(buffer);
+			row.buffer = NULL;
+		}
+		if (row.written >= rowLength) {
+			pending.erase(key);
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+/*
+ * Returns a free buffer. If the pool is exhausted, the partially filled
+ * buffers are queued and the caller waits for the I/O threads.
+ * Must be called with the mutex locked.
+ */
+SpecialRowsFlusher::flush_buffer_t* SpecialRowsFlusher::acquire() {
+	if (freeList == NULL) {
+		double t0 = now();
+		statPoolWaits++;
+		submitPending();
+		while (freeList == NULL) {
+			pthread_cond_wait(&freeCond, &mutex);
+		}
+		statBlockedTime += now() - t0;
+	}
+	flush_buffer_t* buffer = freeList;
+	freeList = buffer->next;
+	buffer->next = NULL;
+	buffer->len = 0;
+	statBuffersInUse++;
+	if (statPeakBuffers < statBuffersInUse) {
+		statPeakBuffers = statBuffersInUse;
+	}
+	return buffer;
+}
+
+/*
+ * Queues a buffer to the I/O thread responsible for its row.
+ * Must be called with the mutex locked.
+ */
+void SpecialRowsFlusher::submit(flush_buffer_t* buffer) {
+	io_thread_t* thread = &threads[buffer->i % threadsCount];
+	buffer->next = NULL;
+	if (thread->tail == NULL) {
+		thread->head = buffer;
+	} else {
+		thread->tail->next = buffer;
+	}
+	thread->tail = buffer;
+	inFlight++;
+	statBuffers++;
+	pthread_cond_broadcast(&workCond);
+}
+
+/*
+ * Queues all the partially filled buffers.
+ * Must be called with the mutex locked.
+ */
+void SpecialRowsFlusher::submitPending() {
+	for (map<pair<SpecialRowsPartition*, int>, pending_row_t>::iterator it = pending.begin(); it != pending.end(); it++) {
+		if (it->second.buffer != NULL) {
+			submit(it->second.buffer);
+			it->second.buffer = NULL;
+		}
+	}
+}
+
+/*
+ * @see description on header file
+ */
+void SpecialRowsFlusher::flush() {
+	pthread_mutex_lock(&mutex);
+	double t0 = now();
+	submitPending();
+	while (inFlight > 0) {
+		pthread_cond_wait(&doneCond, &mutex);
+	}
+	pending.clear();
+	statFlushTime += now() - t0;
+	pthread_mutex_unlock(&mutex);
+}
+
+void* SpecialRowsFlusher::threadFunction(void* arg) {
+	io_thread_t* thread = (io_thread_t*)arg;
+	thread->flusher->run(thread);
+	return NULL;
+}
+
+/*
+ * Loop of the I/O threads.
+ */
+void SpecialRowsFlusher::run(io_thread_t* thread) {
+	pthread_mutex_lock(&mutex);
+	while (true) {
+		while (thread->head == NULL && !stop) {
+			pthread_cond_wait(&workCond, &mutex);
+		}
+		if (thread->head == NULL) {
+			break;
+		}
+		flush_buffer_t* buffer = thread->head;
+		thread->head = buffer->next;
+		if (thread->head == NULL) {
+			thread->tail = NULL;
+		}
+		pthread_mutex_unlock(&mutex);
+
+		double t0 = now();
+		buffer->partition->write(buffer->i, buffer->cells, buffer->len);
+		double t1 = now();
+
+		pthread_mutex_lock(&mutex);
+		statWriteTime += t1 - t0;
+		buffer->len = 0;
+		buffer->next = freeList;
+		freeList = buffer;
+		statBuffersInUse--;
+		inFlight--;
+		pthread_cond_signal(&freeCond);
+		if (inFlight == 0) {
+			pthread_cond_broadcast(&doneCond);
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+/*
+ * @see description on header file
+ */
+double SpecialRowsFlusher::getWriteBandwidth() {
+	if (statWriteTime <= 0) {
+		return 0;
+	}
+	return statCells*sizeof(cell_t)/statWriteTime;
+}
+
+void SpecialRowsFlusher::printStatistics(FILE* file) {
+	pthread_mutex_lock(&mutex);
+	fprintf(file, "SRA flusher: %d threads, %d buffers of %d cells\n",
+			threadsCount, buffersCount, bufferCells);
+	fprintf(file, "     Cells: %lld (%lld buffers, peak %d in use)\n",
+			statCells, statBuffers, statPeakBuffers);
+	fprintf(file, "  I/O time: %.4f s\n", statWriteTime);
+	fprintf(file, "   Blocked: %.4f s (%lld pool waits) + %.4f s on flush\n",
+			statBlockedTime, statPoolWaits, statFlushTime);
+	pthread_mutex_unlock(&mutex);
+}
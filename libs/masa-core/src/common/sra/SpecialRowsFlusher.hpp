@@ -0,0 +1,142 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+
+class SpecialRowsFlusher;
+
+#ifndef SPECIALROWSFLUSHER_HPP_
+#define SPECIALROWSFLUSHER_HPP_
+
+#include "SpecialRowsPartition.hpp"
+
+#include <stdio.h>
+#include <pthread.h>
+#include <map>
+using namespace std;
+
+/** Default number of cells of each buffer of the pool */
+#define FLUSHER_BUFFER_CELLS	(64*1024)
+
+/** @brief Writes the special rows in background threads.
+ *
+ * The cells dispatched by the aligner are copied into buffers of a bounded
+ * pool and written to the SpecialRowsPartition by dedicated I/O threads,
+ * so a slow disk only stalls the aligner when the pool is exhausted.
+ *
+ * The cells of the same row are coalesced in a single buffer, that is
+ * queued when it is full or when the row is complete. Each row is always
+ * written by the same I/O thread, so its cells are stored in order.
+ */
+class SpecialRowsFlusher {
+public:
+	/**
+	 * Creates the pool and starts the I/O threads.
+	 *
+	 * @param threads number of I/O threads.
+	 * @param poolSize size of the buffers pool in bytes.
+	 */
+	SpecialRowsFlusher(int threads, long long poolSize);
+
+	/**
+	 * Writes the pending buffers and stops the I/O threads.
+	 */
+	virtual ~SpecialRowsFlusher();
+
+	/**
+	 * Queues the cells of a row to be written in the partition. Blocks
+	 * only if there is no free buffer in the pool.
+	 */
+	void write(SpecialRowsPartition* partition, int i, const cell_t* buf, int len);
+
+	/**
+	 * Blocks until every queued cell is written.
+	 */
+	void flush();
+
+	/**
+	 * Prints the statistics of the flusher, including the time that the
+	 * aligner was blocked waiting for the special rows I/O.
+	 */
+	void printStatistics(FILE* file);
+
+	/**
+	 * @return the measured write bandwidth in bytes per second, or zero
+	 * if nothing was written.
+	 */
+	double getWriteBandwidth();
+
+private:
+	struct flush_buffer_t {
+		SpecialRowsPartition* partition;
+		int i;
+		int len;
+		cell_t* cells;
+		flush_buffer_t* next;
+	};
+
+	struct pending_row_t {
+		flush_buffer_t* buffer;
+		int written;
+	};
+
+	struct io_thread_t {
+		SpecialRowsFlusher* flusher;
+		int id;
+		pthread_t thread;
+		flush_buffer_t* head;
+		flush_buffer_t* tail;
+	};
+
+	int threadsCount;
+	io_thread_t* threads;
+	int buffersCount;
+	int bufferCells;
+	flush_buffer_t* buffers;
+	flush_buffer_t* freeList;
+	int inFlight;
+	bool stop;
+
+	/** Buffers being filled, for each (partition, row) */
+	map<pair<SpecialRowsPartition*, int>, pending_row_t> pending;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t freeCond;
+	pthread_cond_t workCond;
+	pthread_cond_t doneCond;
+
+	/* Statistics */
+	long long statCells;
+	long long statBuffers;
+	long long statPoolWaits;
+	int statBuffersInUse;
+	int statPeakBuffers;
+	double statBlockedTime;
+	double statFlushTime;
+	double statWriteTime;
+
+	flush_buffer_t* acquire();
+	void submit(flush_buffer_t* buffer);
+	void submitPending();
+	void run(io_thread_t* thread);
+	static void* threadFunction(void* arg);
+};
+
+#endif /* SPECIALROWSFLUSHER_HPP_ */
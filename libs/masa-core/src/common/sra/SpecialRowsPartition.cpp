@@ -21,6 +21,7 @@
 
 #include "SpecialRowsPartition.hpp"
 #include "SpecialRowFile.hpp"
+#include "SpecialRowCompressed.hpp"
 #include "SpecialRowRAM.hpp"
 #include "FirstRow.hpp"
 #include "../io/FileCellsWriter.hpp"
@@ -28,6 +29,7 @@
 #include "../io/InitialCellsReader.hpp"
 #include "../io/TeeCellsReader.hpp"
 #include "../io/FileStream.hpp"
+#include "../configs/Configs.hpp"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -40,12 +42,14 @@ using namespace std;
 #include <dirent.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <unistd.h>
 
 #define DEBUG	(0)
 
 #define def2str(x) #x
 
-SpecialRowsPartition::SpecialRowsPartition(string _path, int _i0, int _j0, int _i1, int _j1, bool _readOnly, const score_params_t* score_params)
+SpecialRowsPartition::SpecialRowsPartition(string _path, int _i0, int _j0, int _i1, int _j1, bool _readOnly, const score_params_t* score_params,
+		const vector<string>* entries)
         : path(_path), i0(_i0), j0(_j0), i1(_i1), j1(_j1), readOnly(_readOnly) {
 
 	this->readingRow = NULL;
@@ -53,6 +57,16 @@ SpecialRowsPartition::SpecialRowsPartition(string _path, int _i0, int _j0, int _
 	this->diskProportion = 0;
 	this->ramCount = 0;
 	this->diskCount = 0;
+	this->compression = SRA_COMPRESSION_NONE;
+	pthread_mutex_init(&mutex, NULL);
+	this->localRamUsage = 0;
+	this->ramUsage = &localRamUsage;
+	this->spillingBytes = 0;
+	this->spillRunning = false;
+	this->spillStop = false;
+	this->spillPending = 0;
+	pthread_cond_init(&spillCond, NULL);
+	pthread_cond_init(&spillDoneCond, NULL);
 	this->lastRowId = 0;
 	this->lastRowFilename = "";
 	this->firstColumnWriter = NULL;
@@ -80,27 +94,40 @@ SpecialRowsPartition::SpecialRowsPartition(string _path, int _i0, int _j0, int _
     }
 
     if (persistent) {
-    	readDirectory();
+    	readDirectory(entries);
     }
 }
 
 SpecialRowsPartition::~SpecialRowsPartition() {
+	waitSpills();
+	if (spillRunning) {
+		pthread_mutex_lock(&mutex);
+		spillStop = true;
+		pthread_cond_signal(&spillCond);
+		pthread_mutex_unlock(&mutex);
+		pthread_join(spillThread, NULL);
+	}
     if (readingRow != NULL) {
     	readingRow->close();
     }
 	//truncate(i1, j1); // TODO podemos retirar definitivamente?
     for (map<int, SpecialRow*>::iterator it = rowsMap.begin(); it != rowsMap.end(); it++) {
         SpecialRow* row = (*it).second;
+        releaseRow(row);
        	delete row;
     }
     rowsMap.clear();
 	for (vector<SpecialRow*>::iterator it = rowsVector.begin(); it != rowsVector.end(); it++) {
 		SpecialRow* row = (*it);
 		if (row != &firstRow) {
+			releaseRow(row);
 			delete row;
 		}
 	}
 	rowsVector.clear();
+	pthread_mutex_destroy(&mutex);
+	pthread_cond_destroy(&spillCond);
+	pthread_cond_destroy(&spillDoneCond);
 }
 
 //void SpecialRowsPartition::setFirstRow(const score_params_t* score_params, 	bool firstRowGapped) {
@@ -175,6 +202,7 @@ void SpecialRowsPartition::setBorderReader(char prefix, SeekableCellsReader* &re
 }
 
 void SpecialRowsPartition::reload() {
+	waitSpills();
     sort(rowsVector.begin(), rowsVector.end(), SpecialRow::sortById);
 	readingRowId = rowsVector.size() - 1;
 	readingRow = NULL;
@@ -202,6 +230,7 @@ int SpecialRowsPartition::getReadingRow() {
 
 void SpecialRowsPartition::truncate(int max_i, int max_j) {
     if (DEBUG) printf("Flush: %08X,%08X\n", max_i, max_j);
+	waitSpills();
 	for (vector<SpecialRow*>::iterator it = rowsVector.begin(); it != rowsVector.end(); ) {
 		SpecialRow* row = (*it);
         if ((row->getId() + i0) >= max_i && row != &firstRow) {
@@ -209,6 +238,7 @@ void SpecialRowsPartition::truncate(int max_i, int max_j) {
         	row->close();
         	row->truncateRow(0);
         	// precaution: the first row cannot be deleted.
+        	releaseRow(row);
         	delete row;
         } else {
         	row->truncateRow(max_j-j0+1);
@@ -221,6 +251,7 @@ void SpecialRowsPartition::truncate(int max_i, int max_j) {
        	row->close();
         if ((row->getId() + i0) >= max_i) {
         	row->truncateRow(0);
+        	releaseRow(row);
         	delete row;
         } else {
         	row->truncateRow(max_j-j0+1);
@@ -269,6 +300,7 @@ const string& SpecialRowsPartition::getPath() const {
 }
 
 void SpecialRowsPartition::changePath(string new_path) {
+	waitSpills();
 	rename(path.c_str(), new_path.c_str());
 	path = new_path;
 }
@@ -278,6 +310,18 @@ void SpecialRowsPartition::setRamProportion(const long long ram, const long long
 	this->diskProportion = disk;
 }
 
+void SpecialRowsPartition::setCompression(int compression) {
+	this->compression = compression;
+}
+
+/*
+ * Defines the counter of RAM bytes used by the special rows. The counter
+ * may be shared by all the partitions of the same area.
+ */
+void SpecialRowsPartition::setRamUsage(long long* ramUsage) {
+	this->ramUsage = ramUsage;
+}
+
 int SpecialRowsPartition::getRowsCount() const {
 	return rowsVector.size();
 }
@@ -317,9 +361,19 @@ SpecialRow* SpecialRowsPartition::getSpecialRow(int i) {
 	SpecialRow* row = NULL;
 	row = rowsMap[i];
 	if (row == NULL && persistent) {
-		// Alternate the creation of rows in disk and in ram.
-		if ((diskProportion !=0 && ramProportion==0) || ramCount*diskProportion > ramProportion*diskCount) {
-			row = new SpecialRowFile(&path, i);
+		if (isTiered()) {
+			// The newest rows are the first ones to be read in the next
+			// stage, so they are kept in RAM while the oldest are spilled.
+			queueSpills();
+			if (__sync_add_and_fetch(ramUsage, 0) - spillingBytes + getRowBytes() <= ramProportion) {
+				row = new SpecialRowRAM(i);
+				ramCount++;
+			} else {
+				row = createDiskRow(i);
+				diskCount++;
+			}
+		} else if (diskProportion != 0 && ramProportion == 0) {
+			row = createDiskRow(i);
 			diskCount++;
 		} else {
 			row = new SpecialRowRAM(i);
@@ -327,11 +381,132 @@ SpecialRow* SpecialRowsPartition::getSpecialRow(int i) {
 		}
 
     	row->open(readOnly, j1-j0+1);
+    	SpecialRowRAM* ramRow = dynamic_cast<SpecialRowRAM*>(row);
+    	if (ramRow != NULL) {
+    		__sync_add_and_fetch(ramUsage, (long long)ramRow->getLength()*sizeof(cell_t));
+    	}
 		rowsMap[i] = row;
 	}
 	return row;
 }
 
+SpecialRow* SpecialRowsPartition::createDiskRow(int i) {
+	if (compression != SRA_COMPRESSION_NONE) {
+		return new SpecialRowCompressed(&path, i, compression);
+	} else {
+		return new SpecialRowFile(&path, i);
+	}
+}
+
+bool SpecialRowsPartition::isTiered() const {
+	return !readOnly && ramProportion > 0 && diskProportion > 0;
+}
+
+long long SpecialRowsPartition::getRowBytes() const {
+	return (long long)(j1-j0+1)*sizeof(cell_t);
+}
+
+/*
+ * Discounts the memory of a RAM row that is going to be deleted.
+ */
+void SpecialRowsPartition::releaseRow(SpecialRow* row) {
+	SpecialRowRAM* ramRow = dynamic_cast<SpecialRowRAM*>(row);
+	if (ramRow == NULL) {
+		return;
+	}
+	__sync_sub_and_fetch(ramUsage, (long long)ramRow->getLength()*sizeof(cell_t));
+	vector<SpecialRowRAM*>::iterator it = find(ramRows.begin(), ramRows.end(), ramRow);
+	if (it != ramRows.end()) {
+		ramRows.erase(it);
+	}
+}
+
+/*
+ * Sends the oldest complete RAM rows to the spill thread until there is
+ * room for a new row. Must be called with the mutex locked.
+ */
+void SpecialRowsPartition::queueSpills() {
+	while (!ramRows.empty() &&
+			__sync_add_and_fetch(ramUsage, 0) - spillingBytes + getRowBytes() > ramProportion) {
+		SpecialRowRAM* ramRow = ramRows.front();
+		ramRows.erase(ramRows.begin());
+		spillQueue.push_back(ramRow);
+		spillingBytes += (long long)ramRow->getLength()*sizeof(cell_t);
+		spillPending++;
+	}
+	if (spillQueue.empty()) {
+		return;
+	}
+	if (!spillRunning) {
+		int rc = pthread_create(&spillThread, NULL, spillThreadFunction, (void*)this);
+		if (rc) {
+			fprintf(stderr, "SpecialRowsPartition: pthread_create() error: %d\n", rc);
+			exit(1);
+		}
+		spillRunning = true;
+	}
+	pthread_cond_signal(&spillCond);
+}
+
+void* SpecialRowsPartition::spillThreadFunction(void* arg) {
+	SpecialRowsPartition* partition = (SpecialRowsPartition*)arg;
+	pthread_mutex_lock(&partition->mutex);
+	while (true) {
+		while (partition->spillQueue.empty() && !partition->spillStop) {
+			pthread_cond_wait(&partition->spillCond, &partition->mutex);
+		}
+		if (partition->spillQueue.empty()) {
+			break;
+		}
+		SpecialRowRAM* ramRow = partition->spillQueue.front();
+		partition->spillQueue.erase(partition->spillQueue.begin());
+		pthread_mutex_unlock(&partition->mutex);
+
+		partition->spillRow(ramRow);
+
+		pthread_mutex_lock(&partition->mutex);
+		partition->spillPending--;
+		pthread_cond_broadcast(&partition->spillDoneCond);
+	}
+	pthread_mutex_unlock(&partition->mutex);
+	return NULL;
+}
+
+/*
+ * Moves a complete RAM row to disk. The RAM row stays readable in the
+ * rows vector until the disk row is closed.
+ */
+void SpecialRowsPartition::spillRow(SpecialRowRAM* ramRow) {
+	int len = ramRow->getOffset();
+	SpecialRow* diskRow = createDiskRow(ramRow->getId());
+	diskRow->open(false, len);
+	diskRow->write(ramRow->getCells(), len);
+	diskRow->close();
+
+	pthread_mutex_lock(&mutex);
+	vector<SpecialRow*>::iterator it = find(rowsVector.begin(), rowsVector.end(), (SpecialRow*)ramRow);
+	if (it != rowsVector.end()) {
+		*it = diskRow;
+	}
+	spillingBytes -= (long long)ramRow->getLength()*sizeof(cell_t);
+	ramCount--;
+	diskCount++;
+	releaseRow(ramRow);
+	pthread_mutex_unlock(&mutex);
+	delete ramRow;
+}
+
+/*
+ * Blocks until all the queued rows are spilled.
+ */
+void SpecialRowsPartition::waitSpills() {
+	pthread_mutex_lock(&mutex);
+	while (spillPending > 0) {
+		pthread_cond_wait(&spillDoneCond, &mutex);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
 int SpecialRowsPartition::write(int i, const cell_t* buf, int len) {
 	if (readOnly) {
     	fprintf(stderr, "Fatal: Writing into a read-only SRA Partition");
@@ -340,13 +515,24 @@ int SpecialRowsPartition::write(int i, const cell_t* buf, int len) {
 	if (!persistent) {
 		return 0;
 	}
+	pthread_mutex_lock(&mutex);
 	SpecialRow* row = getSpecialRow(i-i0);
+	pthread_mutex_unlock(&mutex);
+
+	// each row is written by a single thread at a time
 	int ret = row->write(buf, len);
 	if (row->getOffset() >= (j1-j0)+1) {
 		row->close();
+		pthread_mutex_lock(&mutex);
 		rowsMap.erase(i-i0);
-		rowsVector.push_back(row);
-		lastRowId = row->getId();
+		// rows written by different threads may be closed out of order
+		rowsVector.insert(upper_bound(rowsVector.begin(), rowsVector.end(), row, SpecialRow::sortById), row);
+		SpecialRowRAM* ramRow = dynamic_cast<SpecialRowRAM*>(row);
+		if (ramRow != NULL && isTiered()) {
+			ramRows.insert(upper_bound(ramRows.begin(), ramRows.end(), ramRow, SpecialRow::sortById), ramRow);
+		}
+		lastRowId = rowsVector.back()->getId();
+		pthread_mutex_unlock(&mutex);
 	}
 
 	return ret;
@@ -362,8 +548,11 @@ void SpecialRowsPartition::updateLargestInterval() {
 	}
 }
 
-void SpecialRowsPartition::readDirectory() {
-	// This method insert new rows to the vectors.
+/*
+ * Returns the names of the files of the partition directory.
+ */
+vector<string> SpecialRowsPartition::listEntries() {
+	vector<string> entries;
     DIR *dir = NULL;
     //printf("Opening Dir: %s\n", path.c_str());
     dir = opendir (path.c_str());
@@ -375,19 +564,45 @@ void SpecialRowsPartition::readDirectory() {
     }
 
     while ((dp = readdir (dir)) != NULL) {
-        int id;
-        if (loadBorderReader('C', string(dp->d_name), firstColumnReader)) {
+    	if (dp->d_name[0] != '.') {
+    		entries.push_back(string(dp->d_name));
+    	}
+    }
+    closedir (dir);
+    return entries;
+}
+
+/*
+ * Loads the rows of the partition. The file names come from the area
+ * index, or from the directory listing if the index is not available.
+ */
+void SpecialRowsPartition::readDirectory(const vector<string>* entries) {
+	// This method insert new rows to the vectors.
+	vector<string> listed;
+	if (entries == NULL) {
+		listed = listEntries();
+		entries = &listed;
+	}
+
+    for (vector<string>::const_iterator it = entries->begin(); it != entries->end(); it++) {
+    	const string& name = *it;
+        if (loadBorderReader('C', name, firstColumnReader)) {
         	continue;
         }
-        if (loadBorderReader('R', string(dp->d_name), firstRowReader)) {
+        if (loadBorderReader('R', name, firstRowReader)) {
         	firstRow.setCellsReader(firstRowReader);
         	continue;
         }
-		SpecialRow* row = new SpecialRowFile(&path, string(dp->d_name));
+		SpecialRow* row;
+		if (SpecialRowCompressed::isCompressedFilename(name)) {
+			row = new SpecialRowCompressed(&path, name);
+		} else {
+			row = new SpecialRowFile(&path, name);
+		}
 		if (row->getId() < 0) {
 			delete row;
 		} else {
-			string rowFilename = path + "/" + string(dp->d_name);
+			string rowFilename = path + "/" + name;
 			//fprintf(stderr, "Loading... %s: %d\n", rowFilename.c_str(), row->getId());
 			rowsVector.push_back(row);
 			if (row->getId() > lastRowId) {
@@ -397,7 +612,6 @@ void SpecialRowsPartition::readDirectory() {
 		}
 
     }
-    closedir (dir);
 
     reload();
 }
@@ -442,10 +656,25 @@ SpecialRow* SpecialRowsPartition::nextSpecialRow(int i, int j, int min_dist) {
 	readingRow->open(true);
 	int readingRowOffset = abs(j-j0)+1;
 	readingRow->seek(readingRowOffset);
+	prefetchNextRow();
 
     return readingRow;
 }
 
+/*
+ * The rows are read in reverse order, so the next row stored in disk
+ * is read in background while the current row is processed.
+ */
+void SpecialRowsPartition::prefetchNextRow() {
+	for (int k = readingRowId-1; k > 0; k--) {
+		SpecialRow* row = rowsVector[k];
+		if (dynamic_cast<SpecialRowRAM*>(row) == NULL) {
+			row->prefetch();
+			break;
+		}
+	}
+}
+
 int SpecialRowsPartition::read(cell_t* buf, int len) {
 	int ret = readingRow->read(buf, len);
 	return ret;
@@ -455,7 +684,16 @@ int SpecialRowsPartition::continueFromLastRow() {
 	firstColumnReader->read(NULL, lastRowId);
 	// TODO o first row source precisa considerar a linha onde ele se encontra (i.e. primeira celula possui valor != 0)
 	// TODO Lembrando que eu retirei o primeiro dispatch cell.
-	setFirstRowReader(new FileCellsReader(lastRowFilename.c_str()));
+	if (SpecialRowCompressed::isCompressedFilename(lastRowFilename.substr(lastRowFilename.find_last_of('/')+1))) {
+		/* The first row reader needs the raw cells. The extracted copy is
+		 * unlinked as soon as it is open, so it does not stay in the SRA. */
+		string rawFilename = lastRowFilename + ".raw";
+		SpecialRowCompressed::extract(lastRowFilename, rawFilename);
+		setFirstRowReader(new FileCellsReader(rawFilename.c_str()));
+		unlink(rawFilename.c_str());
+	} else {
+		setFirstRowReader(new FileCellsReader(lastRowFilename.c_str()));
+	}
 	printf("Continuing partition from row %d (%s)\n",
 			lastRowId + i0, lastRowFilename.c_str());
 	return lastRowId + i0;
@@ -28,10 +28,12 @@ class SpecialRowsPartition;
 
 #include <string>
 #include <map>
+#include <pthread.h>
 using namespace std;
 
 #include "../../libmasa/libmasa.hpp"
 #include "FirstRow.hpp"
+#include "SpecialRowRAM.hpp"
 #include "../io/CellsWriter.hpp"
 #include "../io/SeekableCellsReader.hpp"
 
@@ -40,12 +42,15 @@ using namespace std;
  */
 class SpecialRowsPartition {
 public:
-	SpecialRowsPartition(string path, int i0, int j0, int i1, int j1, bool readOnly, const score_params_t* score_params);
+	SpecialRowsPartition(string path, int i0, int j0, int i1, int j1, bool readOnly, const score_params_t* score_params,
+			const vector<string>* entries = NULL);
 	virtual ~SpecialRowsPartition();
 	void reload();
 	void deleteRows();
 
 	void setRamProportion(const long long ram, const long long disk);
+	void setRamUsage(long long* ramUsage);
+	void setCompression(int compression);
 
 //	void setFirstRow(const score_params_t* score_params, bool firstRowGapped);
 	void setFirstColumnReader(SeekableCellsReader* reader);
@@ -86,6 +91,8 @@ public:
 	int continueFromLastRow();
 
 	bool isPersistent() const;
+	void waitSpills();
+	vector<string> listEntries();
 
 private:
     int i0;
@@ -97,6 +104,22 @@ private:
     long long diskProportion;
     int ramCount;
     int diskCount;
+
+    /* Tiered placement: the most recent rows are kept in RAM while the
+     * RAM budget allows, and the older ones are spilled to disk by a
+     * background thread. */
+    long long localRamUsage;
+    long long* ramUsage;
+    long long spillingBytes;
+    vector<SpecialRowRAM*> ramRows;
+    vector<SpecialRowRAM*> spillQueue;
+    bool spillRunning;
+    bool spillStop;
+    int spillPending;
+    pthread_t spillThread;
+    pthread_cond_t spillCond;
+    pthread_cond_t spillDoneCond;
+    int compression;
     const score_params_t* score_params;
 
     bool readOnly;
@@ -119,10 +142,19 @@ private:
     CellsWriter* lastRowWriter;
 	void updateLargestInterval();
 
-	//pthread_mutex_t mutex;
+	/** Protects the rows map, that may be written by many I/O threads */
+	pthread_mutex_t mutex;
 
-    void readDirectory();
+    void readDirectory(const vector<string>* entries);
     SpecialRow* getSpecialRow(int i);
+    SpecialRow* createDiskRow(int i);
+    bool isTiered() const;
+    long long getRowBytes() const;
+    void releaseRow(SpecialRow* row);
+    void queueSpills();
+    void spillRow(SpecialRowRAM* ramRow);
+    void prefetchNextRow();
+    static void* spillThreadFunction(void* arg);
     void setBorderReader(char prefix, SeekableCellsReader* &reader, CellsWriter* &writer);
     bool loadBorderReader(char prefix, string file, SeekableCellsReader* &reader);
 
@@ -376,6 +376,30 @@ public:
 		 */
 		virtual long long getProcessedCells() = 0;
 
+		/**
+		 * Returns how many of the cells counted by getProcessedCells
+		 * belong to pruned blocks, i.e., were not actually computed.
+		 *
+		 * @return the number of pruned cells.
+		 */
+		virtual long long getPrunedCells() = 0;
+
+		/**
+		 * Returns another instance of this aligner, that may align
+		 * partitions concurrently with this aligner and with the other
+		 * workers. Each worker must be associated with its own IManager.
+		 * The workers are owned by this aligner and they are reused in
+		 * the next calls with the same count.
+		 *
+		 * @param id the worker id, in the range [0,count).
+		 * @param count number of workers that will run concurrently, so
+		 * 	the aligner may divide its resources (threads, devices) among
+		 * 	them.
+		 * @return the worker aligner, or NULL if the aligner does not
+		 * 	support concurrent instances.
+		 */
+		virtual IAligner* getWorker(int id, int count) = 0;
+
 
 
 protected:
@@ -35,6 +35,7 @@ AbstractAligner::AbstractAligner() {
 	forkCount = 0;
 	grid = NULL;
 	manager = NULL;
+	workersCount = 0;
 
 	firstColumnTail.h = -INF;
 	firstColumnTail.f = -INF;
@@ -49,6 +50,11 @@ AbstractAligner::~AbstractAligner() {
 	if (forkWeights != NULL) {
 		delete forkWeights;
 	}
+	for (size_t k = 0; k < workers.size(); k++) {
+		if (workers[k] != NULL) {
+			delete workers[k];
+		}
+	}
 }
 
 
@@ -97,6 +103,40 @@ const int* AbstractAligner::getForkWeights() {
 	return forkWeights;
 }
 
+/**
+ * Returns the worker with the given id, creating all the workers if the
+ * number of workers has changed.
+ *
+ * @see IAligner::getWorker()
+ */
+IAligner* AbstractAligner::getWorker(int id, int count) {
+	if (id < 0 || id >= count) {
+		return NULL;
+	}
+	if (count != workersCount) {
+		for (size_t k = 0; k < workers.size(); k++) {
+			if (workers[k] != NULL) {
+				delete workers[k];
+			}
+		}
+		workers.clear();
+		for (int k = 0; k < count; k++) {
+			workers.push_back(createWorker(k, count));
+		}
+		workersCount = count;
+	}
+	return workers[id];
+}
+
+/**
+ * Workers are not supported by default.
+ *
+ * @see AbstractAligner::getWorker()
+ */
+AbstractAligner* AbstractAligner::createWorker(int, int) {
+	return NULL;
+}
+
 /**
  * Creates a new grid using the given partition coordinates. If there is
  * a previously created grid, it is deleted and overwritten.
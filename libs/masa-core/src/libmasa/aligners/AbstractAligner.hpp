@@ -27,6 +27,7 @@ class AbstractAligner;
 #include <string.h>
 #include <string>
 #include <map>
+#include <vector>
 using namespace std;
 
 //#include "libmasa.hpp"
@@ -73,12 +74,21 @@ public:
 	virtual void setManager(IManager* manager);
 	virtual const int* getForkWeights();
 	virtual match_result_t matchLastColumn(const cell_t* buffer, const cell_t* base, int len, int goalScore);
+	virtual IAligner* getWorker(int id, int count);
 
 protected:
 
 	/* Methods to simplify the aligner implementation */
 
 	void setForkCount(const int forkCount, const int* forkWeights = NULL);
+
+	/**
+	 * Creates a new worker for the AbstractAligner::getWorker method. The
+	 * default implementation does not support workers.
+	 *
+	 * @return the new aligner or NULL if workers are not supported.
+	 */
+	virtual AbstractAligner* createWorker(int id, int count);
 	Grid* createGrid(Partition partition);
 	virtual const Grid* getGrid() const;
 	void initializeBlockPruning(AbstractBlockPruning* blockPruner);
@@ -123,6 +133,12 @@ private:
 	/** The processing grid */
 	Grid* grid;
 
+	/** Workers created by the getWorker method */
+	std::vector<AbstractAligner*> workers;
+
+	/** Number of workers requested in the creation of the workers */
+	int workersCount;
+
 	/** Last cell read in the first column */
 	cell_t firstColumnTail;
 
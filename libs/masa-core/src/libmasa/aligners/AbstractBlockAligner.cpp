@@ -76,6 +76,8 @@ AbstractBlockAligner::AbstractBlockAligner(AbstractBlockProcessor* blockProcesso
 	 */
 	col = NULL;
 	row = NULL;
+	statTotalCells = 0;
+	statPrunedCells = 0;
 
 	/*
 	 *  defines the constant parameters to be returned in the
@@ -100,6 +102,7 @@ AbstractBlockAligner::AbstractBlockAligner(AbstractBlockProcessor* blockProcesso
 		this->blockProcessor = blockProcessor;
 	}
 	this->blockPruner = new BlockPruningGenericN2();
+	pthread_mutex_init(&pruningMutex, NULL);
 
 	/*
 	 * Must be called to enable --fork parameter. This will allow
@@ -117,6 +120,7 @@ AbstractBlockAligner::AbstractBlockAligner(AbstractBlockProcessor* blockProcesso
  * AbstractBlockAligner destructor.
  */
 AbstractBlockAligner::~AbstractBlockAligner() {
+	pthread_mutex_destroy(&pruningMutex);
 }
 
 /*
@@ -165,6 +169,10 @@ IAlignerParameters* AbstractBlockAligner::getParameters() {
 	return this->params;
 }
 
+AbstractBlockProcessor* AbstractBlockAligner::getBlockProcessor() const {
+	return this->blockProcessor;
+}
+
 /*
  * Initializes some structures of the Aligner. This method
  * is called only once for each stage, and only the sequence data may be
@@ -297,10 +305,15 @@ void AbstractBlockAligner::alignPartition(Partition partition) {
 	statTotalBlocks = 0;
 	statPrunedBlocks = 0;
 
-	static char str[500];
+	char str[500];
 	sprintf(str, "profiling.%08d.%08d.%08d.%08d.%d.txt", partition.getI0(), partition.getJ0(), partition.getI1(), partition.getJ1(), mustDispatchLastColumn());
 	PROFILING_INIT(str);
 
+	/* the block scores are only needed for pruning and score dispatching */
+	blockProcessor->setScoreParameters(getScoreParameters());
+	blockProcessor->setBestScoreTracking(mustPruneBlocks() || mustDispatchScores());
+	blockProcessor->setTileSize(params->getTileSize());
+
 	/* local initializations */
 	int grid_width = grid->getGridWidth();
 	int grid_height = grid->getGridHeight();
@@ -361,7 +374,11 @@ void AbstractBlockAligner::alignBlock(int bx, int by) {
  * @param true if the block was processed or false if it was pruned.
  */
 bool AbstractBlockAligner::processBlock(int bx, int by, int i0, int j0, int i1,	int j1) {
-	if (!isBlockPruned(bx, by)) {
+	pthread_mutex_lock(&pruningMutex);
+	bool pruned = isBlockPruned(bx, by);
+	pthread_mutex_unlock(&pruningMutex);
+
+	if (!pruned) {
 		/* the block was not pruned */
 		if (DEBUG) printf(">>>AbstractBlockAligner::processBlock(%d, %d, %d, %d, %d, %d)\n", bx, by, i0, j0, i1, j1);
 
@@ -377,16 +394,19 @@ bool AbstractBlockAligner::processBlock(int bx, int by, int i0, int j0, int i1,
 		PROFILING_PRINT(bx, by, grid_scores[bx][by].score, 1, t1-t0);
 
 		/* Updates the block pruning status */
+		pthread_mutex_lock(&pruningMutex);
 		pruningUpdate(bx, by, grid_scores[bx][by].score);
-
-		increaseBlockStat(false);
+		increaseBlockStat(false, ((long long)(i1-i0))*(j1-j0));
+		pthread_mutex_unlock(&pruningMutex);
 
 		/* Dispatch the best score found in block (bx,by) */
 		//dispatchScore(grid_scores[bx][by], bx, by);
 		return true;
 	} else {
 		/* the block was pruned */
+		pthread_mutex_lock(&pruningMutex);
 		ignoreBlock(bx, by);
+		pthread_mutex_unlock(&pruningMutex);
 		return false;
 	}
 
@@ -397,16 +417,23 @@ bool AbstractBlockAligner::processBlock(int bx, int by, int i0, int j0, int i1,
  */
 void AbstractBlockAligner::ignoreBlock(int bx, int by) {
 	PROFILING_PRINT(bx, by, 0, 0, 0);
-	increaseBlockStat(true);
+	int i0;
+	int i1;
+	int j0;
+	int j1;
+	getGrid()->getBlockPosition(bx, by, &i0, &j0, &i1, &j1);
+	increaseBlockStat(true, ((long long)(i1-i0))*(j1-j0));
 }
 
 /*
- * Updates statTotalBlocks and statPrunedBlocks variables
+ * Updates the block and cell statistics
  */
-void AbstractBlockAligner::increaseBlockStat(const bool pruned) {
+void AbstractBlockAligner::increaseBlockStat(const bool pruned, const long long cells) {
 	statTotalBlocks++;
+	statTotalCells += cells;
 	if (pruned) {
 		statPrunedBlocks++;
+		statPrunedCells += cells;
 	}
 }
 
@@ -493,6 +520,8 @@ void AbstractBlockAligner::printInitialStatistics(FILE* file) {
 void AbstractBlockAligner::clearStatistics() {
 	statTotalBlocks = 0;
 	statPrunedBlocks = 0;
+	statTotalCells = 0;
+	statPrunedCells = 0;
 
 	statMinBlockWidth = INF;
 	statMaxBlockWidth = 0;
@@ -524,11 +553,24 @@ const char* AbstractBlockAligner::getProgressString() const {
 	return "";
 }
 
-/*
+/**
+ * Returns the number of cells of the processed and pruned blocks since the
+ * last call to AbstractBlockAligner::clearStatistics method.
  *
+ * @return number of processed cells
  */
 long long AbstractBlockAligner::getProcessedCells() {
-	return 0; // Used to calculate the MCUPS performance metric
+	return statTotalCells;
+}
+
+/**
+ * Returns the number of cells of the pruned blocks since the last call to
+ * AbstractBlockAligner::clearStatistics method.
+ *
+ * @return number of pruned cells
+ */
+long long AbstractBlockAligner::getPrunedCells() {
+	return statPrunedCells;
 }
 
 /**
@@ -27,6 +27,8 @@
 #include "../processors/AbstractBlockProcessor.hpp"
 #include "../pruning/BlockPruningGenericN2.hpp"
 
+#include <pthread.h>
+
 /**
  * @brief Abstract class that processes blocks individually considering
  * some schedule mechanism.
@@ -90,9 +92,13 @@ public:
 	virtual void printStatistics(FILE* file);
 	virtual const char* getProgressString() const;
 	virtual long long getProcessedCells();
+	virtual long long getPrunedCells();
 
 
 protected:
+	/** @return the processor that computes the blocks */
+	AbstractBlockProcessor* getBlockProcessor() const;
+
 	/** Chunk of rows used to pass cells from up to bottom blocks */
 	cell_t** row;
 	/** Chunk of columns used to pass cells from left to right blocks */
@@ -146,8 +152,9 @@ protected:
 	/**
 	 * Increased statistics about block processing.
 	 * @param pruned indicates if the block was pruned.
+	 * @param cells number of cells of the block.
 	 */
-	virtual void increaseBlockStat(const bool pruned);
+	virtual void increaseBlockStat(const bool pruned, const long long cells);
 
 	/* Other protected methods*/
 
@@ -190,6 +197,12 @@ private:
 	/** Block Pruner object */
 	BlockPruningGenericN2* blockPruner;
 
+	/**
+	 * Serializes the access to the pruner and to the block statistics,
+	 * since the blocks may be processed by concurrent threads.
+	 */
+	pthread_mutex_t pruningMutex;
+
 	/** Preferred maximum size of a block. */
 	int preferredBlockSize;
 
@@ -217,6 +230,10 @@ private:
 	int statTotalBlocks;
 	/** Number of pruned blocks */
 	int statPrunedBlocks;
+	/** Total number of cells of the processed and pruned blocks */
+	long long statTotalCells;
+	/** Number of cells of the pruned blocks */
+	long long statPrunedCells;
 
 
 	/** Score parameters */
@@ -180,6 +180,20 @@ void AbstractDiagonalAligner::processNextIteration() {
 	if (jb1 > 0) {
 		statTotalCells += ((long long)jb1-jb0)* getBlockHeight();
 	}
+	if (windowStart > b0) {
+		getGrid()->getBlockPosition(b0, 0, NULL, &jb0, NULL, NULL);
+		getGrid()->getBlockPosition(min(windowStart, b1)-1, 0, NULL, NULL, NULL, &jb1);
+		if (jb1 > jb0) {
+			statPrunedCells += ((long long)jb1-jb0)* getBlockHeight();
+		}
+	}
+	if (windowEnd+1 < b1) {
+		getGrid()->getBlockPosition(max(windowEnd+1, b0), 0, NULL, &jb0, NULL, NULL);
+		getGrid()->getBlockPosition(b1-1, 0, NULL, NULL, NULL, &jb1);
+		if (jb1 > jb0) {
+			statPrunedCells += ((long long)jb1-jb0)* getBlockHeight();
+		}
+	}
 
 	currentExternalDiagonal++;
 
@@ -239,6 +253,27 @@ Grid* AbstractDiagonalAligner::configureGrid(Partition partition) {
 }
 
 
+/**
+ * @copydoc AbstractDiagonalAligner::getTotalBlocks
+ */
+int AbstractDiagonalAligner::getTotalBlocks() const {
+	return statTotalBlocks;
+}
+
+/**
+ * @copydoc AbstractDiagonalAligner::getPrunedBlocksLeft
+ */
+int AbstractDiagonalAligner::getPrunedBlocksLeft() const {
+	return statPrunedBlocksLeft;
+}
+
+/**
+ * @copydoc AbstractDiagonalAligner::getPrunedBlocksRight
+ */
+int AbstractDiagonalAligner::getPrunedBlocksRight() const {
+	return statPrunedBlocksRight;
+}
+
 /**
  * @copydoc IAligner::clearStatistics
  */
@@ -247,6 +282,7 @@ void AbstractDiagonalAligner::clearStatistics() {
 	statPrunedBlocksRight = 0;
 	statTotalBlocks = 0;
 	statTotalCells = 0;
+	statPrunedCells = 0;
 
 	statMinGridWidth = INF;
 	statMaxGridWidth = 0;
@@ -276,16 +312,19 @@ void AbstractDiagonalAligner::printFinalStatistics(FILE* file) {
  * @see IAligner::printStatistics
  */
 void AbstractDiagonalAligner::printStatistics(FILE* file) {
+	int totalBlocks = getTotalBlocks();
+	int prunedLeft = getPrunedBlocksLeft();
+	int prunedRight = getPrunedBlocksRight();
 
 	fprintf(file, "\n=====  PRUNING STATS   =====\n");
 	fprintf(file, "Pruned Blocks: %d = %d + %d\n",
-			statPrunedBlocksLeft+statPrunedBlocksRight,
-			statPrunedBlocksLeft,
-			statPrunedBlocksRight);
+			prunedLeft+prunedRight,
+			prunedLeft,
+			prunedRight);
 	fprintf(file, "Pruned Blocks: %.4f = %.4f + %.4f\n",
-			((statPrunedBlocksLeft+statPrunedBlocksRight) * 100.0f) / statTotalBlocks,
-			(statPrunedBlocksLeft * 100.0f) / statTotalBlocks,
-			(statPrunedBlocksRight * 100.0f) / statTotalBlocks);
+			((prunedLeft+prunedRight) * 100.0f) / totalBlocks,
+			(prunedLeft * 100.0f) / totalBlocks,
+			(prunedRight * 100.0f) / totalBlocks);
 
 	fprintf(file, "\n===== RUNTIME VARIABLES =====\n");
 	fprintf(file, "     Block Count: %d-%d\n", statMinGridWidth, statMaxGridWidth);
@@ -303,19 +342,32 @@ long long AbstractDiagonalAligner::getProcessedCells() {
 	return statTotalCells;
 }
 
+/**
+ * Returns the number of cells in the pruned blocks since the last call to
+ * AbstractDiagonalAligner::clearStatistics method.
+ *
+ * @return number of pruned cells
+ */
+long long AbstractDiagonalAligner::getPrunedCells() {
+	return statPrunedCells;
+}
+
 /**
  * MASA-Core prints this string periodically.
  * @return the string to be printed.
  */
 const char* AbstractDiagonalAligner::getProgressString() const {
 	static char str[128];
+	int totalBlocks = getTotalBlocks();
+	int prunedLeft = getPrunedBlocksLeft();
+	int prunedRight = getPrunedBlocksRight();
 
 	sprintf(str, "PROGRESS: %4d/%4d  cut:%d/%d (%d/%d %.1f%% %.1f%%)",
 			currentExternalDiagonal, externalDiagonalCount,
 			windowStart, windowEnd,
-			this->statPrunedBlocksLeft, this->statPrunedBlocksRight,
-			(this->statPrunedBlocksLeft * 100.0f) / statTotalBlocks,
-		(this->statPrunedBlocksRight * 100.0f) / statTotalBlocks);
+			prunedLeft, prunedRight,
+			(prunedLeft * 100.0f) / totalBlocks,
+		(prunedRight * 100.0f) / totalBlocks);
 	return str;
 }
 
@@ -487,7 +539,7 @@ void AbstractDiagonalAligner::loadFirstColumn() {
         receiveFirstColumn((cell_t*) (h_loadColumn+1), len); // from MASA-Core
 
 		/* Padding */
-		for (int i = len; i < getBlockHeight(); i++) {
+		for (int i = len+1; i <= getBlockHeight(); i++) {
 			h_loadColumn[i].h = -INF;
 			h_loadColumn[i].e = -INF;
 		}
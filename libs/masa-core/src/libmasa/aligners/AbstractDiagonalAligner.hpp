@@ -22,7 +22,7 @@
 #ifndef ABSTRACTDIAGONALALIGNER_HPP_
 #define ABSTRACTDIAGONALALIGNER_HPP_
 
-#include "../libmasa.hpp"
+#include "AbstractAligner.hpp"
 
 #include "../pruning/BlockPruningDiagonal.hpp"
 
@@ -70,6 +70,7 @@ public:
 	virtual void printFinalStatistics(FILE* file);
 	virtual void printStatistics(FILE* file);
 	virtual long long getProcessedCells();
+	virtual long long getPrunedCells();
 	virtual const char* getProgressString() const;
 
 protected:
@@ -181,6 +182,29 @@ protected:
 	virtual void finalizeDiagonals() = 0;
 
 
+	/* Statistics methods that may be overridden by subclasses */
+
+	/**
+	 * Returns the number of blocks of the processed diagonals. The default
+	 * implementation is the count of the grid, and the pruned blocks are
+	 * estimated from the window of each diagonal; aligners that know
+	 * exactly which blocks were skipped may override the three methods.
+	 *
+	 * @return the number of blocks since the last clearStatistics call.
+	 */
+	virtual int getTotalBlocks() const;
+
+	/**
+	 * @return the number of blocks pruned at the left of the window.
+	 */
+	virtual int getPrunedBlocksLeft() const;
+
+	/**
+	 * @return the number of blocks pruned at the right of the window.
+	 */
+	virtual int getPrunedBlocksRight() const;
+
+
 	/* Other protected methods*/
 
 	Partition getPartition() const;
@@ -223,6 +247,8 @@ private:
 	int statPrunedBlocksRight;
 	/** Total number of cells in the grid */
 	long long statTotalCells;
+	/** Number of cells of the pruned blocks */
+	long long statPrunedCells;
 	/** Maintains the minimum gridWidth used. */
 	int statMinGridWidth;
 	/** Maintains the maximum gridWidth used. */
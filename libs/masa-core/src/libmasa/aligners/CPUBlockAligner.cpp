@@ -0,0 +1,383 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "CPUBlockAligner.hpp"
+#include "../processors/CPUBlockProcessor.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Set to (1) in order to print debug information in the stdout. This
+ * significantly degrades the performance.
+ */
+#define DEBUG (0)
+
+/**
+ * CPUBlockAligner constructor.
+ */
+CPUBlockAligner::CPUBlockAligner(AbstractBlockProcessor* blockProcessor,
+		BlockAlignerParameters* params, int threadCount)
+		: AbstractBlockAligner(blockProcessor, params) {
+	if (threadCount <= 0) {
+		threadCount = sysconf( _SC_NPROCESSORS_ONLN );
+	}
+	if (threadCount <= 0) {
+		threadCount = 1;
+	}
+	this->threadCount = threadCount;
+
+	this->gridWidth = 0;
+	this->gridHeight = 0;
+	this->activeWorkers = 0;
+	this->pendingDependencies = NULL;
+	this->readyQueues = NULL;
+	this->queueMutexes = NULL;
+	this->readyCount = 0;
+	this->remainingBlocks = 0;
+	this->stopped = false;
+	this->statStolenBlocks = 0;
+
+	pthread_mutex_init(&idleMutex, NULL);
+	pthread_cond_init(&idleCondition, NULL);
+	pthread_mutex_init(&receiveMutex, NULL);
+	pthread_mutex_init(&dispatchMutex, NULL);
+}
+
+/**
+ * CPUBlockAligner destructor.
+ */
+CPUBlockAligner::~CPUBlockAligner() {
+	pthread_mutex_destroy(&idleMutex);
+	pthread_cond_destroy(&idleCondition);
+	pthread_mutex_destroy(&receiveMutex);
+	pthread_mutex_destroy(&dispatchMutex);
+}
+
+/**
+ * Prints the pruning statistics and the scheduler statistics.
+ * @param file handler to print out the statistics.
+ * @see IAligner::printStatistics
+ */
+void CPUBlockAligner::printStatistics(FILE* file) {
+	AbstractBlockAligner::printStatistics(file);
+	fprintf(file, "          Threads: %d\n", threadCount);
+	fprintf(file, "    Stolen Blocks: %d\n", statStolenBlocks);
+	fflush(file);
+}
+
+/**
+ * Creates a worker with the same parameters and a share of the threads.
+ * A custom block processor may keep per-instance state, so workers are
+ * only supported with the CPUBlockProcessor.
+ *
+ * @see AbstractAligner::createWorker
+ */
+AbstractAligner* CPUBlockAligner::createWorker(int id, int count) {
+	if (dynamic_cast<CPUBlockProcessor*>(getBlockProcessor()) == NULL) {
+		return NULL;
+	}
+	int threads = threadCount/count;
+	if (id < threadCount%count) {
+		threads++;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	return new CPUBlockAligner(NULL, (BlockAlignerParameters*)getParameters(), threads);
+}
+
+/**
+ * Processes the whole grid with the pool of threads. This method returns
+ * only when all the blocks are finished or when MASA-Core asks to stop.
+ *
+ * @param grid_width width of the grid in blocks.
+ * @param grid_height height of the grid in blocks.
+ */
+void CPUBlockAligner::scheduleBlocks(int grid_width, int grid_height) {
+	gridWidth = grid_width;
+	gridHeight = grid_height;
+
+	int blockCount = grid_width*grid_height;
+	pendingDependencies = new int[blockCount];
+	for (int by = 0; by < grid_height; by++) {
+		for (int bx = 0; bx < grid_width; bx++) {
+			pendingDependencies[by*grid_width + bx] = (bx > 0) + (by > 0);
+		}
+	}
+
+	/* Small grids use fewer threads, without shrinking the pool of the
+	 * next partitions */
+	int workers = threadCount;
+	if (workers > blockCount) {
+		workers = blockCount;
+	}
+	activeWorkers = workers;
+	readyQueues = new deque<int>[workers];
+	queueMutexes = new pthread_mutex_t[workers];
+	for (int k = 0; k < workers; k++) {
+		pthread_mutex_init(&queueMutexes[k], NULL);
+	}
+
+	readyCount = 0;
+	remainingBlocks = blockCount;
+	stopped = false;
+
+	/* block (0,0) is the only block without dependencies */
+	pushBlock(0, 0);
+
+	pthread_t* threads = new pthread_t[workers];
+	worker_args_t* args = new worker_args_t[workers];
+	for (int k = 0; k < workers; k++) {
+		args[k].aligner = this;
+		args[k].id = k;
+		int rc = pthread_create(&threads[k], NULL, staticWorkerThread, (void *)&args[k]);
+		if (rc) {
+			fprintf(stderr, "CPUBlockAligner ERROR; return code from pthread_create() is %d\n", rc);
+			exit(-1);
+		}
+	}
+	for (int k = 0; k < workers; k++) {
+		pthread_join(threads[k], NULL);
+	}
+	delete[] threads;
+	delete[] args;
+
+	for (int k = 0; k < workers; k++) {
+		pthread_mutex_destroy(&queueMutexes[k]);
+	}
+	delete[] queueMutexes;
+	queueMutexes = NULL;
+	delete[] readyQueues;
+	readyQueues = NULL;
+	delete[] pendingDependencies;
+	pendingDependencies = NULL;
+
+	if (DEBUG) printf("CPUBlockAligner: %d blocks remaining, %d stolen\n", remainingBlocks, statStolenBlocks);
+}
+
+/**
+ * Receives the first row/column of the block from MASA-Core, processes
+ * the block and dispatches the special rows and the last column.
+ *
+ * @param bx horizontal block coordinate
+ * @param by vertical block coordinate
+ * @param i0 vertical first row of the block
+ * @param j0 horizontal first column of the block
+ * @param i1 vertical last row of the block
+ * @param j1 horizontal last column of the block
+ */
+void CPUBlockAligner::alignBlock(int bx, int by, int i0, int j0, int i1, int j1) {
+	const int width = j1 - j0;
+	const int height = i1 - i0;
+
+	cell_t firstColumnCell; // first cell of the special row (bx == 0)
+	cell_t firstRowCell;    // first cell of the last column (by == 0)
+
+	pthread_mutex_lock(&receiveMutex);
+	if (bx == 0) {
+		/* H[i0-1][j0-1] is the last cell of the previous chunk */
+		col[by][0] = getFirstColumnTail();
+		receiveFirstColumn(col[by]+1, height);
+		firstColumnCell = getFirstColumnTail();
+	}
+	if (by == 0) {
+		receiveFirstRow(row[bx], width);
+		firstRowCell = getFirstRowTail();
+	}
+	pthread_mutex_unlock(&receiveMutex);
+
+	if (!processBlock(bx, by, i0, j0, i1, j1)) {
+		clearBlock(bx, by, width, height);
+	}
+
+	const bool specialRow = isSpecialRow(by);
+	const bool specialColumn = isSpecialColumn(bx);
+	if (specialRow || specialColumn) {
+		pthread_mutex_lock(&dispatchMutex);
+		if (specialRow) {
+			if (bx == 0) {
+				firstColumnCell.f = -INF;
+				dispatchRow(i1, &firstColumnCell, 1);
+			}
+			dispatchRow(i1, row[bx], width);
+		}
+		if (specialColumn) {
+			if (by == 0) {
+				firstRowCell.f = -INF;
+				dispatchColumn(j1, &firstRowCell, 1);
+			}
+			dispatchColumn(j1, col[by]+1, height);
+		}
+		pthread_mutex_unlock(&dispatchMutex);
+	}
+}
+
+/**
+ * Fills the output row/column of a pruned block with -INF, so the
+ * neighbour blocks and the special rows do not read stale cells.
+ */
+void CPUBlockAligner::clearBlock(int bx, int by, int width, int height) {
+	/* the diagonal cell of block (bx+1,by) is not affected by pruning */
+	col[by][0].h = row[bx][width-1].h;
+	for (int j = 0; j < width; j++) {
+		row[bx][j].h = -INF;
+		row[bx][j].f = -INF;
+	}
+	for (int i = 1; i <= height; i++) {
+		col[by][i].h = -INF;
+		col[by][i].e = -INF;
+	}
+}
+
+void* CPUBlockAligner::staticWorkerThread(void* arg) {
+	worker_args_t* args = (worker_args_t*)arg;
+	args->aligner->executeWorker(args->id);
+	return NULL;
+}
+
+/**
+ * Main loop of the worker thread $id$. The worker executes its own blocks
+ * in LIFO order and steals blocks from other workers when it is idle.
+ */
+void CPUBlockAligner::executeWorker(int id) {
+	while (true) {
+		int block;
+		if (!popBlock(id, &block) && !stealBlock(id, &block)) {
+			pthread_mutex_lock(&idleMutex);
+			while (readyCount == 0 && remainingBlocks > 0 && !stopped) {
+				pthread_cond_wait(&idleCondition, &idleMutex);
+			}
+			bool done = (remainingBlocks == 0 || stopped);
+			pthread_mutex_unlock(&idleMutex);
+			if (done) {
+				break;
+			}
+			continue;
+		}
+
+		if (!mustContinue()) {
+			pthread_mutex_lock(&idleMutex);
+			stopped = true;
+			pthread_cond_broadcast(&idleCondition);
+			pthread_mutex_unlock(&idleMutex);
+			break;
+		}
+
+		int bx = block % gridWidth;
+		int by = block / gridWidth;
+		AbstractBlockAligner::alignBlock(bx, by);
+		finishBlock(id, bx, by);
+	}
+}
+
+/**
+ * Pushes a ready block in the deque of worker $id$.
+ */
+void CPUBlockAligner::pushBlock(int id, int block) {
+	pthread_mutex_lock(&queueMutexes[id]);
+	readyQueues[id].push_back(block);
+	pthread_mutex_unlock(&queueMutexes[id]);
+
+	pthread_mutex_lock(&idleMutex);
+	readyCount++;
+	pthread_cond_signal(&idleCondition);
+	pthread_mutex_unlock(&idleMutex);
+}
+
+/**
+ * Pops the most recent block from the deque of worker $id$.
+ */
+bool CPUBlockAligner::popBlock(int id, int* block) {
+	bool found = false;
+	pthread_mutex_lock(&queueMutexes[id]);
+	if (!readyQueues[id].empty()) {
+		*block = readyQueues[id].back();
+		readyQueues[id].pop_back();
+		found = true;
+	}
+	pthread_mutex_unlock(&queueMutexes[id]);
+
+	if (found) {
+		pthread_mutex_lock(&idleMutex);
+		readyCount--;
+		pthread_mutex_unlock(&idleMutex);
+	}
+	return found;
+}
+
+/**
+ * Steals the oldest block from the deque of any other worker.
+ */
+bool CPUBlockAligner::stealBlock(int id, int* block) {
+	for (int k = 1; k < activeWorkers; k++) {
+		int victim = (id + k) % activeWorkers;
+		bool found = false;
+		pthread_mutex_lock(&queueMutexes[victim]);
+		if (!readyQueues[victim].empty()) {
+			*block = readyQueues[victim].front();
+			readyQueues[victim].pop_front();
+			found = true;
+		}
+		pthread_mutex_unlock(&queueMutexes[victim]);
+
+		if (found) {
+			pthread_mutex_lock(&idleMutex);
+			readyCount--;
+			statStolenBlocks++;
+			pthread_mutex_unlock(&idleMutex);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Decrements the dependencies of block $(bx,by)$ and pushes it in the
+ * deque of worker $id$ when it becomes ready.
+ */
+void CPUBlockAligner::releaseBlock(int id, int bx, int by) {
+	if (bx >= gridWidth || by >= gridHeight) {
+		return;
+	}
+	int block = by*gridWidth + bx;
+	if (__sync_sub_and_fetch(&pendingDependencies[block], 1) == 0) {
+		pushBlock(id, block);
+	}
+}
+
+/**
+ * Marks block $(bx,by)$ as finished, releasing its bottom and right
+ * neighbours. The right neighbour is pushed last, so the worker continues
+ * in the same row of blocks.
+ */
+void CPUBlockAligner::finishBlock(int id, int bx, int by) {
+	releaseBlock(id, bx, by+1);
+	releaseBlock(id, bx+1, by);
+
+	pthread_mutex_lock(&idleMutex);
+	remainingBlocks--;
+	if (remainingBlocks == 0) {
+		pthread_cond_broadcast(&idleCondition);
+	}
+	pthread_mutex_unlock(&idleMutex);
+}
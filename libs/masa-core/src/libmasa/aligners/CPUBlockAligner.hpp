@@ -0,0 +1,126 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef CPUBLOCKALIGNER_HPP_
+#define CPUBLOCKALIGNER_HPP_
+
+#include "AbstractBlockAligner.hpp"
+
+#include <pthread.h>
+#include <deque>
+using namespace std;
+
+/**
+ * @brief Multi-threaded block aligner for CPU-only nodes.
+ *
+ * The CPUBlockAligner schedules the blocks of the grid in anti-diagonal
+ * waves over a pool of threads. Each block $(bx,by)$ becomes ready when
+ * both blocks $(bx-1,by)$ and $(bx,by-1)$ are finished. Ready blocks are
+ * pushed in the deque of the thread that released them, so a thread usually
+ * keeps processing the same row of blocks (and the same col[by] vector).
+ * Idle threads steal the oldest block from the deque of another thread.
+ *
+ * The calls to MASA-Core are serialized: the first row/column are received
+ * under one lock and the special rows and the last column are dispatched
+ * under another lock. The dependencies of the wavefront guarantee that the
+ * chunks of each row/column are received and dispatched in order.
+ */
+class CPUBlockAligner : public AbstractBlockAligner {
+public:
+	/**
+	 * Constructor
+	 *
+	 * @param blockProcessor the block processor to be used. If NULL, the
+	 * CPUBlockProcessor will be used.
+	 * @param params the aligner parameters. If NULL, the default param
+	 * class will be used.
+	 * @param threadCount number of worker threads. If zero or negative,
+	 * one thread per online processor is created.
+	 */
+	CPUBlockAligner(AbstractBlockProcessor* blockProcessor = NULL,
+			BlockAlignerParameters* params = NULL, int threadCount = 0);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~CPUBlockAligner();
+
+	virtual void printStatistics(FILE* file);
+
+protected:
+	virtual AbstractAligner* createWorker(int id, int count);
+	virtual void scheduleBlocks(int grid_width, int grid_height);
+	virtual void alignBlock(int bx, int by, int i0, int j0, int i1, int j1);
+
+private:
+	/** Number of worker threads */
+	int threadCount;
+	/** Number of worker threads running the current grid */
+	int activeWorkers;
+
+	/** Dimensions of the grid being scheduled */
+	int gridWidth;
+	int gridHeight;
+
+	/** Number of unfinished dependencies of each block (by*gridWidth+bx) */
+	int* pendingDependencies;
+
+	/** Ready blocks of each thread */
+	deque<int>* readyQueues;
+	/** Locks for each of the readyQueues */
+	pthread_mutex_t* queueMutexes;
+
+	/** Guards readyCount, remainingBlocks and stopped */
+	pthread_mutex_t idleMutex;
+	/** Signals that there are new ready blocks or that the grid is over */
+	pthread_cond_t idleCondition;
+	/** Number of blocks waiting in any of the readyQueues */
+	int readyCount;
+	/** Number of blocks not finished yet */
+	int remainingBlocks;
+	/** Indicates that MASA-Core asked to stop the computation */
+	bool stopped;
+
+	/** Serializes the receiveFirstRow/receiveFirstColumn calls */
+	pthread_mutex_t receiveMutex;
+	/** Serializes the dispatchRow/dispatchColumn calls */
+	pthread_mutex_t dispatchMutex;
+
+	/** Number of blocks stolen from other threads (statistics) */
+	int statStolenBlocks;
+
+	struct worker_args_t {
+		CPUBlockAligner* aligner;
+		int id;
+	};
+
+	static void* staticWorkerThread(void* arg);
+	void executeWorker(int id);
+
+	void pushBlock(int id, int block);
+	bool popBlock(int id, int* block);
+	bool stealBlock(int id, int* block);
+	void releaseBlock(int id, int bx, int by);
+	void finishBlock(int id, int bx, int by);
+	void clearBlock(int bx, int by, int width, int height);
+};
+
+#endif /* CPUBLOCKALIGNER_HPP_ */
@@ -0,0 +1,689 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#include "CPUDiagonalAligner.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "../processors/CPUBlockProcessor.hpp"
+
+/**
+ * Set to (1) in order to print debug information in the stdout. This
+ * significantly degrades the performance.
+ */
+#define DEBUG (0)
+
+/*
+ * The score constants
+ */
+#define DNA_MATCH       (1)
+#define DNA_MISMATCH    (-3)
+#define DNA_GAP_EXT     (2)
+#define DNA_GAP_OPEN    (3)
+
+/**
+ * Default height of the blocks, when it is not given in the parameters.
+ */
+#define DEFAULT_BLOCK_HEIGHT	(1024)
+
+/**
+ * Recommended number of blocks per thread in each external diagonal.
+ */
+#define BLOCKS_PER_THREAD		(4)
+
+
+/* ************************************************************************** */
+/*                             Constructors                                   */
+/* ************************************************************************** */
+
+/**
+ * CPUDiagonalAligner constructor.
+ */
+CPUDiagonalAligner::CPUDiagonalAligner(AbstractBlockProcessor* blockProcessor,
+		BlockAlignerParameters* params, int threadCount) {
+	score_params.match = DNA_MATCH;
+	score_params.mismatch = DNA_MISMATCH;
+	score_params.gap_open = DNA_GAP_OPEN;
+	score_params.gap_ext = DNA_GAP_EXT;
+
+	if (params == NULL) {
+		this->params = new BlockAlignerParameters();
+	} else {
+		this->params = params;
+	}
+	if (blockProcessor == NULL) {
+		this->blockProcessor = new CPUBlockProcessor();
+	} else {
+		this->blockProcessor = blockProcessor;
+	}
+
+	if (threadCount <= 0) {
+		threadCount = sysconf( _SC_NPROCESSORS_ONLN );
+	}
+	if (threadCount <= 0) {
+		threadCount = 1;
+	}
+	this->threadCount = threadCount;
+	this->threads = NULL;
+	this->threadArgs = NULL;
+	this->helperCount = 0;
+
+	this->gridWidth = 0;
+	this->gridHeight = 0;
+	this->blockHeight = 0;
+	this->busH = NULL;
+	this->busV = NULL;
+	this->loadColumn = NULL;
+	this->flushColumn = NULL;
+	this->blockScores = NULL;
+
+	this->phaseDiagonal = 0;
+	this->phaseWindowLeft = 0;
+	this->phaseWindowRight = 0;
+	this->phaseLastBlock = -1;
+	this->nextBlock = 0;
+	this->generation = 0;
+	this->activeThreads = 0;
+	this->stopping = false;
+
+	this->statComputedBlocks = 0;
+	this->statPrunedLeft = 0;
+	this->statPrunedRight = 0;
+
+	pthread_mutex_init(&poolMutex, NULL);
+	pthread_cond_init(&workCondition, NULL);
+	pthread_cond_init(&idleCondition, NULL);
+}
+
+/**
+ * CPUDiagonalAligner destructor.
+ */
+CPUDiagonalAligner::~CPUDiagonalAligner() {
+	pthread_mutex_destroy(&poolMutex);
+	pthread_cond_destroy(&workCondition);
+	pthread_cond_destroy(&idleCondition);
+}
+
+
+/* ************************************************************************** */
+/*                             Virtual methods                                */
+/* ************************************************************************** */
+
+/**
+ * Returns the capabilities of the aligner. They are the same of the
+ * CUDAligner, except that the sequences have no size limit.
+ */
+aligner_capabilities_t CPUDiagonalAligner::getCapabilities() {
+	aligner_capabilities_t capabilities;
+	capabilities.smith_waterman 			= SUPPORTED;
+	capabilities.needleman_wunsch 			= SUPPORTED;
+	capabilities.block_pruning 				= SUPPORTED;
+	capabilities.customize_first_column 	= SUPPORTED;
+	capabilities.customize_first_row 		= SUPPORTED;
+	capabilities.dispatch_last_cell 		= SUPPORTED;
+	capabilities.dispatch_last_column 		= SUPPORTED;
+	capabilities.dispatch_last_row 			= SUPPORTED;
+	capabilities.dispatch_special_column 	= NOT_SUPPORTED;
+	capabilities.dispatch_special_row 		= SUPPORTED;
+	capabilities.dispatch_block_scores		= SUPPORTED;
+	capabilities.dispatch_scores			= SUPPORTED;
+	capabilities.process_partition 			= SUPPORTED;
+	capabilities.variable_penalties 		= NOT_SUPPORTED;
+	capabilities.fork_processes				= NOT_SUPPORTED;
+
+	capabilities.maximum_seq0_len	= 0;
+	capabilities.maximum_seq1_len	= 0;
+
+	return capabilities;
+}
+
+/**
+ * Returns the Custom Parameters of this Aligner.
+ * @return the BlockAlignerParameters associated with this aligner.
+ */
+IAlignerParameters* CPUDiagonalAligner::getParameters() {
+	return this->params;
+}
+
+/**
+ * Returns the constant match/mismatch/gaps scores.
+ */
+const score_params_t* CPUDiagonalAligner::getScoreParameters() {
+	return &score_params;
+}
+
+/**
+ * Nothing to be initialized, the structures depend on the partition.
+ */
+void CPUDiagonalAligner::initialize() {
+
+}
+
+/**
+ * Nothing to be finalized, the structures are deallocated after each
+ * partition.
+ */
+void CPUDiagonalAligner::finalize() {
+
+}
+
+/**
+ * Allocates the horizontal bus for the whole sequence 1, as the
+ * CUDAligner does.
+ *
+ * @see IAligner::setSequences
+ */
+void CPUDiagonalAligner::setSequences(const char* seq0, const char* seq1,
+		int seq0_len, int seq1_len) {
+	if (DEBUG) printf("CPUDiagonalAligner::setSequences(%d,%d)\n", seq0_len, seq1_len);
+	blockProcessor->setSequences(seq0, seq1, seq0_len, seq1_len);
+	busH = new cell_t[seq1_len+1];
+}
+
+/**
+ * Disposes the horizontal bus.
+ */
+void CPUDiagonalAligner::unsetSequences() {
+	blockProcessor->unsetSequences();
+	delete[] busH;
+	busH = NULL;
+}
+
+/**
+ * Prints the runtime parameters.
+ * @param file handler to print out the statistics.
+ */
+void CPUDiagonalAligner::printInitialStatistics(FILE* file) {
+	AbstractDiagonalAligner::printInitialStatistics(file);
+
+	fprintf(file, "\n===== RUNTIME PARAMETERS =====\n");
+	fprintf(file, " Threads: %d\n", threadCount);
+	fprintf(file, " Block height: %d %s\n", getBlockHeight(), params->getBlockHeight()==0?"(AUTO)":"");
+	fprintf(file, " Grid width: %d %s\n", params->getGridWidth(), params->getGridWidth()<=0?"(AUTO)":"");
+	fflush(file);
+}
+
+/**
+ * Prints the pruning statistics and the computed blocks.
+ * @param file handler to print out the statistics.
+ */
+void CPUDiagonalAligner::printStatistics(FILE* file) {
+	AbstractDiagonalAligner::printStatistics(file);
+
+	fprintf(file, "          Threads: %d\n", threadCount);
+	fprintf(file, "  Computed Blocks: %lld\n", statComputedBlocks);
+	fflush(file);
+}
+
+/**
+ * @copydoc IAligner::clearStatistics
+ */
+void CPUDiagonalAligner::clearStatistics() {
+	AbstractDiagonalAligner::clearStatistics();
+	statComputedBlocks = 0;
+	statPrunedLeft = 0;
+	statPrunedRight = 0;
+}
+
+/**
+ * Returns the blocks visited by computeBlock, which are exact, instead of
+ * the estimate of the superclass from the window of the next diagonal.
+ */
+int CPUDiagonalAligner::getTotalBlocks() const {
+	return statComputedBlocks + statPrunedLeft + statPrunedRight;
+}
+
+/**
+ * Returns the blocks skipped by computeBlock at the left of the window.
+ */
+int CPUDiagonalAligner::getPrunedBlocksLeft() const {
+	return statPrunedLeft;
+}
+
+/**
+ * Returns the blocks skipped by computeBlock at the right of the window.
+ */
+int CPUDiagonalAligner::getPrunedBlocksRight() const {
+	return statPrunedRight;
+}
+
+/**
+ * Returns the height of the blocks. It is defined by the --block-height
+ * parameter or by the DEFAULT_BLOCK_HEIGHT constant.
+ */
+int CPUDiagonalAligner::getBlockHeight() {
+	if (params->getBlockHeight() > 0) {
+		return params->getBlockHeight();
+	}
+	return DEFAULT_BLOCK_HEIGHT;
+}
+
+/**
+ * Creates a worker with the same parameters and a share of the threads.
+ * A custom block processor may keep per-instance state, so workers are
+ * only supported with the CPUBlockProcessor.
+ *
+ * @see AbstractAligner::createWorker
+ */
+AbstractAligner* CPUDiagonalAligner::createWorker(int id, int count) {
+	if (dynamic_cast<CPUBlockProcessor*>(blockProcessor) == NULL) {
+		return NULL;
+	}
+	int threads = threadCount/count;
+	if (id < threadCount%count) {
+		threads++;
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+	return new CPUDiagonalAligner(NULL, params, threads);
+}
+
+/**
+ * Calculates the number of blocks in the grid width. It is defined by the
+ * --grid-width or --block-width parameters. Otherwise, each thread receives
+ * BLOCKS_PER_THREAD blocks with at least MIN_BLOCK_SIZE columns.
+ *
+ * @param width partition's width
+ * @return number of blocks in each external diagonal.
+ */
+int CPUDiagonalAligner::getGridWidth(const int width) {
+	int blocks;
+	if (params->getGridWidth() > 0) {
+		blocks = params->getGridWidth();
+	} else if (params->getBlockWidth() > 0) {
+		blocks = (width + params->getBlockWidth() - 1) / params->getBlockWidth();
+	} else {
+		blocks = BLOCKS_PER_THREAD * threadCount;
+		if (blocks > width / MIN_BLOCK_SIZE) {
+			blocks = width / MIN_BLOCK_SIZE;
+		}
+	}
+	if (blocks > width) {
+		blocks = width;
+	}
+	if (blocks < 1) {
+		blocks = 1;
+	}
+	if (DEBUG) printf("SIZES partition.width: %d  blocks: %d\n", width, blocks);
+	return blocks;
+}
+
+/**
+ * Returns the range of cells [j,j+len) from the last row of the matrix.
+ * The bottom-most blocks leave the last row in the horizontal bus.
+ *
+ * @param j index of the first cell to be returned.
+ * @param len number of cells to be returned (unused).
+ */
+const cell_t* CPUDiagonalAligner::getLastRow(int j, int) {
+	return busH + j;
+}
+
+/**
+ * Returns the range of cells [j,j+len) from the special row that
+ * crossed the previously computed diagonal.
+ *
+ * @param j index of the first cell to be returned.
+ * @param len number of cells to be returned (unused).
+ */
+const cell_t* CPUDiagonalAligner::getSpecialRow(int j, int) {
+	return busH + j;
+}
+
+/**
+ * Returns the chunk of the last column stored in the last short phase.
+ *
+ * @param i index of the first cell to be returned (unused).
+ * @param len number of cells to be returned (unused).
+ */
+const cell_t* CPUDiagonalAligner::getLastColumn(int, int) {
+	return flushColumn + 1;
+}
+
+/**
+ * Returns the best score of each block of the last long phase.
+ */
+const score_t* CPUDiagonalAligner::getBlockScores() {
+	return blockScores;
+}
+
+/**
+ * Updates the first row of the matrix with the given cells.
+ *
+ * @param cells vector with the cells of the first row.
+ * @param j column where the vector starts.
+ * @param len length of the vector.
+ */
+void CPUDiagonalAligner::setFirstRow(const cell_t* cells, int j, int len) {
+	if (DEBUG) fprintf(stderr, "CPUDiagonalAligner::setFirstRow(..., %d, %d)\n", j, len);
+	memcpy(busH + j, cells, len*sizeof(cell_t));
+}
+
+/**
+ * Keeps the first column chunk until the short phase of the next
+ * processDiagonal call, since the vertical bus slot may still be in use
+ * by the last block of the grid.
+ *
+ * @param cells vector with the diagonal cell and the cells of the first column.
+ * @param i row where the vector starts (unused).
+ * @param len length of the vector (unused).
+ */
+void CPUDiagonalAligner::setFirstColumn(const cell_t* cells, int, int) {
+	memcpy(loadColumn, cells, (blockHeight+1)*sizeof(cell_t));
+}
+
+/**
+ * Clears the horizontal bus for blocks [b0, b1).
+ * @param b0 first block to be cleaned (inclusive).
+ * @param b1 last block be cleaned (exclusive).
+ */
+void CPUDiagonalAligner::clearPrunedBlocks(int b0, int b1) {
+	int p0;
+	int p1;
+	getGrid()->getBlockPosition(b0, 0, NULL, &p0, NULL, NULL);
+	getGrid()->getBlockPosition(b1-1, 0, NULL, NULL, NULL, &p1);
+	for (int j = p0; j < p1; j++) {
+		busH[j].h = -INF;
+		busH[j].f = -INF;
+	}
+}
+
+/**
+ * Allocates the structures of the partition and starts the pool of threads.
+ */
+void CPUDiagonalAligner::initializeDiagonals() {
+	gridWidth = getGrid()->getGridWidth();
+	blockHeight = getBlockHeight();
+	gridHeight = getPartition().getHeight()/blockHeight + 1;
+
+	busV = new cell_t[gridWidth*(blockHeight+1)];
+	loadColumn = new cell_t[blockHeight+1];
+	flushColumn = new cell_t[blockHeight+1];
+	blockScores = new score_t[gridWidth+1]; // the pruning may read one block after the grid
+	for (int bx = 0; bx <= gridWidth; bx++) {
+		blockScores[bx].i = -1;
+		blockScores[bx].j = -1;
+		blockScores[bx].score = -INF;
+	}
+
+	blockProcessor->setScoreParameters(getScoreParameters());
+	blockProcessor->setBestScoreTracking(mustPruneBlocks() || mustDispatchScores());
+	blockProcessor->setTileSize(params->getTileSize());
+
+	startPool();
+}
+
+/**
+ * Processes one external diagonal.
+ *
+ * @param diagonal diagonal number.
+ * @param windowLeft pruning window left.
+ * @param windowRight pruning window right.
+ */
+void CPUDiagonalAligner::processDiagonal(int diagonal, int windowLeft, int windowRight) {
+	/* Long phase: blocks (bx, diagonal-1-bx) */
+	int b0 = std::max(0, diagonal-1 - (gridHeight-1));
+	int b1 = std::min(diagonal-1, gridWidth-1);
+	for (int bx = 0; bx < gridWidth; bx++) {
+		if (bx < b0 || bx > b1) {
+			blockScores[bx].score = -INF;
+		}
+	}
+	if (b0 <= b1) {
+		runLongPhase(diagonal-1, b0, b1, windowLeft, windowRight);
+	}
+
+	/* Short phase: flushes the last column and loads the first column */
+	runShortPhase(diagonal);
+}
+
+/**
+ * Stops the pool of threads and deallocates the structures of the partition.
+ */
+void CPUDiagonalAligner::finalizeDiagonals() {
+	stopPool();
+
+	delete[] busV;
+	busV = NULL;
+	delete[] loadColumn;
+	loadColumn = NULL;
+	delete[] flushColumn;
+	flushColumn = NULL;
+	delete[] blockScores;
+	blockScores = NULL;
+}
+
+
+/* ************************************************************************** */
+/*                             Private methods                                */
+/* ************************************************************************** */
+
+/**
+ * Returns the vertical bus slot of the row of blocks $by$. At most
+ * gridWidth rows of blocks are processed at the same time.
+ */
+cell_t* CPUDiagonalAligner::getBusV(int by) {
+	return busV + (by % gridWidth)*(blockHeight+1);
+}
+
+/**
+ * Fills the diagonal cell and the cells of a column with the given values.
+ */
+void CPUDiagonalAligner::fillColumn(cell_t* column, int h, int e) {
+	column[0].h = h;
+	column[0].e = e;
+	for (int i = 1; i <= blockHeight; i++) {
+		column[i].h = h;
+		column[i].e = e;
+	}
+}
+
+/**
+ * Executes the short phase of the external diagonal. The last block
+ * of the previous diagonal has finished the row of blocks $diagonal-gridWidth$,
+ * so its vertical bus slot contains a chunk of the last column. This slot
+ * is then reused by the row of blocks $diagonal$, which receives the
+ * first column.
+ */
+void CPUDiagonalAligner::runShortPhase(int diagonal) {
+	if (diagonal >= gridWidth && mustDispatchLastColumn()) {
+		memcpy(flushColumn, getBusV(diagonal-gridWidth), (blockHeight+1)*sizeof(cell_t));
+	}
+	if (diagonal < gridHeight) {
+		cell_t* column = getBusV(diagonal);
+		if (getFirstColumnInitType() == INIT_WITH_ZEROES) {
+			fillColumn(column, 0, -INF);
+		} else {
+			memcpy(column, loadColumn, (blockHeight+1)*sizeof(cell_t));
+		}
+	}
+}
+
+/**
+ * Computes the blocks $(bx, diagonal-bx)$ for $bx$ in $[b0,b1]$ with
+ * the pool of threads. The caller thread also computes blocks and
+ * returns only when all of them are finished.
+ */
+void CPUDiagonalAligner::runLongPhase(int diagonal, int b0, int b1,
+		int windowLeft, int windowRight) {
+	pthread_mutex_lock(&poolMutex);
+	while (activeThreads > 0) {
+		pthread_cond_wait(&idleCondition, &poolMutex);
+	}
+	phaseDiagonal = diagonal;
+	phaseWindowLeft = windowLeft;
+	phaseWindowRight = windowRight;
+	phaseLastBlock = b1;
+	nextBlock = b0;
+	generation++;
+	pthread_cond_broadcast(&workCondition);
+	pthread_mutex_unlock(&poolMutex);
+
+	computeBlocks();
+
+	waitIdleThreads();
+}
+
+/**
+ * Waits until all the helper threads have left the current long phase.
+ */
+void CPUDiagonalAligner::waitIdleThreads() {
+	pthread_mutex_lock(&poolMutex);
+	while (activeThreads > 0) {
+		pthread_cond_wait(&idleCondition, &poolMutex);
+	}
+	pthread_mutex_unlock(&poolMutex);
+}
+
+/**
+ * Computes blocks of the current long phase until there is no block left.
+ */
+void CPUDiagonalAligner::computeBlocks() {
+	while (true) {
+		int bx = __sync_fetch_and_add(&nextBlock, 1);
+		if (bx > phaseLastBlock) {
+			break;
+		}
+		computeBlock(bx, phaseDiagonal-bx);
+	}
+}
+
+/**
+ * Computes the block $(bx,by)$. The block reads the top row from the busH
+ * and the left column from the busV slot of its row, writing back the
+ * bottom row and the right column. The pruned blocks only clear the busV
+ * slot, so the next block of the row does not read stale cells.
+ */
+void CPUDiagonalAligner::computeBlock(int bx, int by) {
+	cell_t* column = getBusV(by);
+	if (bx < phaseWindowLeft || bx > phaseWindowRight) {
+		fillColumn(column, -INF, -INF);
+		blockScores[bx].score = -INF;
+		if (bx < phaseWindowLeft) {
+			__sync_add_and_fetch(&statPrunedLeft, 1);
+		} else {
+			__sync_add_and_fetch(&statPrunedRight, 1);
+		}
+		return;
+	}
+
+	int i0 = getPartition().getI0() + by*blockHeight;
+	int i1 = std::min(i0 + blockHeight, getPartition().getI1());
+	int j0;
+	int j1;
+	getGrid()->getBlockPosition(bx, 0, NULL, &j0, NULL, &j1);
+
+	if (DEBUG) printf("CPUDiagonalAligner::computeBlock(%d, %d): [%d..%d] [%d..%d]\n", bx, by, i0, i1, j0, j1);
+	blockScores[bx] = blockProcessor->processBlock(busH + j0, column,
+			i0, j0, i1, j1, getRecurrenceType());
+	__sync_add_and_fetch(&statComputedBlocks, 1);
+}
+
+/**
+ * Creates the threadCount-1 helper threads. The thread calling the
+ * processDiagonal method is the remaining thread of the pool.
+ */
+void CPUDiagonalAligner::startPool() {
+	helperCount = std::min(threadCount, gridWidth) - 1;
+	stopping = false;
+	activeThreads = 0;
+	phaseLastBlock = -1;
+	if (helperCount <= 0) {
+		helperCount = 0;
+		return;
+	}
+
+	threads = new pthread_t[helperCount];
+	threadArgs = new thread_args_t[helperCount];
+	for (int k = 0; k < helperCount; k++) {
+		threadArgs[k].aligner = this;
+		threadArgs[k].id = k+1;
+		threadArgs[k].generation = generation;
+		int rc = pthread_create(&threads[k], NULL, staticPoolThread, (void *)&threadArgs[k]);
+		if (rc) {
+			fprintf(stderr, "CPUDiagonalAligner ERROR; return code from pthread_create() is %d\n", rc);
+			exit(-1);
+		}
+	}
+}
+
+/**
+ * Finishes the helper threads.
+ */
+void CPUDiagonalAligner::stopPool() {
+	if (helperCount == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&poolMutex);
+	stopping = true;
+	pthread_cond_broadcast(&workCondition);
+	pthread_mutex_unlock(&poolMutex);
+
+	for (int k = 0; k < helperCount; k++) {
+		pthread_join(threads[k], NULL);
+	}
+	delete[] threads;
+	threads = NULL;
+	delete[] threadArgs;
+	threadArgs = NULL;
+	helperCount = 0;
+}
+
+void* CPUDiagonalAligner::staticPoolThread(void* arg) {
+	thread_args_t* args = (thread_args_t*)arg;
+	args->aligner->executePoolThread(args->id, args->generation);
+	return NULL;
+}
+
+/**
+ * Main loop of the helper thread $id$. The thread waits for a new long phase,
+ * computes blocks while there are blocks left and signals when it is idle.
+ */
+void CPUDiagonalAligner::executePoolThread(int id, int seenGeneration) {
+	pthread_mutex_lock(&poolMutex);
+	while (true) {
+		while (generation == seenGeneration && !stopping) {
+			pthread_cond_wait(&workCondition, &poolMutex);
+		}
+		if (stopping) {
+			break;
+		}
+		seenGeneration = generation;
+		activeThreads++;
+		pthread_mutex_unlock(&poolMutex);
+
+		computeBlocks();
+
+		pthread_mutex_lock(&poolMutex);
+		activeThreads--;
+		if (activeThreads == 0) {
+			pthread_cond_broadcast(&idleCondition);
+		}
+	}
+	pthread_mutex_unlock(&poolMutex);
+	if (DEBUG) printf("CPUDiagonalAligner: thread %d finished\n", id);
+}
@@ -0,0 +1,209 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+#ifndef CPUDIAGONALALIGNER_HPP_
+#define CPUDIAGONALALIGNER_HPP_
+
+#include "AbstractDiagonalAligner.hpp"
+#include "../processors/AbstractBlockProcessor.hpp"
+#include "../parameters/BlockAlignerParameters.hpp"
+
+#include <pthread.h>
+
+/**
+ * @brief Multi-threaded CPU implementation of the AbstractDiagonalAligner.
+ *
+ * The CPUDiagonalAligner emulates the external diagonal scheme of the
+ * CUDAligner with host threads, so the diagonal pipeline (special rows,
+ * last row/column flushes, block pruning and split partitions) can be
+ * executed without a GPU.
+ *
+ * Each call to processDiagonal(d) is divided in the same two phases of the
+ * CUDA kernels:
+ *
+ * <ul>
+ *  <li>Long phase: computes the blocks $(bx,by)$ with $bx+by=d-1$. The
+ *      blocks are independent and they are distributed over the pool of
+ *      threads. Each block is computed by an AbstractBlockProcessor.
+ *  <li>Short phase: stores the last column of the row of blocks finished
+ *      by the last block and loads the first column of the row of blocks
+ *      started in diagonal $d$.
+ * </ul>
+ *
+ * So, as in the GPU, the rows and columns returned after processDiagonal(d)
+ * belong to the blocks of diagonal $d-1$. The data is exchanged between the
+ * blocks with the same buses of the CUDAligner:
+ *
+ * <ul>
+ *  <li>busH: horizontal bus indexed by the absolute column. It contains
+ *      the bottom row of the last block computed in each column of blocks.
+ *  <li>busV: vertical bus. It has one column slot for each row of blocks
+ *      being processed, reused in a ring of gridWidth slots.
+ * </ul>
+ *
+ * Differently from the GPU, the blocks are rectangles, so the bottom-most
+ * blocks never overwrite a special row before it is flushed and there is no
+ * need of the shifted last row and the extraH vector.
+ */
+class CPUDiagonalAligner : public AbstractDiagonalAligner {
+public:
+	/**
+	 * Constructor
+	 *
+	 * @param blockProcessor the block processor to be used. If NULL, the
+	 * CPUBlockProcessor will be used.
+	 * @param params the aligner parameters. If NULL, the default param
+	 * class will be used.
+	 * @param threadCount number of threads. If zero or negative,
+	 * one thread per online processor is used.
+	 */
+	CPUDiagonalAligner(AbstractBlockProcessor* blockProcessor = NULL,
+			BlockAlignerParameters* params = NULL, int threadCount = 0);
+
+	/**
+	 * Destructor.
+	 */
+	virtual ~CPUDiagonalAligner();
+
+	/* Implementations of the IAligner virtual methods. @see IAligner class. */
+	virtual aligner_capabilities_t getCapabilities();
+	virtual IAlignerParameters* getParameters();
+	virtual const score_params_t* getScoreParameters();
+	virtual void initialize();
+	virtual void finalize();
+	virtual void setSequences(const char* seq0, const char* seq1, int seq0_len, int seq1_len);
+	virtual void unsetSequences();
+
+	virtual void printInitialStatistics(FILE* file);
+	virtual void clearStatistics();
+	virtual void printStatistics(FILE* file);
+
+protected:
+	virtual AbstractAligner* createWorker(int id, int count);
+	virtual int getGridWidth(int width);
+	virtual int getBlockHeight();
+
+	virtual const cell_t* getSpecialRow(int j, int len);
+	virtual const cell_t* getLastRow(int j, int len);
+	virtual const cell_t* getLastColumn(int i, int len);
+	virtual const score_t* getBlockScores();
+
+	virtual void setFirstRow(const cell_t* cells, int j, int len);
+	virtual void setFirstColumn(const cell_t* cells, int i, int len);
+	virtual void clearPrunedBlocks(int b0, int b1);
+
+	virtual void initializeDiagonals();
+	virtual void processDiagonal(int diagonal, int windowLeft, int windowRight);
+	virtual void finalizeDiagonals();
+
+	virtual int getTotalBlocks() const;
+	virtual int getPrunedBlocksLeft() const;
+	virtual int getPrunedBlocksRight() const;
+
+private:
+	/** Computes the cells of each block */
+	AbstractBlockProcessor* blockProcessor;
+	/** Command line parameters of the aligner */
+	BlockAlignerParameters* params;
+	/** Smith Waterman parameters */
+	score_params_t score_params;
+
+	/** Number of threads, including the caller of processDiagonal */
+	int threadCount;
+	/** Number of helper threads of the pool (threadCount-1 or less) */
+	int helperCount;
+	/** Helper threads of the pool */
+	pthread_t* threads;
+
+	/** Dimensions of the grid of the current partition */
+	int gridWidth;
+	int gridHeight;
+	/** Height of the blocks of the current partition */
+	int blockHeight;
+
+	/** Horizontal bus, indexed by the absolute column */
+	cell_t* busH;
+	/** Vertical bus: gridWidth slots with blockHeight+1 cells (diagonal cell first) */
+	cell_t* busV;
+	/** First column received in setFirstColumn (diagonal cell first) */
+	cell_t* loadColumn;
+	/** Last column stored in the short phase */
+	cell_t* flushColumn;
+	/** Best score of each block of the last long phase (gridWidth+1 entries) */
+	score_t* blockScores;
+
+	/*
+	 * Work of the current long phase. These attributes are only modified
+	 * when there is no active thread.
+	 */
+	/** Diagonal of the blocks being computed */
+	int phaseDiagonal;
+	/** Non-pruned window of the blocks being computed (inclusive) */
+	int phaseWindowLeft;
+	int phaseWindowRight;
+	/** Last block of the long phase */
+	int phaseLastBlock;
+	/** Next block to be computed, atomically incremented */
+	int nextBlock;
+
+	/** Guards the generation, activeThreads and stopping attributes */
+	pthread_mutex_t poolMutex;
+	/** Signals a new long phase (or the end of the pool) to the threads */
+	pthread_cond_t workCondition;
+	/** Signals that no thread is computing blocks */
+	pthread_cond_t idleCondition;
+	/** Incremented at each new long phase */
+	int generation;
+	/** Number of helper threads computing blocks of the current phase */
+	int activeThreads;
+	/** Indicates that the helper threads must finish */
+	bool stopping;
+
+	/** Number of computed and pruned blocks (statistics) */
+	long long statComputedBlocks;
+	long long statPrunedLeft;
+	long long statPrunedRight;
+
+	struct thread_args_t {
+		CPUDiagonalAligner* aligner;
+		int id;
+		/** Generation of the pool when the thread was created */
+		int generation;
+	};
+	/** Arguments of the helper threads */
+	thread_args_t* threadArgs;
+
+	static void* staticPoolThread(void* arg);
+	void executePoolThread(int id, int seenGeneration);
+
+	void startPool();
+	void stopPool();
+	void runLongPhase(int diagonal, int b0, int b1, int windowLeft, int windowRight);
+	void waitIdleThreads();
+	void computeBlocks();
+	void computeBlock(int bx, int by);
+	void runShortPhase(int diagonal);
+
+	cell_t* getBusV(int by);
+	void fillColumn(cell_t* column, int h, int e);
+};
+
+#endif /* CPUDIAGONALALIGNER_HPP_ */
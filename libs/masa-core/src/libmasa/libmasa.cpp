@@ -275,10 +275,16 @@ FASTA FILES:            Supply two sequences in fasta format files.            \
                            URL is given in some of these formats: \n\
                            file://PATH_TO_FILE \n\
                            socket://0.0.0.0:LISTENING_PORT \n\
+                           shm://NAME (shared memory, same host) \n\
+                           The options ?batch=CELLS&deadline=MS define the \n\
+                           maximum cells per send and the coalescing wait. \n\
 --load-column=URL       Loads the first column cells from some destination. The\n\
                            URL is given in some of these formats: \n\
                            file://PATH_TO_FILE \n\
                            socket://HOSTNAME:PORT \n\
+                           shm://NAME (shared memory, same host) \n\
+                           The option ?batch=CELLS defines the maximum cells \n\
+                           per receive. \n\
 --dump-blocks           Saves the result of each block in the alignment file.  \n\
 --max-alignments        Maximum number of alignments to return. Default:"DEFAULT_MAX_ALIGNMENTS_STRING".\n\
 \n\
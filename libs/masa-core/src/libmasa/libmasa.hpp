@@ -35,6 +35,8 @@
 #include "aligners/AbstractBlockAligner.hpp"
 #include "aligners/AbstractDiagonalAligner.hpp"
 #include "aligners/AbstractAlignerSafe.hpp"
+#include "aligners/CPUBlockAligner.hpp"
+#include "aligners/CPUDiagonalAligner.hpp"
 #include "processors/AbstractBlockProcessor.hpp"
 #include "processors/CPUBlockProcessor.hpp"
 
@@ -38,6 +38,9 @@ using namespace std;
 #define DEFAULT_GRID_SIZE		 AUTO_GRID_SIZE
 #define DEFAULT_GRID_SIZE_STR	"Auto"
 
+#define DEFAULT_TILE_SIZE		 AUTO_TILE_SIZE
+#define DEFAULT_TILE_SIZE_STR	"Auto"
+
 /**
  * Usage Strings
  */
@@ -49,6 +52,10 @@ using namespace std;
 --grid-width=W               Divides the Grid in H rows of blocks. Default: "DEFAULT_GRID_SIZE_STR".\n\
 --grid-height=H              Divides the Grid in W columns of blocks. Default: "DEFAULT_GRID_SIZE_STR".\n\
 --grid-size=H,W              Defines the dimensions of the grid.\n\
+--tile-size=S                Processes each block in inner tiles of SxS cells,\n\
+                             in order to keep the working set in cache. Use 0\n\
+                             to disable the tiling. Default: "DEFAULT_TILE_SIZE_STR" (from the\n\
+                             L1/L2 cache sizes).\n\
 "
 
 /**
@@ -60,6 +67,7 @@ using namespace std;
 #define ARG_BLOCK_WIDTH  0x1004
 #define ARG_GRID_SIZE    0x1005
 #define ARG_BLOCK_SIZE   0x1006
+#define ARG_TILE_SIZE    0x1007
 
 static struct option long_options[] = {
         {"block-height",     required_argument,      0, ARG_BLOCK_HEIGHT},
@@ -68,6 +76,7 @@ static struct option long_options[] = {
         {"grid-width",       required_argument,      0, ARG_GRID_WIDTH},
         {"grid-size",        required_argument,      0, ARG_GRID_SIZE},
         {"block-size",       required_argument,      0, ARG_BLOCK_SIZE},
+        {"tile-size",        required_argument,      0, ARG_TILE_SIZE},
         {0, 0, 0, 0}
     };
 
@@ -79,6 +88,7 @@ BlockAlignerParameters::BlockAlignerParameters() {
 	gridHeight = DEFAULT_GRID_SIZE;
 	blockWidth = DEFAULT_BLOCK_SIZE;
 	blockHeight = DEFAULT_BLOCK_SIZE;
+	tileSize = DEFAULT_TILE_SIZE;
 }
 
 void BlockAlignerParameters::printUsage() const {
@@ -113,6 +123,9 @@ int BlockAlignerParameters::processArgument(int argc, char** argv) {
 		case ARG_BLOCK_HEIGHT:
 			sscanf ( optarg, "%d", &blockHeight);
 			break;
+		case ARG_TILE_SIZE:
+			sscanf ( optarg, "%d", &tileSize);
+			break;
 		default:
 			return ret;
 	}
@@ -133,6 +146,13 @@ int BlockAlignerParameters::processArgument(int argc, char** argv) {
 		setLastError(out.str().c_str());
 		return ARGUMENT_ERROR;
 	}
+	if ( tileSize > MAX_BLOCK_SIZE
+			|| (tileSize < MIN_TILE_SIZE && tileSize != 0 && tileSize != AUTO_TILE_SIZE)) {
+		stringstream out;
+		out << "Tile size must be in range [" << MIN_TILE_SIZE << ".."  << MAX_BLOCK_SIZE <<  "].";
+		setLastError(out.str().c_str());
+		return ARGUMENT_ERROR;
+	}
 
 	return ARGUMENT_OK;
 }
@@ -152,3 +172,7 @@ int BlockAlignerParameters::getBlockHeight() const {
 int BlockAlignerParameters::getGridHeight() const {
 	return gridHeight;
 }
+
+int BlockAlignerParameters::getTileSize() const {
+	return tileSize;
+}
@@ -29,6 +29,10 @@
 #define MAX_BLOCK_SIZE 1024*20
 #define MIN_GRID_SIZE 1
 #define MIN_BLOCK_SIZE 128
+#define MIN_TILE_SIZE 32
+
+/** Inner tiles sized from the detected cache hierarchy */
+#define AUTO_TILE_SIZE (-1)
 
 /**
  * This class contains the parameters for the AbstractBlockAligner.
@@ -48,6 +52,9 @@ private:
 	/** Width of one block. 0 indicates variable */
 	int blockWidth;
 
+	/** Size of the inner tiles of each block. AUTO_TILE_SIZE uses the cache size */
+	int tileSize;
+
 public:
 	BlockAlignerParameters();
 	virtual ~BlockAlignerParameters();
@@ -66,6 +73,7 @@ public:
 	int getBlockWidth() const;
 	int getGridWidth() const;
 	int getGridHeight() const;
+	int getTileSize() const;
 };
 
 
@@ -30,3 +30,14 @@ AbstractBlockProcessor::~AbstractBlockProcessor() {
 	// TODO Auto-generated destructor stub
 }
 
+void AbstractBlockProcessor::setScoreParameters(const score_params_t*) {
+
+}
+
+void AbstractBlockProcessor::setBestScoreTracking(bool) {
+
+}
+
+void AbstractBlockProcessor::setTileSize(int) {
+
+}
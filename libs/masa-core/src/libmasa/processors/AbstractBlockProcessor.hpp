@@ -31,6 +31,25 @@ public:
 	virtual void setSequences(const char* seq0, const char* seq1, int seq0_len, int seq1_len) = 0;
 	virtual void unsetSequences() = 0;
 
+	/**
+	 * Defines the match/mismatch scores and gap penalties that must be used
+	 * in the recurrence. The default implementation ignores the parameters.
+	 */
+	virtual void setScoreParameters(const score_params_t* score_params);
+
+	/**
+	 * Informs if processBlock must return the best score of the block. When
+	 * disabled, the returned score may be -INF.
+	 */
+	virtual void setBestScoreTracking(bool enabled);
+
+	/**
+	 * Defines the size of the inner tiles used to process each block. A
+	 * negative value lets the processor choose it, and 0 disables tiling.
+	 * The default implementation ignores it.
+	 */
+	virtual void setTileSize(int tileSize);
+
 	virtual score_t processBlock(cell_t *row, cell_t *col,
 			const int i0, const int j0, const int i1, const int j1,
 			const int recurrenceType) = 0;
@@ -22,6 +22,8 @@
 #include "CPUBlockProcessor.hpp"
 
 #include <stdio.h>
+#include <limits.h>
+#include <unistd.h>
 
 /*
  * Some macros
@@ -29,33 +31,354 @@
 #define MAX2(A,B) (((A)>(B))?(A):(B))
 #define MAX3(A,B,C) (MAX2(MAX2((A),(B)),(C)))
 #define MAX4(A,B,C,D) (MAX2(MAX2((A),(B)),MAX2((C),(D))))
+#define MIN2(A,B) (((A)<(B))?(A):(B))
+
+/* Cache sizes used when they cannot be detected */
+#define DEFAULT_L1_CACHE_SIZE	(32*1024)
+#define DEFAULT_L2_CACHE_SIZE	(256*1024)
 
 #define DEBUG (0)
 
-CPUBlockProcessor::CPUBlockProcessor() {
-	this->seq0 = NULL;
-	this->seq1 = NULL;
-}
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_KERNELS (1)
+#include <immintrin.h>
+#else
+#define SIMD_KERNELS (0)
+#endif
 
-CPUBlockProcessor::~CPUBlockProcessor() {
-	// TODO Auto-generated destructor stub
-}
+#if SIMD_KERNELS
 
-void CPUBlockProcessor::setSequences(const char* seq0, const char* seq1, int seq0_len, int seq1_len) {
-	this->seq0 = seq0;
-	this->seq1 = seq1;
-}
+/* Initial column (t-k) of each lane of the SIMD kernels */
+static const int simd_lane_offsets[16] = {0, -1, -2, -3, -4, -5, -6, -7,
+		-8, -9, -10, -11, -12, -13, -14, -15};
 
-void CPUBlockProcessor::unsetSequences() {
+/*
+ * SSE4.1 kernel: 4 lanes of 32 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#define LANES				(4)
+#define VEC					__m128i
+#define MASK				__m128i
+#define V_SET1(x)			_mm_set1_epi32(x)
+#define V_LOADU(p)			_mm_loadu_si128((const __m128i*)(p))
+#define V_STOREU(p,v)		_mm_storeu_si128((__m128i*)(p), (v))
+#define V_ADD(a,b)			_mm_add_epi32((a), (b))
+#define V_SUB(a,b)			_mm_sub_epi32((a), (b))
+#define V_MAX(a,b)			_mm_max_epi32((a), (b))
+#define V_CMPGT(a,b)		_mm_cmpgt_epi32((a), (b))
+#define V_CMPEQ(a,b)		_mm_cmpeq_epi32((a), (b))
+#define V_MAND(m0,m1)		_mm_and_si128((m0), (m1))
+#define V_BLEND(a,b,m)		_mm_blendv_epi8((a), (b), (m))
+#define V_SHIFT(v,x)		_mm_insert_epi32(_mm_slli_si128((v), 4), (x), 0)
+#define V_LAST(v)			_mm_extract_epi32((v), 3)
+#define KERNEL_NAME			sw_strip_sse41
+#define TRACK_BEST			(1)
+#include "CPUSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#define KERNEL_NAME			sw_strip_sse41_nobest
+#define TRACK_BEST			(0)
+#include "CPUSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+/*
+ * AVX2 kernel: 8 lanes of 32 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define LANES				(8)
+#define VEC					__m256i
+#define MASK				__m256i
+#define V_SET1(x)			_mm256_set1_epi32(x)
+#define V_LOADU(p)			_mm256_loadu_si256((const __m256i*)(p))
+#define V_STOREU(p,v)		_mm256_storeu_si256((__m256i*)(p), (v))
+#define V_ADD(a,b)			_mm256_add_epi32((a), (b))
+#define V_SUB(a,b)			_mm256_sub_epi32((a), (b))
+#define V_MAX(a,b)			_mm256_max_epi32((a), (b))
+#define V_CMPGT(a,b)		_mm256_cmpgt_epi32((a), (b))
+#define V_CMPEQ(a,b)		_mm256_cmpeq_epi32((a), (b))
+#define V_MAND(m0,m1)		_mm256_and_si256((m0), (m1))
+#define V_BLEND(a,b,m)		_mm256_blendv_epi8((a), (b), (m))
+#define V_SHIFT(v,x)		_mm256_blend_epi32(_mm256_permutevar8x32_epi32((v), \
+								_mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), _mm256_set1_epi32(x), 1)
+#define V_LAST(v)			_mm256_extract_epi32((v), 7)
+#define KERNEL_NAME			sw_strip_avx2
+#define TRACK_BEST			(1)
+#include "CPUSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#define KERNEL_NAME			sw_strip_avx2_nobest
+#define TRACK_BEST			(0)
+#include "CPUSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+/*
+ * AVX-512 kernel: 16 lanes of 32 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define LANES				(16)
+#define VEC					__m512i
+#define MASK				__mmask16
+#define V_SET1(x)			_mm512_set1_epi32(x)
+#define V_LOADU(p)			_mm512_loadu_si512((const void*)(p))
+#define V_STOREU(p,v)		_mm512_storeu_si512((void*)(p), (v))
+#define V_ADD(a,b)			_mm512_add_epi32((a), (b))
+#define V_SUB(a,b)			_mm512_sub_epi32((a), (b))
+#define V_MAX(a,b)			_mm512_max_epi32((a), (b))
+#define V_CMPGT(a,b)		_mm512_cmpgt_epi32_mask((a), (b))
+#define V_CMPEQ(a,b)		_mm512_cmpeq_epi32_mask((a), (b))
+#define V_MAND(m0,m1)		((MASK)((m0) & (m1)))
+#define V_BLEND(a,b,m)		_mm512_mask_blend_epi32((m), (a), (b))
+#define V_SHIFT(v,x)		_mm512_mask_set1_epi32(_mm512_permutexvar_epi32( \
+								_mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14), (v)), 1, (x))
+#define V_LAST(v)			_mm_extract_epi32(_mm512_extracti32x4_epi32((v), 3), 3)
+#define KERNEL_NAME			sw_strip_avx512
+#define TRACK_BEST			(1)
+#include "CPUSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#define KERNEL_NAME			sw_strip_avx512_nobest
+#define TRACK_BEST			(0)
+#include "CPUSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+/*
+ * Definitions of the 16-bit kernels (see CPUSimdKernel16.hpp).
+ */
+#define SIMD16_LOW			(-32768)
+#define SIMD16_HIGH			(32767)
+#define SIMD16_MAX_WIDTH	(16384)
+#define SIMD16_MAX_GROWTH	(16384)
+
+/* Initial column (t-k) of each lane of the 16-bit kernels */
+static const short simd16_lane_offsets[32] = {0, -1, -2, -3, -4, -5, -6, -7,
+		-8, -9, -10, -11, -12, -13, -14, -15, -16, -17, -18, -19, -20, -21, -22, -23,
+		-24, -25, -26, -27, -28, -29, -30, -31};
 
+/* Permutation that moves each 16-bit lane k to lane k+1 (AVX-512) */
+static const short simd16_shift_index[32] = {0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10,
+		11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30};
+
+/**
+ * Converts a cell to 16 bits, relative to the given bias, saturating it.
+ */
+static inline short simd16_bias(const int value, const int bias) {
+	long long v = (long long)value - bias;
+	if (v < SIMD16_LOW) return SIMD16_LOW;
+	if (v > SIMD16_HIGH) return SIMD16_HIGH;
+	return (short)v;
 }
 
+/*
+ * SSE4.1 kernel: 8 lanes of 16 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#define LANES				(8)
+#define VEC					__m128i
+#define MASK				__m128i
+#define V_SET1(x)			_mm_set1_epi16(x)
+#define V_LOADU(p)			_mm_loadu_si128((const __m128i*)(p))
+#define V_STOREU(p,v)		_mm_storeu_si128((__m128i*)(p), (v))
+#define V_ADD(a,b)			_mm_adds_epi16((a), (b))
+#define V_SUB(a,b)			_mm_subs_epi16((a), (b))
+#define V_MAX(a,b)			_mm_max_epi16((a), (b))
+#define V_MIN(a,b)			_mm_min_epi16((a), (b))
+#define V_CMPGT(a,b)		_mm_cmpgt_epi16((a), (b))
+#define V_CMPEQ(a,b)		_mm_cmpeq_epi16((a), (b))
+#define V_MAND(m0,m1)		_mm_and_si128((m0), (m1))
+#define V_BLEND(a,b,m)		_mm_blendv_epi8((a), (b), (m))
+#define V_SHIFT(v,x)		_mm_insert_epi16(_mm_slli_si128((v), 2), (x), 0)
+#define V_LAST(v)			((short)_mm_extract_epi16((v), 7))
+#define KERNEL_NAME			sw_block16_sse41
+#define TRACK_BEST			(1)
+#include "CPUSimdKernel16.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#define KERNEL_NAME			sw_block16_sse41_nobest
+#define TRACK_BEST			(0)
+#include "CPUSimdKernel16.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_MIN
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+/*
+ * AVX2 kernel: 16 lanes of 16 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define LANES				(16)
+#define VEC					__m256i
+#define MASK				__m256i
+#define V_SET1(x)			_mm256_set1_epi16(x)
+#define V_LOADU(p)			_mm256_loadu_si256((const __m256i*)(p))
+#define V_STOREU(p,v)		_mm256_storeu_si256((__m256i*)(p), (v))
+#define V_ADD(a,b)			_mm256_adds_epi16((a), (b))
+#define V_SUB(a,b)			_mm256_subs_epi16((a), (b))
+#define V_MAX(a,b)			_mm256_max_epi16((a), (b))
+#define V_MIN(a,b)			_mm256_min_epi16((a), (b))
+#define V_CMPGT(a,b)		_mm256_cmpgt_epi16((a), (b))
+#define V_CMPEQ(a,b)		_mm256_cmpeq_epi16((a), (b))
+#define V_MAND(m0,m1)		_mm256_and_si256((m0), (m1))
+#define V_BLEND(a,b,m)		_mm256_blendv_epi8((a), (b), (m))
+#define V_SHIFT(v,x)		_mm256_insert_epi16(_mm256_alignr_epi8((v), \
+								_mm256_permute2x128_si256((v), (v), 0x08), 14), (x), 0)
+#define V_LAST(v)			((short)_mm256_extract_epi16((v), 15))
+#define KERNEL_NAME			sw_block16_avx2
+#define TRACK_BEST			(1)
+#include "CPUSimdKernel16.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#define KERNEL_NAME			sw_block16_avx2_nobest
+#define TRACK_BEST			(0)
+#include "CPUSimdKernel16.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_MIN
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+/*
+ * AVX-512BW kernel: 32 lanes of 16 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw")
+#define LANES				(32)
+#define VEC					__m512i
+#define MASK				__mmask32
+#define V_SET1(x)			_mm512_set1_epi16(x)
+#define V_LOADU(p)			_mm512_loadu_si512((const void*)(p))
+#define V_STOREU(p,v)		_mm512_storeu_si512((void*)(p), (v))
+#define V_ADD(a,b)			_mm512_adds_epi16((a), (b))
+#define V_SUB(a,b)			_mm512_subs_epi16((a), (b))
+#define V_MAX(a,b)			_mm512_max_epi16((a), (b))
+#define V_MIN(a,b)			_mm512_min_epi16((a), (b))
+#define V_CMPGT(a,b)		_mm512_cmpgt_epi16_mask((a), (b))
+#define V_CMPEQ(a,b)		_mm512_cmpeq_epi16_mask((a), (b))
+#define V_MAND(m0,m1)		((MASK)((m0) & (m1)))
+#define V_BLEND(a,b,m)		_mm512_mask_blend_epi16((m), (a), (b))
+#define V_SHIFT(v,x)		_mm512_mask_set1_epi16(_mm512_permutexvar_epi16( \
+								V_LOADU(simd16_shift_index), (v)), 1, (x))
+#define V_LAST(v)			((short)_mm_extract_epi16(_mm512_extracti32x4_epi32((v), 3), 7))
+#define KERNEL_NAME			sw_block16_avx512
+#define TRACK_BEST			(1)
+#include "CPUSimdKernel16.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#define KERNEL_NAME			sw_block16_avx512_nobest
+#define TRACK_BEST			(0)
+#include "CPUSimdKernel16.hpp"
+#undef KERNEL_NAME
+#undef TRACK_BEST
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_MIN
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+#endif /* SIMD_KERNELS */
 
 /**
  * Implements the smith waterman recurrence function.
  *
  * @param c0 char of sequence s0
  * @param c1 char of sequence s1
+ * @param p			score parameters
  * @param[in,out] 	e00 Input E[i][j-1]; Output E[i][j]
  * @param[in,out] 	f00 Input F[i-1][j]; Output F[i][j]
  * @param[in] 		h01	Input H[i][j-1]
@@ -63,11 +386,11 @@ void CPUBlockProcessor::unsetSequences() {
  * @param[in] 		h10 Input H[i-1][j]
  * @param[out] 		h00 Ouput H[i][j]
  */
-static void sw(const unsigned char c0, const unsigned char c1,
+static inline void sw(const unsigned char c0, const unsigned char c1, const score_params_t& p,
 			int *e00, int *f00, const int h01, const int h11, const int h10, int *h00) {
-    *e00 = MAX2(h01-DNA_GAP_OPEN, *e00)-DNA_GAP_EXT; // Horizontal propagation
-    *f00 = MAX2(h10-DNA_GAP_OPEN, *f00)-DNA_GAP_EXT; // Vertical propagation
-    int v1 = h11+((c1!=c0)?DNA_MISMATCH:DNA_MATCH);
+    *e00 = MAX2(h01-p.gap_open, *e00)-p.gap_ext; // Horizontal propagation
+    *f00 = MAX2(h10-p.gap_open, *f00)-p.gap_ext; // Vertical propagation
+    int v1 = h11+((c1!=c0)?p.mismatch:p.match);
     *h00 = MAX4(0, v1, *e00, *f00);
 }
 
@@ -76,6 +399,7 @@ static void sw(const unsigned char c0, const unsigned char c1,
  *
  * @param c0 char of sequence s0
  * @param c1 char of sequence s1
+ * @param p			score parameters
  * @param[in,out] 	e00 Input E[i][j-1]; Output E[i][j]
  * @param[in,out] 	f00 Input F[i-1][j]; Output F[i][j]
  * @param[in] 		h01	Input H[i][j-1]
@@ -83,15 +407,214 @@ static void sw(const unsigned char c0, const unsigned char c1,
  * @param[in] 		h10 Input H[i-1][j]
  * @param[out] 		h00 Ouput H[i][j]
  */
-static void nw(const unsigned char c0, const unsigned char c1,
+static inline void nw(const unsigned char c0, const unsigned char c1, const score_params_t& p,
 			int *e00, int *f00, const int h01, const int h11, const int h10, int *h00) {
 
-    *e00 = MAX2(h01-DNA_GAP_OPEN, *e00)-DNA_GAP_EXT; // Horizontal propagation
-    *f00 = MAX2(h10-DNA_GAP_OPEN, *f00)-DNA_GAP_EXT; // Vertical propagation
-    int v1 = h11+((c1!=c0)?DNA_MISMATCH:DNA_MATCH);
+    *e00 = MAX2(h01-p.gap_open, *e00)-p.gap_ext; // Horizontal propagation
+    *f00 = MAX2(h10-p.gap_open, *f00)-p.gap_ext; // Vertical propagation
+    int v1 = h11+((c1!=c0)?p.mismatch:p.match);
     *h00 = MAX3(v1, *e00, *f00);
 }
 
+/** Default DNA score parameters, known in compile time */
+static const score_params_t dna_score_params = {DNA_MATCH, DNA_MISMATCH, DNA_GAP_OPEN, DNA_GAP_EXT};
+
+/**
+ * Scalar kernel that processes the rows [r0,height) of the block. The
+ * recurrence type, the best score tracking and the use of the default DNA
+ * scores are template parameters, so the inner loop is specialized for each
+ * combination. When DNA_SCORES is true, the params argument is ignored and
+ * the score constants are folded by the compiler.
+ *
+ * The parameters are the same of the SIMD kernel (see CPUSimdKernel.hpp).
+ */
+template <int RECURRENCE, bool TRACK_BEST, bool DNA_SCORES>
+static void scalar_rows(cell_t* row, cell_t* col, const char* seq0, const char* seq1,
+		const int r0, const int height, const int width, int* diag,
+		const score_params_t* params, const int i0, const int j0, score_t* best) {
+	/* local copies, so they are kept in registers */
+	const score_params_t p = DNA_SCORES ? dna_score_params : *params;
+	score_t block_best = *best;
+
+	int h11 = *diag; // diagonal cell H[i-1][j-1]
+	for (int i=r0; i<height; i++) {
+		/* Reads cells from the previous left-block */
+		int h01 = col[i+1].h;	// H[i][j-1]
+		int e00 = col[i+1].e;	// E[i][j-1]
+
+		const unsigned char c = seq0[i];
+		for (int j=0; j<width; j++) {
+			int h10 = row[j].h; // H[i-1][j]
+			int f10 = row[j].f; // F[i-1][j]
+
+			/* Calculates H[i][j] */
+			int h00;
+			if (RECURRENCE == SMITH_WATERMAN) {
+				sw(c, seq1[j], p, &e00, &f10, h01, h11, h10, &h00);
+			} else {
+				nw(c, seq1[j], p, &e00, &f10, h01, h11, h10, &h00);
+			}
+
+			/* Store the cells to be used in the next iteration */
+			h11 = h10;
+			h01 = h00;
+			row[j].h = h00;
+			row[j].f = f10;
+
+			/* Updates best score if necessary */
+			if (TRACK_BEST && block_best.score < h00) {
+				block_best.score = h00;
+				block_best.i = i0+i;
+				block_best.j = j0+j;
+			}
+		}
+
+		/* Store cells to the next right block */
+		h11 = col[i+1].h;
+		col[i+1].h = h01;
+		col[i+1].e = e00;
+	}
+
+	*diag = h11;
+	*best = block_best;
+}
+
+CPUBlockProcessor::CPUBlockProcessor() {
+	this->seq0 = NULL;
+	this->seq1 = NULL;
+	this->simdLanes = 1;
+	this->simd16Lanes = 1;
+
+	this->scoreParams.match = DNA_MATCH;
+	this->scoreParams.mismatch = DNA_MISMATCH;
+	this->scoreParams.gap_open = DNA_GAP_OPEN;
+	this->scoreParams.gap_ext = DNA_GAP_EXT;
+	this->trackBestScore = true;
+	setTileSize(-1);
+
+#if SIMD_KERNELS
+	/* Runtime dispatch based on the CPUID flags of the running processor */
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		this->simdLanes = 16;
+	} else if (__builtin_cpu_supports("avx2")) {
+		this->simdLanes = 8;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		this->simdLanes = 4;
+	}
+	if (__builtin_cpu_supports("avx512bw")) {
+		this->simd16Lanes = 32;
+	} else if (__builtin_cpu_supports("avx2")) {
+		this->simd16Lanes = 16;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		this->simd16Lanes = 8;
+	}
+#endif
+	selectKernels();
+	if (DEBUG) printf("CPUBlockProcessor: %d/%d SIMD lanes (32/16 bits)\n", this->simdLanes, this->simd16Lanes);
+}
+
+CPUBlockProcessor::~CPUBlockProcessor() {
+	// TODO Auto-generated destructor stub
+}
+
+void CPUBlockProcessor::setSequences(const char* seq0, const char* seq1, int seq0_len, int seq1_len) {
+	this->seq0 = seq0;
+	this->seq1 = seq1;
+}
+
+void CPUBlockProcessor::unsetSequences() {
+
+}
+
+
+void CPUBlockProcessor::setScoreParameters(const score_params_t* score_params) {
+	this->scoreParams = *score_params;
+	selectKernels();
+}
+
+void CPUBlockProcessor::setBestScoreTracking(bool enabled) {
+	this->trackBestScore = enabled;
+	selectKernels();
+}
+
+/**
+ * Defines the inner tiles of the blocks. With a negative tileSize, the tile
+ * width is chosen so one row segment of the tile fills half of the L1 data
+ * cache, and the tile height so the column segment carried between tiles
+ * fills a quarter of the L2 cache. Both are multiples of 32 rows/columns,
+ * so the 16-bit kernels can process whole tiles.
+ */
+void CPUBlockProcessor::setTileSize(int tileSize) {
+	if (tileSize >= 0) {
+		this->tileWidth = tileSize;
+		this->tileHeight = tileSize;
+		return;
+	}
+
+	long l1 = -1;
+	long l2 = -1;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+	l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+	l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	if (l1 <= 0) l1 = DEFAULT_L1_CACHE_SIZE;
+	if (l2 <= 0) l2 = DEFAULT_L2_CACHE_SIZE;
+
+	this->tileWidth = MAX2((int)(l1/(2*sizeof(cell_t))) / 32 * 32, 32);
+	this->tileHeight = MAX2((int)(l2/(4*sizeof(cell_t))) / 32 * 32, 32);
+	if (DEBUG) printf("CPUBlockProcessor: L1: %ld L2: %ld tiles: %dx%d\n", l1, l2, tileHeight, tileWidth);
+}
+
+/**
+ * Selects the kernel instances for the current score parameters, best score
+ * tracking and the SIMD instruction set detected in the constructor.
+ */
+void CPUBlockProcessor::selectKernels() {
+	const bool dna = (scoreParams.match == DNA_MATCH && scoreParams.mismatch == DNA_MISMATCH
+			&& scoreParams.gap_open == DNA_GAP_OPEN && scoreParams.gap_ext == DNA_GAP_EXT);
+	if (trackBestScore && dna) {
+		scalarKernels[0] = scalar_rows<SMITH_WATERMAN, true, true>;
+		scalarKernels[1] = scalar_rows<NEEDLEMAN_WUNSCH, true, true>;
+	} else if (trackBestScore) {
+		scalarKernels[0] = scalar_rows<SMITH_WATERMAN, true, false>;
+		scalarKernels[1] = scalar_rows<NEEDLEMAN_WUNSCH, true, false>;
+	} else if (dna) {
+		scalarKernels[0] = scalar_rows<SMITH_WATERMAN, false, true>;
+		scalarKernels[1] = scalar_rows<NEEDLEMAN_WUNSCH, false, true>;
+	} else {
+		scalarKernels[0] = scalar_rows<SMITH_WATERMAN, false, false>;
+		scalarKernels[1] = scalar_rows<NEEDLEMAN_WUNSCH, false, false>;
+	}
+
+	simdKernel = NULL;
+	simd16Kernel = NULL;
+#if SIMD_KERNELS
+	switch (simd16Lanes) {
+	case 32:
+		simd16Kernel = trackBestScore ? sw_block16_avx512 : sw_block16_avx512_nobest;
+		break;
+	case 16:
+		simd16Kernel = trackBestScore ? sw_block16_avx2 : sw_block16_avx2_nobest;
+		break;
+	case 8:
+		simd16Kernel = trackBestScore ? sw_block16_sse41 : sw_block16_sse41_nobest;
+		break;
+	}
+	switch (simdLanes) {
+	case 16:
+		simdKernel = trackBestScore ? sw_strip_avx512 : sw_strip_avx512_nobest;
+		break;
+	case 8:
+		simdKernel = trackBestScore ? sw_strip_avx2 : sw_strip_avx2_nobest;
+		break;
+	case 4:
+		simdKernel = trackBestScore ? sw_strip_sse41 : sw_strip_sse41_nobest;
+		break;
+	}
+#endif
+}
+
 /**
  * Executes the SW/NW recurrence function for the given block.
  * @param[in,out] 	row		Input: cells from the first row of the block, where
@@ -108,11 +631,70 @@ static void nw(const unsigned char c0, const unsigned char c1,
  * @param[in] 		j0	start column
  * @param[in] 		i1	end row
  * @param[in] 		j1	end column
- * @return
+ * @return the best score of the block, or -INF if the best score tracking
+ * 			is disabled.
+ *
+ * Blocks larger than the tile size are processed in tiles, in row-major
+ * order (see processTile). The output is the same of the untiled block.
  */
 score_t CPUBlockProcessor::processBlock(cell_t *row, cell_t *col,
 		const int i0, const int j0, const int i1, const int j1,
 		const int recurrenceType) {
+	const int height = i1-i0;
+	const int width = j1-j0;
+	if (tileWidth <= 0 || (width <= tileWidth && height <= tileHeight)) {
+		return processTile(row, col, i0, j0, i1, j1, recurrenceType);
+	}
+
+	/* Initializing the best score of this block */
+	score_t block_best;
+	block_best.i = -1;
+	block_best.j = -1;
+	block_best.score = -INF;
+
+	int diag = col[0].h; // H[i0-1][j0-1]
+	for (int ti = 0; ti < height; ti += tileHeight) {
+		const int th = MIN2(tileHeight, height-ti);
+
+		/*
+		 * Each tile writes the diagonal cell of its right neighbour in the
+		 * first cell of its col segment, so the original H[i0+ti-1][j0-1]
+		 * must be restored before the first tile of each tile row.
+		 */
+		const int nextDiag = (ti+th < height) ? col[ti+th].h : 0;
+		col[ti].h = diag;
+
+		for (int tj = 0; tj < width; tj += tileWidth) {
+			const int tw = MIN2(tileWidth, width-tj);
+			score_t tile_best = processTile(row+tj, col+ti, i0+ti, j0+tj, i0+ti+th, j0+tj+tw, recurrenceType);
+
+			/* Keeps the first best cell in row-major order */
+			if (block_best.score < tile_best.score || (block_best.score == tile_best.score
+					&& tile_best.i >= 0 && (tile_best.i < block_best.i
+							|| (tile_best.i == block_best.i && tile_best.j < block_best.j)))) {
+				block_best = tile_best;
+			}
+		}
+		diag = nextDiag;
+	}
+
+	if (DEBUG) printf("ProcessBlock (%d,%d)-(%d,%d) - best:(%d,%d,%d) tiled\n", i0, j0, i1, j1, block_best.score, block_best.i, block_best.j);
+
+	return block_best;
+}
+
+/**
+ * Processes one tile with the same semantics of the processBlock method.
+ *
+ * The tile is first processed with 16-bit lanes (see CPUSimdKernel16.hpp).
+ * If some cell may have saturated, the tile is promoted to 32 bits: strips
+ * of rows are processed by the SIMD kernel selected in the constructor
+ * (see CPUSimdKernel.hpp) and the remaining rows are processed by the scalar
+ * kernel. All of them produce exactly the same cells and best score.
+ */
+score_t CPUBlockProcessor::processTile(cell_t *row, cell_t *col,
+		const int i0, const int j0, const int i1, const int j1,
+		const int recurrenceType) {
 	/* Initializing the best score of this block */
 	score_t block_best;
 	block_best.i = -1;
@@ -123,53 +705,38 @@ score_t CPUBlockProcessor::processBlock(cell_t *row, cell_t *col,
 	const char* seq0 = this->seq0 + i0;
 	const char* seq1 = this->seq1 + j0;
 
-	int h11 = col[0].h; // diagonal cell H[i-1][j-1]
-	//printf("[%d..%d][%d..%d] %d\n", i0, i1, j0, j1, h11);
+	const int height = i1-i0;
+	const int width = j1-j0;
 
-	for (int i=0; i<i1-i0; i++) {
-		/* Reads cells from the previous left-block */
-		int h01 = col[i+1].h;	// H[i][j-1]
-		int e00 = col[i+1].e;	// E[i][j-1]
+	/* Last diagonal cell H[i0-1][j1-1], used by the next right block */
+	const int lastDiag = (width > 0) ? row[width-1].h : col[0].h;
 
-		const unsigned char c = seq0[i];
-		for (int j=0; j<j1-j0; j++) {
-			int h10 = row[j].h; // H[i-1][j]
-			int f10 = row[j].f; // F[i-1][j]
-
-			/* Calculates H[i][j] */
-			int h00;
-			if (recurrenceType == SMITH_WATERMAN) {
-				sw(c, seq1[j], &e00, &f10, h01, h11, h10, &h00);
-			} else {
-				nw(c, seq1[j], &e00, &f10, h01, h11, h10, &h00);
-			}
+	int h11 = col[0].h; // diagonal cell H[i-1][j-1]
+	int i = 0;
+	const int floor = (recurrenceType == SMITH_WATERMAN) ? 0 : INT_MIN;
 
-			/* Store the cells to be used in the next iteration */
-			h11 = h10;
-			h01 = h00;
-			row[j].h = h00;
-			row[j].f = f10;
+	/* The whole block is processed with 16-bit lanes, if they do not saturate */
+	if (simd16Kernel != NULL && simd16Kernel(row, col, seq0, seq1, height, width, floor, &scoreParams, i0, j0, &block_best)) {
+		i = height;
+	}
 
-			/* Updates best score if necessary */
-			if (block_best.score < h00) {
-				block_best.score = h00;
-				block_best.i = i0+i;
-				block_best.j = j0+j;
-			}
+	/* Strips of simdLanes rows are processed by the SIMD kernel */
+	if (simdKernel != NULL && width >= simdLanes) {
+		for (; i+simdLanes <= height; i += simdLanes) {
+			simdKernel(row, col, seq0, seq1, i, width, &h11, floor, &scoreParams, i0, j0, &block_best);
 		}
+	}
 
-		/* Store cells to the next right block */
-		if (i==0) {
-			col[0].h = h11; // Last diagonal cell H[i-1][j-1]
-		}
-		h11 = col[i+1].h;
-		col[i+1].h = h01;
-		col[i+1].e = e00;
+	/* Remaining rows are processed by the scalar kernel */
+	if (i < height) {
+		scalar_rows_kernel_t kernel = scalarKernels[(recurrenceType == SMITH_WATERMAN) ? 0 : 1];
+		kernel(row, col, seq0, seq1, i, height, width, &h11, &scoreParams, i0, j0, &block_best);
+	}
+	if (height > 0) {
+		col[0].h = lastDiag; // Last diagonal cell H[i-1][j-1]
 	}
-	//printf("[%d..%d][%d..%d] %d\n", i0, i1, j0, j1, h11);
 
 	if (DEBUG) printf("ProcessBlock (%d,%d)-(%d,%d) - best:(%d,%d,%d)\n", i0, j0, i1, j1, block_best.score, block_best.i, block_best.j);
 
 	return block_best;
 }
-
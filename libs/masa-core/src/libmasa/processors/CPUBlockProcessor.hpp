@@ -36,6 +36,33 @@
 
 
 
+/*
+ * Kernel that processes a strip of consecutive rows of the block with SIMD
+ * instructions (see CPUSimdKernel.hpp).
+ */
+typedef void (*simd_strip_kernel_t)(cell_t* row, cell_t* col,
+		const char* seq0, const char* seq1, const int r0, const int width,
+		int* diag, const int floor, const score_params_t* params,
+		const int i0, const int j0, score_t* best);
+
+/*
+ * Kernel that processes the whole block with 16-bit SIMD lanes, returning
+ * false if the block must be promoted to 32 bits (see CPUSimdKernel16.hpp).
+ */
+typedef bool (*simd16_block_kernel_t)(cell_t* row, cell_t* col,
+		const char* seq0, const char* seq1, const int height, const int width,
+		const int floor, const score_params_t* params,
+		const int i0, const int j0, score_t* best);
+
+/*
+ * Scalar kernel that processes the last rows of the block, specialized
+ * for each recurrence type.
+ */
+typedef void (*scalar_rows_kernel_t)(cell_t* row, cell_t* col,
+		const char* seq0, const char* seq1, const int r0, const int height,
+		const int width, int* diag, const score_params_t* params,
+		const int i0, const int j0, score_t* best);
+
 class CPUBlockProcessor: public AbstractBlockProcessor {
 public:
 
@@ -44,11 +71,37 @@ public:
 
 	virtual void setSequences(const char* seq0, const char* seq1, int seq0_len, int seq1_len);
 	virtual void unsetSequences();
+	virtual void setScoreParameters(const score_params_t* score_params);
+	virtual void setBestScoreTracking(bool enabled);
+	virtual void setTileSize(int tileSize);
 	virtual score_t processBlock(cell_t *row, cell_t *col, const int i0, const int j0, const int i1, const int j1, const int recurrenceType);
 
 private:
 	const char *seq0;
 	const char *seq1;
+
+	/** Match/mismatch scores and gap penalties used by the kernels */
+	score_params_t scoreParams;
+	/** Indicates if the kernels must compute the best score of the block */
+	bool trackBestScore;
+
+	/** SIMD kernel selected by CPUID, or NULL if not supported */
+	simd_strip_kernel_t simdKernel;
+	/** Number of rows processed by each call of the simdKernel */
+	int simdLanes;
+	/** 16-bit SIMD kernel selected by CPUID, or NULL if not supported */
+	simd16_block_kernel_t simd16Kernel;
+	/** Number of 16-bit lanes of the simd16Kernel */
+	int simd16Lanes;
+	/** Scalar kernels for Smith-Waterman [0] and Needleman-Wunsch [1] */
+	scalar_rows_kernel_t scalarKernels[2];
+
+	/** Dimensions of the inner tiles of the blocks. 0 disables tiling */
+	int tileWidth;
+	int tileHeight;
+
+	void selectKernels();
+	score_t processTile(cell_t *row, cell_t *col, const int i0, const int j0, const int i1, const int j1, const int recurrenceType);
 };
 
 #endif /* CPUBLOCKPROCESSOR_HPP_ */
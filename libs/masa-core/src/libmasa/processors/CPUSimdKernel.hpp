@@ -0,0 +1,178 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/*
+ * SIMD strip kernel of the CPUBlockProcessor.
+ *
+ * This file has no include guard, since it is included once for each
+ * instruction set by CPUBlockProcessor.cpp. Before the inclusion, the
+ * following macros must be defined:
+ *
+ * KERNEL_NAME      name of the generated function.
+ * TRACK_BEST       (1) if the best score of the block must be computed.
+ * LANES            number of int32 lanes of the vector.
+ * VEC, MASK        vector type and comparison mask type.
+ * V_SET1(x)        broadcasts x to all the lanes.
+ * V_LOADU(p)       loads LANES ints from p (unaligned).
+ * V_STOREU(p,v)    stores LANES ints to p (unaligned).
+ * V_ADD, V_SUB, V_MAX    lane-wise int32 operations.
+ * V_CMPGT, V_CMPEQ       lane-wise comparisons returning a MASK.
+ * V_MAND(m0,m1)    intersection of two masks.
+ * V_BLEND(a,b,m)   selects b where m is set, otherwise a.
+ * V_SHIFT(v,x)     moves lane k to lane k+1 and inserts x in lane 0.
+ * V_LAST(v)        extracts the last lane.
+ *
+ * The kernel processes a strip of LANES consecutive rows of the block. Lane
+ * k computes row r0+k and it is delayed by k columns from lane 0, so, at
+ * each step, the lanes compute one anti-diagonal of the strip. The cells
+ * H[i-1][j], F[i-1][j] and H[i-1][j-1] are received from the previous
+ * lane with V_SHIFT, and lane 0 receives them from the row vector. The
+ * substitution scores are obtained comparing the chars of sequence 0 (fixed
+ * per lane) with a shifted window of sequence 1.
+ *
+ * All the arithmetic is done in 32 bits, exactly as the scalar recurrence,
+ * so the output is bit-identical to the scalar code. The best score of each
+ * lane keeps the first column where it was found, and the lanes are merged
+ * in ascending order, so the best position is also the same of the scalar
+ * row-major traversal.
+ *
+ * @param[in,out]	row		cells of the previous row (i0+r0-1). Output: last row of the strip.
+ * @param[in,out]	col		the same vector of AbstractBlockProcessor::processBlock.
+ * @param[in]		seq0	sequence 0 starting at row i0.
+ * @param[in]		seq1	sequence 1 starting at column j0.
+ * @param[in]		r0		first row of the strip, relative to i0.
+ * @param[in]		width	number of columns of the block.
+ * @param[in,out]	diag	Input: original H[r0-1][-1]; Output: original H[r0+LANES-1][-1].
+ * @param[in]		floor	0 for Smith-Waterman or INT_MIN for Needleman-Wunsch.
+ * @param[in]		params	match/mismatch scores and gap penalties.
+ * @param[in]		i0		first row of the block.
+ * @param[in]		j0		first column of the block.
+ * @param[in,out]	best	best score of the block.
+ */
+static void KERNEL_NAME(cell_t* row, cell_t* col, const char* seq0, const char* seq1,
+		const int r0, const int width, int* diag, const int floor,
+		const score_params_t* params, const int i0, const int j0, score_t* best) {
+	int bufH[LANES];
+	int bufE[LANES];
+	int bufC[LANES];
+	for (int k=0; k<LANES; k++) {
+		bufH[k] = col[r0+k+1].h;
+		bufE[k] = col[r0+k+1].e;
+		bufC[k] = (unsigned char)seq0[r0+k];
+	}
+
+	const VEC vGapOpen = V_SET1(params->gap_open);
+	const VEC vGapExt = V_SET1(params->gap_ext);
+	const VEC vMatch = V_SET1(params->match);
+	const VEC vMismatch = V_SET1(params->mismatch);
+	const VEC vFloor = V_SET1(floor);
+	const VEC vOne = V_SET1(1);
+	const VEC vMinusOne = V_SET1(-1);
+	const VEC vWidth = V_SET1(width);
+
+	VEC vH = V_LOADU(bufH);   // H[i][j-1]
+	VEC vE = V_LOADU(bufE);   // E[i][j-1]
+	VEC vF = V_SET1(0);       // F[i][j-1]
+	VEC vC0 = V_LOADU(bufC);  // seq0[i]
+	VEC vC1 = V_SET1(0);      // seq1[j]
+	VEC vUp = V_SHIFT(V_SET1(0), *diag); // H[i-1][j-1] of the next step
+	VEC vJ = V_LOADU(simd_lane_offsets); // j = t-k
+	VEC vBest = V_SET1(-INF);
+	VEC vBestJ = V_SET1(0);
+
+	const int steps = width + LANES - 1;
+	for (int t=0; t<steps; t++) {
+		int hIn = 0;
+		int fIn = 0;
+		int cIn = 0;
+		if (t < width) {
+			hIn = row[t].h;
+			fIn = row[t].f;
+			cIn = (unsigned char)seq1[t];
+		}
+
+		const VEC vDiag = vUp;
+		vUp = V_SHIFT(vH, hIn);
+		const VEC vUpF = V_SHIFT(vF, fIn);
+		vC1 = V_SHIFT(vC1, cIn);
+
+		const VEC e = V_SUB(V_MAX(V_SUB(vH, vGapOpen), vE), vGapExt); // Horizontal propagation
+		const VEC f = V_SUB(V_MAX(V_SUB(vUp, vGapOpen), vUpF), vGapExt); // Vertical propagation
+		const VEC s = V_BLEND(vMismatch, vMatch, V_CMPEQ(vC0, vC1));
+		const VEC h = V_MAX(V_MAX(V_ADD(vDiag, s), vFloor), V_MAX(e, f));
+
+		if (t >= LANES-1 && t < width) {
+			/* all the lanes are inside the block */
+			vH = h;
+			vE = e;
+			if (TRACK_BEST) {
+				const MASK gt = V_CMPGT(h, vBest);
+				vBest = V_BLEND(vBest, h, gt);
+				vBestJ = V_BLEND(vBestJ, vJ, gt);
+			}
+		} else {
+			/* prologue/epilogue: lanes outside the block keep their cells */
+			const MASK valid = V_MAND(V_CMPGT(vJ, vMinusOne), V_CMPGT(vWidth, vJ));
+			vH = V_BLEND(vH, h, valid);
+			vE = V_BLEND(vE, e, valid);
+			if (TRACK_BEST) {
+				const MASK gt = V_MAND(V_CMPGT(h, vBest), valid);
+				vBest = V_BLEND(vBest, h, gt);
+				vBestJ = V_BLEND(vBestJ, vJ, gt);
+			}
+		}
+		vF = f;
+		vJ = V_ADD(vJ, vOne);
+
+		/* The last lane produces the last row of the strip */
+		const int j = t - (LANES-1);
+		if (j >= 0) {
+			row[j].h = V_LAST(vH);
+			row[j].f = V_LAST(vF);
+		}
+	}
+
+	/* Store cells to the next right block */
+	V_STOREU(bufH, vH);
+	V_STOREU(bufE, vE);
+	*diag = col[r0+LANES].h;
+	for (int k=0; k<LANES; k++) {
+		col[r0+k+1].h = bufH[k];
+		col[r0+k+1].e = bufE[k];
+	}
+
+	if (!TRACK_BEST) {
+		return;
+	}
+
+	/* Merges the best score of each row, in ascending order */
+	int bestH[LANES];
+	int bestJ[LANES];
+	V_STOREU(bestH, vBest);
+	V_STOREU(bestJ, vBestJ);
+	for (int k=0; k<LANES; k++) {
+		if (best->score < bestH[k]) {
+			best->score = bestH[k];
+			best->i = i0+r0+k;
+			best->j = j0+bestJ[k];
+		}
+	}
+}
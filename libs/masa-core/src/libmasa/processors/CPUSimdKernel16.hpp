@@ -0,0 +1,227 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/*
+ * SIMD block kernel of the CPUBlockProcessor with 16-bit lanes.
+ *
+ * This file has no include guard, since it is included once for each
+ * instruction set by CPUBlockProcessor.cpp. It uses the same strip
+ * traversal of CPUSimdKernel.hpp and the same macros, except that the
+ * vector operations work on int16 lanes and V_ADD/V_SUB are saturating.
+ * It also requires V_MIN.
+ *
+ * The cells are stored relative to a per-block bias, chosen so the highest
+ * input cell plus the highest possible gain inside the block fits in the
+ * int16 range. Input cells below the range (e.g. -INF) are saturated to
+ * SIMD16_LOW. A saturated cell may only produce computed cells lower or
+ * equal to SIMD16_LOW+match, so, if no computed cell is in this range, all
+ * the cells are exact and the output is bit-identical to the 32-bit
+ * kernels. Otherwise the kernel returns false without touching the row/col
+ * vectors and the block must be recomputed with 32-bit lanes.
+ *
+ * The whole block is processed, so its height must be a multiple of LANES.
+ *
+ * @param[in,out]	row		the same vector of AbstractBlockProcessor::processBlock.
+ * @param[in,out]	col		the same vector of AbstractBlockProcessor::processBlock,
+ * 							except that col[0] is not updated.
+ * @param[in]		seq0	sequence 0 starting at row i0.
+ * @param[in]		seq1	sequence 1 starting at column j0.
+ * @param[in]		height	number of rows of the block.
+ * @param[in]		width	number of columns of the block.
+ * @param[in]		floor	0 for Smith-Waterman or INT_MIN for Needleman-Wunsch.
+ * @param[in]		params	match/mismatch scores and gap penalties.
+ * @param[in]		i0		first row of the block.
+ * @param[in]		j0		first column of the block.
+ * @param[in,out]	best	best score of the block.
+ * @return true if the block was processed, false if it must be promoted
+ * 			to 32 bits.
+ */
+static bool KERNEL_NAME(cell_t* row, cell_t* col, const char* seq0, const char* seq1,
+		const int height, const int width, const int floor,
+		const score_params_t* params, const int i0, const int j0, score_t* best) {
+	const int gain = MAX2(params->match, 0);
+	const int growth = ((width < height) ? width : height) * gain;
+	if (height == 0 || height % LANES != 0 || width < LANES || width > SIMD16_MAX_WIDTH
+			|| growth > SIMD16_MAX_GROWTH) {
+		return false;
+	}
+
+	/* The highest input cell (or the floor) is mapped to SIMD16_HIGH-growth */
+	int maxInput = (floor == INT_MIN) ? -INF : floor;
+	for (int j=0; j<width; j++) {
+		maxInput = MAX3(maxInput, row[j].h, row[j].f);
+	}
+	maxInput = MAX2(maxInput, col[0].h);
+	for (int i=1; i<=height; i++) {
+		maxInput = MAX3(maxInput, col[i].h, col[i].e);
+	}
+	const int bias = maxInput + growth - SIMD16_HIGH;
+
+	short* buffer = new short[2*width + 2*(height+1)];
+	short* rowH = buffer;
+	short* rowF = rowH + width;
+	short* colH = rowF + width;
+	short* colE = colH + height + 1;
+	for (int j=0; j<width; j++) {
+		rowH[j] = simd16_bias(row[j].h, bias);
+		rowF[j] = simd16_bias(row[j].f, bias);
+	}
+	for (int i=0; i<=height; i++) {
+		colH[i] = simd16_bias(col[i].h, bias);
+		colE[i] = simd16_bias(col[i].e, bias);
+	}
+
+	const VEC vGapOpen = V_SET1(params->gap_open);
+	const VEC vGapExt = V_SET1(params->gap_ext);
+	const VEC vMatch = V_SET1(params->match);
+	const VEC vMismatch = V_SET1(params->mismatch);
+	const VEC vFloor = V_SET1((floor == INT_MIN) ? SIMD16_LOW : simd16_bias(floor, bias));
+	const VEC vOne = V_SET1(1);
+	const VEC vMinusOne = V_SET1(-1);
+	const VEC vWidth = V_SET1(width);
+	const VEC vHigh = V_SET1(SIMD16_HIGH);
+	VEC vMin = vHigh; // lowest computed cell
+
+	score_t block_best = *best;
+	short diag = colH[0];
+	for (int r0=0; r0<height; r0+=LANES) {
+		short bufH[LANES];
+		short bufE[LANES];
+		short bufC[LANES];
+		for (int k=0; k<LANES; k++) {
+			bufH[k] = colH[r0+k+1];
+			bufE[k] = colE[r0+k+1];
+			bufC[k] = (unsigned char)seq0[r0+k];
+		}
+
+		VEC vH = V_LOADU(bufH);   // H[i][j-1]
+		VEC vE = V_LOADU(bufE);   // E[i][j-1]
+		VEC vF = V_SET1(0);       // F[i][j-1]
+		VEC vC0 = V_LOADU(bufC);  // seq0[i]
+		VEC vC1 = V_SET1(0);      // seq1[j]
+		VEC vUp = V_SHIFT(V_SET1(0), diag); // H[i-1][j-1] of the next step
+		VEC vJ = V_LOADU(simd16_lane_offsets); // j = t-k
+		VEC vBest = V_SET1(SIMD16_LOW);
+		VEC vBestJ = V_SET1(0);
+
+		const int steps = width + LANES - 1;
+		for (int t=0; t<steps; t++) {
+			short hIn = 0;
+			short fIn = 0;
+			short cIn = 0;
+			if (t < width) {
+				hIn = rowH[t];
+				fIn = rowF[t];
+				cIn = (unsigned char)seq1[t];
+			}
+
+			const VEC vDiag = vUp;
+			vUp = V_SHIFT(vH, hIn);
+			const VEC vUpF = V_SHIFT(vF, fIn);
+			vC1 = V_SHIFT(vC1, cIn);
+
+			const VEC e = V_SUB(V_MAX(V_SUB(vH, vGapOpen), vE), vGapExt); // Horizontal propagation
+			const VEC f = V_SUB(V_MAX(V_SUB(vUp, vGapOpen), vUpF), vGapExt); // Vertical propagation
+			const VEC s = V_BLEND(vMismatch, vMatch, V_CMPEQ(vC0, vC1));
+			const VEC h = V_MAX(V_MAX(V_ADD(vDiag, s), vFloor), V_MAX(e, f));
+			const VEC low = V_MIN(h, V_MIN(e, f));
+
+			if (t >= LANES-1 && t < width) {
+				/* all the lanes are inside the block */
+				vH = h;
+				vE = e;
+				vMin = V_MIN(vMin, low);
+				if (TRACK_BEST) {
+					const MASK gt = V_CMPGT(h, vBest);
+					vBest = V_BLEND(vBest, h, gt);
+					vBestJ = V_BLEND(vBestJ, vJ, gt);
+				}
+			} else {
+				/* prologue/epilogue: lanes outside the block keep their cells */
+				const MASK valid = V_MAND(V_CMPGT(vJ, vMinusOne), V_CMPGT(vWidth, vJ));
+				vH = V_BLEND(vH, h, valid);
+				vE = V_BLEND(vE, e, valid);
+				vMin = V_MIN(vMin, V_BLEND(vHigh, low, valid));
+				if (TRACK_BEST) {
+					const MASK gt = V_MAND(V_CMPGT(h, vBest), valid);
+					vBest = V_BLEND(vBest, h, gt);
+					vBestJ = V_BLEND(vBestJ, vJ, gt);
+				}
+			}
+			vF = f;
+			vJ = V_ADD(vJ, vOne);
+
+			/* The last lane produces the last row of the strip */
+			const int j = t - (LANES-1);
+			if (j >= 0) {
+				rowH[j] = V_LAST(vH);
+				rowF[j] = V_LAST(vF);
+			}
+		}
+
+		/* Store cells to the next strip */
+		V_STOREU(bufH, vH);
+		V_STOREU(bufE, vE);
+		diag = colH[r0+LANES];
+		for (int k=0; k<LANES; k++) {
+			colH[r0+k+1] = bufH[k];
+			colE[r0+k+1] = bufE[k];
+		}
+
+		if (TRACK_BEST) {
+			/* Merges the best score of each row, in ascending order */
+			short bestH[LANES];
+			short bestJ[LANES];
+			V_STOREU(bestH, vBest);
+			V_STOREU(bestJ, vBestJ);
+			for (int k=0; k<LANES; k++) {
+				if (block_best.score < bestH[k] + bias) {
+					block_best.score = bestH[k] + bias;
+					block_best.i = i0+r0+k;
+					block_best.j = j0+bestJ[k];
+				}
+			}
+		}
+	}
+
+	/* Any cell close to SIMD16_LOW may be saturated */
+	short lowest[LANES];
+	V_STOREU(lowest, vMin);
+	for (int k=0; k<LANES; k++) {
+		if (lowest[k] <= SIMD16_LOW + gain) {
+			delete[] buffer;
+			return false;
+		}
+	}
+
+	for (int j=0; j<width; j++) {
+		row[j].h = rowH[j] + bias;
+		row[j].f = rowF[j] + bias;
+	}
+	for (int i=1; i<=height; i++) {
+		col[i].h = colH[i] + bias;
+		col[i].e = colE[i] + bias;
+	}
+	*best = block_best;
+
+	delete[] buffer;
+	return true;
+}
@@ -34,6 +34,7 @@
 //#define LIM 5220960
 
 extern int BestGlobal;
+extern void raiseBestGlobal(int score);
 extern int jstart;
 extern int jend;
 extern FILE * dbabp;
@@ -144,7 +145,6 @@ bool AbstractBlockPruning::isBlockPrunableMulti(int bx, int by, int score, int d
         
 
 	int best;
-	pthread_mutex_t lock;
 
    	grid->getBlockPositionMulti(bx, by, &i0, &j0, &i1, &j1);
 	if (i0 == -1) {
@@ -183,27 +183,16 @@ bool AbstractBlockPruning::isBlockPrunableMulti(int bx, int by, int score, int d
 
 	best = bestScore;
 
-        if (SHARE && (diagonal%DIAG==0) && (BestGlobal < minvalue)) {
-  		pthread_mutexattr_t mutexattr;
-		pthread_mutexattr_init(&mutexattr);
-		pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE_NP);
-		pthread_mutex_init(&lock, &mutexattr);
-		pthread_mutex_lock(&lock);
-                //if (BestGlobal > LIM)
-                //    printf("\n best: %d ** bestScore: %d ** BestGlobal: %d ** diagonal: %d  ** max_i: %d max_j: %d ** bx:%d  by:%d ** i0:%d  j0:%d **  %d+%d<%d\n",  best, bestScore, BestGlobal, diagonal, max_i, max_j, bx, by, i0, j0, score,inc, best);
-		if (BestGlobal >= best) {
-			best = BestGlobal;
-                        // if (BestGlobal > LIM)
-                        //   printf("\n 1111 best: %d ** bestScore: %d ** BestGlobal: %d ** diagonal: %d  ** max_i: %d max_j: %d ** bx:%d  by:%d ** i0:%d  j0:%d **  %d+%d<%d\n",  best, bestScore, BestGlobal, diagonal, max_i, max_j, bx, by, i0, j0, score,inc, best);
-                }                        
-		else { 
-			BestGlobal = best;
-                        // if (BestGlobal > LIM)
-                        //   printf("\n 2222 best: %d ** bestScore: %d ** BestGlobal: %d ** diagonal: %d  ** max_i: %d max_j: %d ** bx:%d  by:%d ** i0:%d  j0:%d **  %d+%d<%d\n",  best, bestScore, BestGlobal, diagonal, max_i, max_j, bx, by, i0, j0, score,inc, best);
-                }
-		pthread_mutex_unlock(&lock);
+        /* The global best is read on every decision, so scores found by
+         * other partitions prune this one as soon as they arrive. */
+        int global = __atomic_load_n(&BestGlobal, __ATOMIC_RELAXED);
+        if (SHARE && (global < minvalue)) {
+		if (global >= best) {
+			best = global;
+		} else {
+			raiseBestGlobal(best);
+		}
                 updateBestScore(best);
-
         }
 
         int max = score + inc + adjustment;
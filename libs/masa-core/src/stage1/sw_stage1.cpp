@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <limits.h>
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -44,7 +45,6 @@ using namespace std;
 
 #define DEBUG	(0)
 #define DEBUGM   (0)
-#define SYNCTIME (5)
 //#define SHARE (0)
 
 /* Stores a list with the best score and some suboptimal scores */
@@ -56,6 +56,12 @@ static IAligner* aligner;
 /* The status file */
 static Status* status;
 
+/* Live throughput of a split execution, read by the controller to choose
+ * the split weights of the next iteration */
+static FILE* performanceLog = NULL;
+static long long performanceLastCells;
+static long long performanceLastPruned;
+
 /* The object where the special rows are saved */
 static SpecialRowsPartition* sraPartition = NULL;
 
@@ -77,8 +83,15 @@ extern FILE * dbdyn;
 //extern double pruningtime;
 
 Job * jobGlobal; 
-pthread_mutex_t lock;
-pthread_mutexattr_t mutexattr;
+
+/* Push channel of the global best score. The share thread sleeps on
+ * shareCond until BestGlobal reaches shareThreshold, i.e., the last
+ * dispatched score plus the configured margin. */
+static pthread_mutex_t shareMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t shareCond = PTHREAD_COND_INITIALIZER;
+static int shareThreshold = INT_MAX;
+static int shareMargin = 0;
+static bool shareFinish = false;
 
 /**
  * Decides if the initial best score should be zero or -INF.
@@ -143,6 +156,24 @@ static void logStatus(float t) {
 			hour, min, sec,
 			bestScore.i, bestScore.j, bestScore.score,
 			aligner->getProgressString());
+
+	if (performanceLog != NULL && t > 0) {
+		long long cells = aligner->getProcessedCells();
+		long long pruned = aligner->getPrunedCells();
+		/* The pruning of the last interval predicts the next iteration
+		 * better than the average, since the best diagonal moves. */
+		double fraction = 0;
+		if (cells > performanceLastCells) {
+			fraction = (double)(pruned - performanceLastPruned) / (cells - performanceLastCells);
+		} else if (cells > 0) {
+			fraction = (double)pruned / cells;
+		}
+		fprintf(performanceLog, "%.3f %lld %lld %.4e %.4f\n", t, cells, pruned,
+				(cells - pruned) / t, fraction);
+		fflush(performanceLog);
+		performanceLastCells = cells;
+		performanceLastPruned = pruned;
+	}
 }
 
 static void getBorderCells(Job* job, SpecialRowsPartition* sraPartition,
@@ -186,8 +217,9 @@ static void getBorderCells(Job* job, SpecialRowsPartition* sraPartition,
 	string shared_path = job->getSharedPath();
 
 	if (job->flush_column_url.size() > 0) {
-		CellsWriter* writer = new URLCellsWriter(job->flush_column_url, shared_path);
-		BufferedCellsWriter* tmp = new BufferedCellsWriter(writer, job->getBufferLimit());
+		URLCellsWriter* writer = new URLCellsWriter(job->flush_column_url, shared_path);
+		BufferedCellsWriter* tmp = new BufferedCellsWriter(writer, job->getBufferLimit(),
+				writer->getBatchSize(), writer->getFlushDeadline());
 		tmp->setLogFile(job->outputBufferLogFile, 10.0f);
 		lastColumn = tmp;
 	}
@@ -201,12 +233,12 @@ static void getBorderCells(Job* job, SpecialRowsPartition* sraPartition,
 
 		int id0 = job->getAlignmentParams()->getSequence(1)->getTrimStart()-1;
 
-		CellsReader* reader = new URLCellsReader(job->load_column_url, shared_path);
+		URLCellsReader* reader = new URLCellsReader(job->load_column_url, shared_path);
 		int limit = job->getBufferLimit();
 		if (job->getPoolWaitId() >= 0) {
 			limit = job->getSequence(0)->getLen();
 		}
-		BufferedCellsReader* tmp = new BufferedCellsReader(reader, limit);
+		BufferedCellsReader* tmp = new BufferedCellsReader(reader, limit, reader->getBatchSize());
 		tmp->setLogFile(job->inputBufferLogFile, 10.0f);
 		if (DEBUG) printf("Creating first column reader\n");
 		firstColumn = tmp;
@@ -279,35 +311,72 @@ void alignPartition(SpecialRowsPartition* sraPartition, int ev_prepare, int ev_i
 	}
 }
 
+/**
+ * Raises the global best score, read by the block pruning of every
+ * partition, and wakes the share thread if the improvement exceeds the
+ * margin of the last dispatched score.
+ */
+void raiseBestGlobal(int score) {
+	int global = __atomic_load_n(&BestGlobal, __ATOMIC_SEQ_CST);
+	while (score > global) {
+		if (__atomic_compare_exchange_n(&BestGlobal, &global, score, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+			break;
+		}
+	}
+	if (score >= __atomic_load_n(&shareThreshold, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&shareMutex);
+		pthread_cond_signal(&shareCond);
+		pthread_mutex_unlock(&shareMutex);
+	}
+}
+
+/**
+ * Dispatches the global best score to the neighbour nodes as soon as it
+ * improves more than the share margin.
+ */
 void * shareScore (void * x ) {
-   
-   int threadrec;
-
-   while (1) {
-      jobGlobal->getAlignerPool()->dispatchBestScore(BestGlobal);
-      threadrec = jobGlobal->getAlignerPool()->receiveBestScore();
-      //if (DEBUGM) fprintf (dbsta, "BestGlobal: %d *** threadrc: %d  \n", BestGlobal, threadrec);
-      pthread_mutex_lock(&lock);
-      if (threadrec >  BestGlobal)
-        BestGlobal = threadrec;
-      pthread_mutex_unlock(&lock);
-      //printf ("\n\n --- splitstep: %d - dynamic: %d \n", splitstep, dynamic);
-      if (dynamic != 0) {
-       if (splitstep % dynamic == 0)
-          jobGlobal->getAlignerPool()->dispatchBestScoreDyn(BestGlobal);
-       if (splitstep % dynamic == 1) { 
-      	threadrec = jobGlobal->getAlignerPool()->receiveBestScoreDyn();
-      	//if (DEBUGM) fprintf (dbsta, "BestGlobal: %d *** threadrc: %d  \n", BestGlobal, threadrec);
-      	pthread_mutex_lock(&lock);
-      	if (threadrec >  BestGlobal)
-             BestGlobal = threadrec;
-      	pthread_mutex_unlock(&lock);
-       }
-      }
-      
-     
-      sleep(SYNCTIME);
-   }
+	AlignerPool* pool = jobGlobal->getAlignerPool();
+
+	pthread_mutex_lock(&shareMutex);
+	while (!shareFinish) {
+		int score = __atomic_load_n(&BestGlobal, __ATOMIC_SEQ_CST);
+		if (score < shareThreshold) {
+			pthread_cond_wait(&shareCond, &shareMutex);
+			continue;
+		}
+		__atomic_store_n(&shareThreshold, score + shareMargin + 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&shareMutex);
+
+		if (!pool->isLastNode()) {
+			pool->dispatchBestScore(score);
+		}
+		//printf ("\n\n --- splitstep: %d - dynamic: %d \n", splitstep, dynamic);
+		if (dynamic != 0 && splitstep % dynamic == 0) {
+			pool->dispatchBestScoreDyn(score);
+		}
+
+		pthread_mutex_lock(&shareMutex);
+	}
+	pthread_mutex_unlock(&shareMutex);
+	return NULL;
+}
+
+/**
+ * Blocks on the incoming best scores of the neighbour node (or of the
+ * dynamic load balance peer, if x is not NULL) and merges them into the
+ * global best score.
+ */
+void * receiveScore (void * x ) {
+	AlignerPool* pool = jobGlobal->getAlignerPool();
+	bool dyn = (x != NULL);
+
+	while (1) {
+		int threadrec = dyn ? pool->receiveBestScoreDyn() : pool->receiveBestScore();
+		//if (DEBUGM) fprintf (dbsta, "BestGlobal: %d *** threadrc: %d  \n", BestGlobal, threadrec);
+		raiseBestGlobal(threadrec);
+	}
+	return NULL;
 }
 
 
@@ -348,13 +417,23 @@ int stage1(Job* job) {
 
     BestGlobal = 0;
     pthread_t thr;
-    pthread_mutexattr_init(&mutexattr);
-    pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE_NP);
-    pthread_mutex_init(&lock, &mutexattr);
-    if (SHARE) { 
-        if ((job->split) && (job->block_pruning)) {
-            jobGlobal = job;
-    	    pthread_create(&thr, NULL, shareScore, (void *) NULL);
+    pthread_t thr_recv;
+    pthread_t thr_recv_dyn;
+    bool sharing = SHARE && job->split && job->block_pruning && job->getAlignerPool() != NULL;
+    bool receiving = sharing && !job->getAlignerPool()->isFirstNode();
+    bool receiving_dyn = sharing && dynamic != 0 && splitstep % dynamic == 1;
+    if (sharing) {
+        jobGlobal = job;
+        shareMargin = job->configs->getScoreShareMargin();
+        shareFinish = false;
+        /* Dispatches the initial score too, as the neighbours expect. */
+        __atomic_store_n(&shareThreshold, 0, __ATOMIC_SEQ_CST);
+        pthread_create(&thr, NULL, shareScore, (void *) NULL);
+        if (receiving) {
+            pthread_create(&thr_recv, NULL, receiveScore, (void *) NULL);
+        }
+        if (receiving_dyn) {
+            pthread_create(&thr_recv_dyn, NULL, receiveScore, (void *) &dynamic);
         }
     }
 	Sequence* seq_vertical = new Sequence(job->getAlignmentParams()->getSequence(0));
@@ -362,6 +441,7 @@ int stage1(Job* job) {
 	aligner = job->aligner;
 	const score_params_t* score_params = aligner->getScoreParameters();
 	AlignerManager* sw = new AlignerManager(aligner);
+	SpecialRowsFlusher* flusher = NULL;
 	if (job->split == 1)
 		sw->setmustSplit(true);
 
@@ -408,6 +488,12 @@ int stage1(Job* job) {
 				special_lines_count * (seq1_len+1) * sizeof(cell_t));
 		fflush(stats);
 		sw->setSpecialRowInterval(flush_interval);
+
+		int flush_threads = job->configs->getSRAFlushThreads();
+		if (flush_threads > 0) {
+			flusher = new SpecialRowsFlusher(flush_threads, job->configs->getSRAFlushBuffer());
+			sw->setSpecialRowsFlusher(flusher);
+		}
 	} else {
 		sw->setSpecialRowInterval(0);
 	}
@@ -481,6 +567,14 @@ int stage1(Job* job) {
 			firstRow, firstColumn, lastRow,	lastColumn);
 
         lastit = 0;
+	if (job->split) {
+		performanceLog = fopen(job->performanceLogFile.c_str(), "wt");
+		if (performanceLog != NULL) {
+			fprintf(performanceLog, "# time cells pruned_cells computed_cells/s pruned_fraction\n");
+		}
+		performanceLastCells = 0;
+		performanceLastPruned = 0;
+	}
 	logger->start(2.0);
 	vector<SpecialRowsPartition*> sortedPartitions = sra->getSortedPartitions();
 	for(vector<SpecialRowsPartition*>::iterator it = sortedPartitions.begin(); it != sortedPartitions.end(); ++it) {
@@ -511,11 +605,29 @@ int stage1(Job* job) {
 		logger->logNow();
 	}
 	logger->stop();
+	sra->saveIndex();
 	delete logger;
+	if (performanceLog != NULL) {
+		fclose(performanceLog);
+		performanceLog = NULL;
+	}
 
-         if ((SHARE) && (dynamic != 0))
-            if ((job->split) && (job->block_pruning))
-                pthread_cancel(thr);
+    if (sharing) {
+        pthread_mutex_lock(&shareMutex);
+        shareFinish = true;
+        __atomic_store_n(&shareThreshold, INT_MAX, __ATOMIC_SEQ_CST);
+        pthread_cond_signal(&shareCond);
+        pthread_mutex_unlock(&shareMutex);
+        pthread_join(thr, NULL);
+        if (receiving) {
+            pthread_cancel(thr_recv);
+            pthread_join(thr_recv, NULL);
+        }
+        if (receiving_dyn) {
+            pthread_cancel(thr_recv_dyn);
+            pthread_join(thr_recv_dyn, NULL);
+        }
+    }
 
     if (DEBUGM) {
        fflush(dbabp);
@@ -571,6 +683,18 @@ int stage1(Job* job) {
 
 
 	aligner->printStatistics(stats);
+	if (diff > 0) {
+		/* The planner prices the recomputation of the next stages, so it
+		 * needs the rate of the computed cells: the pruned blocks would
+		 * overstate it. */
+		long long computed_cells = aligner->getProcessedCells() - aligner->getPrunedCells();
+		job->saveStage1Measurements(computed_cells/(diff/1000.0),
+				flusher != NULL ? flusher->getWriteBandwidth() : 0);
+	}
+	if (flusher != NULL) {
+		flusher->printStatistics(stats);
+		delete flusher;
+	}
 	delete sw;
 	delete seq_vertical;
 	delete seq_horizontal;
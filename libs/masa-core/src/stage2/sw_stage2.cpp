@@ -29,6 +29,7 @@
 #include "../common/Common.hpp"
 #include "../common/io/InitialCellsReader.hpp"
 #include "../common/io/ReversedCellsReader.hpp"
+#include "../common/sra/SpecialRowReadAhead.hpp"
 
 #define DEBUG (0)
 
@@ -335,6 +336,7 @@ crosspoint_t stage2(Job* job, int id) {
 		//int max_rows = seq0_len-crosspoint.i;
 		int max_rows = seq0_len;
 		
+		job->planFlushIntervals(crosspoint_r.i, crosspoint_r.j, stats);
 		int flush_interval = job->getFlushInterval(1);
 
 		sw->setSpecialRowInterval(flush_interval);
@@ -361,6 +363,12 @@ crosspoint_t stage2(Job* job, int id) {
 
 	bool check_block_results =  (job->alignment_start == AT_ANYWHERE);
 
+	/* The special rows of stage 1 are read in background while each
+	 * partition is aligned. */
+	int readAheadCells = job->configs->getSRAReadAhead()/sizeof(cell_t);
+	double readAheadWait = 0;
+	long long readAheadCount = 0;
+
 	CrosspointsFile* crosspoints = new CrosspointsFile(job->getCrosspointFile(STAGE_2, id));
 	crosspoints->setAutoSave();
 	crosspoints->write(crosspoint.i, crosspoint.j, crosspoint.score, crosspoint.type);
@@ -418,7 +426,13 @@ crosspoint_t stage2(Job* job, int id) {
 			if (DEBUG) fprintf(stdout, ">> %d %d %d\n", crosspoint_r.i, crosspoint_r.j, crosspoint.score);
 
 			SpecialRow* row = sraPartitionStage1->nextSpecialRow(crosspoint_r.i, crosspoint_r.j, 128); // TODO verificar esse mínimo
-			sw->setLastColumnReader(row);
+			SpecialRowReadAhead* readAhead = NULL;
+			if (row != NULL && readAheadCells > 0 && dynamic_cast<SpecialRowRAM*>(row) == NULL) {
+				readAhead = new SpecialRowReadAhead(row, readAheadCells);
+				sw->setLastColumnReader(readAhead);
+			} else {
+				sw->setLastColumnReader(row);
+			}
 			if (DEBUG) printf("LastColumnReader: %p\n", row);
 
 			if (colReader != NULL) {
@@ -439,6 +453,13 @@ crosspoint_t stage2(Job* job, int id) {
 
 			crosspoint = find_next_crosspoint(sw, crosspoint, crosspoint1, job->alignment_start);
 			crosspoints->write(crosspoint);
+			if (readAhead != NULL) {
+				readAhead->close();
+				readAheadWait += readAhead->getWaitTime();
+				readAheadCount += readAhead->getReadCells();
+				delete readAhead;
+				sw->setLastColumnReader(NULL);
+			}
 			if (crosspoint.type != TYPE_MATCH) {
 				crosspoint.score += score_params->gap_open;
 			}
@@ -484,6 +505,7 @@ crosspoint_t stage2(Job* job, int id) {
 
     timer.eventRecord(ev_end);
     crosspoints->close();
+    sraStage2->saveIndex();
 
 //	if (job->getAlignerPool() != NULL) {
 //		if (crosspoint_r.type != TYPE_MATCH) {
@@ -504,6 +526,17 @@ crosspoint_t stage2(Job* job, int id) {
 	fprintf(stats, "        Cells: %.4e\n", (double)aligner->getProcessedCells());
 	fprintf(stats, "        MCUPS: %.4f\n", aligner->getProcessedCells()/1000000.0f/(diff/1000.0f));
 	fprintf(stats, "Millions Cells Updates: %.3f\n", aligner->getProcessedCells()/1000000.0f);
+	if (job->getPredictedCells(1) > 0) {
+		fprintf(stats, "    Predicted: %.4e cells (%.4f s)  actual: %.4e cells (%.4f s)\n",
+				job->getPredictedCells(1), job->getPredictedTime(1),
+				(double)aligner->getProcessedCells(), diff/1000.0);
+	}
+
+	if (readAheadCount > 0) {
+		fprintf(stats, "Special rows read-ahead:\n");
+		fprintf(stats, "     Cells: %lld\n", readAheadCount);
+		fprintf(stats, "  Blocked time: %.4f s\n", readAheadWait);
+	}
 
 	//aligner->finalize();
 	aligner->printStatistics(stats);
@@ -26,6 +26,11 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <pthread.h>
+
+#include <vector>
+#include <algorithm>
+using namespace std;
 
 #include "../common/Common.hpp"
 #include "../common/io/InitialCellsReader.hpp"
@@ -36,15 +41,51 @@
 /* The object where the SRA partitions of stage 3 are saved */
 static SpecialRowsArea* sraStage3;
 
-/* The partition from where the special rows will be read. Initially, this
- * partition is from stage 2, but then it is updated in the next iteratios.  */
-static SpecialRowsPartition* sraPrevPartition;
-
-
 static AlignerManager* sw;
 static IAligner* aligner;
 static const score_params_t* score_params;
 
+/* Managers of the worker aligners. If empty, the partitions are processed
+ * sequentially by the sw manager. */
+static vector<AlignerManager*> workers;
+static vector<IAligner*> workerAligners;
+
+/* Serializes the changes made by the workers in the stage 3 SRA */
+static pthread_mutex_t sraMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Partition between two consecutive crosspoints of the previous step. The
+ * crosspoints found inside the partition are stored in the task and they
+ * are written in order when all the partitions are processed.
+ */
+struct stage3_task_t {
+	crosspoint_t crosspoint0;
+	crosspoint_t crosspoint1;
+	/* The partition from where the special rows will be read. Initially,
+	 * this partition is from stage 2, but then it is updated in the next
+	 * iterations. NULL if the partition must not be processed. */
+	SpecialRowsPartition* prevPartition;
+	long long area;
+	vector<crosspoint_t> crosspoints;
+};
+
+/**
+ * Work queue of the partitions, sorted from the largest to the smallest.
+ */
+struct stage3_queue_t {
+	vector<stage3_task_t*> tasks;
+	int next;
+	int seq0_len;
+	int seq1_len;
+	int reverse;
+	pthread_mutex_t mutex;
+};
+
+struct stage3_worker_arg_t {
+	stage3_queue_t* queue;
+	AlignerManager* sw;
+};
+
 
 static crosspoint_t find_next_crosspoint (AlignerManager* sw, const crosspoint_t crosspoint0, const crosspoint_t crosspoint1, const bool mustFindCrosspoint) {
 
@@ -65,7 +106,9 @@ static crosspoint_t find_next_crosspoint (AlignerManager* sw, const crosspoint_t
 
 	SpecialRowsPartition* sraPartitionStage3 = NULL;
 	if (sraStage3 != NULL) {
+		pthread_mutex_lock(&sraMutex);
 		sraPartitionStage3 = sraStage3->createPartition(i0r, j0r, i1r, j1r);
+		pthread_mutex_unlock(&sraMutex);
 	}
 	sraPartitionStage3->setFirstColumnReader(firstColumn);
 	sraPartitionStage3->setFirstRowReader(firstRow);
@@ -108,7 +151,9 @@ static crosspoint_t find_next_crosspoint (AlignerManager* sw, const crosspoint_t
 		}
 		next_crosspoint = sw->getNextCrosspoint();
 		if (sraPartitionStage3 != NULL) {
+			pthread_mutex_lock(&sraMutex);
 			sraStage3->truncatePartition(sraPartitionStage3, next_crosspoint.i, next_crosspoint.j);
+			pthread_mutex_unlock(&sraMutex);
 		}
 	} else {
 		next_crosspoint = crosspoint1;
@@ -118,9 +163,10 @@ static crosspoint_t find_next_crosspoint (AlignerManager* sw, const crosspoint_t
 }
 
 
-void processPartition(crosspoint_t crosspoint0, crosspoint_t crosspoint1,
+void processPartition(AlignerManager* sw, SpecialRowsPartition* sraPrevPartition,
+		crosspoint_t crosspoint0, crosspoint_t crosspoint1,
 		int seq0_len, int seq1_len, int reverse,
-		CrosspointsFile*& crosspoints) {
+		vector<crosspoint_t>& crosspoints) {
 
 	// If we don't need to save more rows, so we do not need to process the last partition (last row)
 	bool processLastRow = (sraStage3 != NULL);
@@ -202,9 +248,75 @@ void processPartition(crosspoint_t crosspoint0, crosspoint_t crosspoint1,
 	    crosspoint_t tmp = crosspoint;
 	    tmp.score = goal_adj;
 
-	    //crosspoints->push_back(tmp);
-		crosspoints->write(tmp.i, tmp.j, tmp.score, tmp.type);
+	    crosspoints.push_back(tmp);
+	}
+}
+
+static bool larger_task(const stage3_task_t* a, const stage3_task_t* b) {
+	return a->area > b->area;
+}
+
+static void process_tasks(stage3_queue_t* queue, AlignerManager* sw) {
+	while (true) {
+		pthread_mutex_lock(&queue->mutex);
+		size_t k = queue->next++;
+		pthread_mutex_unlock(&queue->mutex);
+		if (k >= queue->tasks.size()) {
+			break;
+		}
+		stage3_task_t* task = queue->tasks[k];
+		processPartition(sw, task->prevPartition, task->crosspoint0, task->crosspoint1,
+				queue->seq0_len, queue->seq1_len, queue->reverse, task->crosspoints);
+	}
+}
+
+static void* stage3_worker_thread(void* arg) {
+	stage3_worker_arg_t* worker = (stage3_worker_arg_t*)arg;
+	process_tasks(worker->queue, worker->sw);
+	return NULL;
+}
+
+/*
+ * Processes the partitions of the queue with the workers, or sequentially
+ * if there is no worker.
+ */
+static void run_tasks(stage3_queue_t* queue) {
+	if (workers.size() == 0) {
+		process_tasks(queue, sw);
+		return;
+	}
+	int count = workers.size();
+	pthread_t* threads = new pthread_t[count];
+	stage3_worker_arg_t* args = new stage3_worker_arg_t[count];
+	for (int k = 0; k < count; k++) {
+		args[k].queue = queue;
+		args[k].sw = workers[k];
+		int rc = pthread_create(&threads[k], NULL, stage3_worker_thread, (void*)&args[k]);
+		if (rc) {
+			fprintf(stderr, "Stage3: pthread_create() returned %d\n", rc);
+			exit(1);
+		}
+	}
+	for (int k = 0; k < count; k++) {
+		pthread_join(threads[k], NULL);
 	}
+	delete[] threads;
+	delete[] args;
+}
+
+static void set_special_row_interval(int interval) {
+	sw->setSpecialRowInterval(interval);
+	for (size_t k = 0; k < workers.size(); k++) {
+		workers[k]->setSpecialRowInterval(interval);
+	}
+}
+
+static long long get_processed_cells() {
+	long long cells = aligner->getProcessedCells();
+	for (size_t k = 0; k < workerAligners.size(); k++) {
+		cells += workerAligners[k]->getProcessedCells();
+	}
+	return cells;
 }
 
 int reduce_partitions(CrosspointsFile*& crosspointsPrev, CrosspointsFile*& crosspoints,
@@ -215,9 +327,24 @@ int reduce_partitions(CrosspointsFile*& crosspointsPrev, CrosspointsFile*& cross
 	crosspoint_t m1 = crosspointsPrev->back();
 	crosspoint_t m0 = crosspointsPrev->front();
 	// FIXME we need to respect the maximum partition size capability of the aligner!
-	sw->setSequences(seq_vertical, seq_horizontal, m0.i, m0.j, m1.i, m1.j, stats);
+	if (workers.size() == 0) {
+		sw->setSequences(seq_vertical, seq_horizontal, m0.i, m0.j, m1.i, m1.j, stats);
+	}
+	for (size_t k = 0; k < workers.size(); k++) {
+		workers[k]->setSequences(seq_vertical, seq_horizontal, m0.i, m0.j, m1.i, m1.j, k == 0 ? stats : NULL);
+	}
 	//printf("*********************** %p, %p, %d,%d, %d, %d", seq_vertical->getData(), seq_horizontal->getData(), m0.i, m0.j, m1.i, m1.j);
 
+	/* The partitions are independent, so they are all collected before
+	 * being processed by the workers. */
+	vector<stage3_task_t*> partitions;
+	stage3_queue_t queue;
+	queue.next = 0;
+	queue.seq0_len = seq0_len;
+	queue.seq1_len = seq1_len;
+	queue.reverse = reverse;
+	pthread_mutex_init(&queue.mutex, NULL);
+
 	crosspoint_t crosspoint0;
 	crosspoint_t crosspoint1;
 	int partition_id = 0;
@@ -227,20 +354,25 @@ int reduce_partitions(CrosspointsFile*& crosspointsPrev, CrosspointsFile*& cross
 		crosspoint0 = crosspoint1;
 		crosspoint1 = crosspointsPrev->at(partition_id);
 
-		//crosspoints->push_back(crosspoint0);
-		crosspoints->write(crosspoint0.i, crosspoint0.j, crosspoint0.score,	crosspoint0.type);
+		stage3_task_t* task = new stage3_task_t();
+		task->crosspoint0 = crosspoint0;
+		task->crosspoint1 = crosspoint1;
+		task->prevPartition = NULL;
+		task->area = ((long long)abs(crosspoint1.i-crosspoint0.i))*abs(crosspoint1.j-crosspoint0.j);
+		partitions.push_back(task);
 
 		crosspoint_t crosspoint0r = crosspoint1.reverse(seq0_len, seq1_len);
 		crosspoint_t crosspoint1r = crosspoint0.reverse(seq0_len, seq1_len);
 
 		printf("(%d,%d)-(%d,%d)\n", crosspoint0r.i, crosspoint0r.j, crosspoint1r.i, crosspoint1r.j);
 		if (crosspoint0r.i != crosspoint1r.i && crosspoint0r.j != crosspoint1r.j) {
-			sraPrevPartition = sraPrev->openPartition(crosspoint0r.i, crosspoint0r.j, crosspoint1r.i, crosspoint1r.j);
+			SpecialRowsPartition* sraPrevPartition = sraPrev->openPartition(crosspoint0r.i, crosspoint0r.j, crosspoint1r.i, crosspoint1r.j);
 			//sraPrevPartition->setFirstRow(score_params, true);
 			//sw->setLastColumnReader(sraPrevPartition);
 			if (sraPrevPartition->getRowsCount() > 1) { // 1 = fixed constant first row (rowId = 0).
 				// We have special rows in this partition
-				processPartition(crosspoint0, crosspoint1, seq0_len, seq1_len, reverse, crosspoints);
+				task->prevPartition = sraPrevPartition;
+				queue.tasks.push_back(task);
 			} else {
 				// We do not have special rows in this partition
 				if (sraStage3 != NULL) {
@@ -252,11 +384,29 @@ int reduce_partitions(CrosspointsFile*& crosspointsPrev, CrosspointsFile*& cross
 			if (DEBUG) printf("ignoring full-gap partition (%d,%d)-(%d,%d)\n", crosspoint0r.i, crosspoint0r.j, crosspoint1r.i, crosspoint1r.j);
 		}
 	}
+
+	stable_sort(queue.tasks.begin(), queue.tasks.end(), larger_task);
+	run_tasks(&queue);
+	pthread_mutex_destroy(&queue.mutex);
+
+	for (size_t k = 0; k < partitions.size(); k++) {
+		stage3_task_t* task = partitions[k];
+		crosspoints->write(task->crosspoint0);
+		for (size_t c = 0; c < task->crosspoints.size(); c++) {
+			crosspoints->write(task->crosspoints[c]);
+		}
+		delete task;
+	}
 	crosspoints->write(crosspoint1.i, crosspoint1.j, crosspoint1.score, crosspoint1.type);
 	crosspoints->close();
 	if (DEBUG) printf("********** %d %d ********\n", crosspointsPrev->size(), crosspoints->size());
 
-	sw->unsetSequences();
+	if (workers.size() == 0) {
+		sw->unsetSequences();
+	}
+	for (size_t k = 0; k < workers.size(); k++) {
+		workers[k]->unsetSequences();
+	}
 
 	return crosspoints->size();
 }
@@ -310,6 +460,31 @@ void stage3(Job* job, int id) {
 	sw->setBlockPruning(false);
 	aligner->clearStatistics();
 
+	int workersCount = job->configs->getWorkers(STAGE_3);
+	for (int k = 0; k < workersCount && workersCount > 1; k++) {
+		IAligner* worker = aligner->getWorker(k, workersCount);
+		if (worker == NULL) {
+			fprintf(stderr, "Stage3: the aligner does not support workers. Using a single aligner.\n");
+			break;
+		}
+		worker->initialize();
+		worker->clearStatistics();
+		AlignerManager* manager = new AlignerManager(worker);
+		manager->setRecurrenceType(NEEDLEMAN_WUNSCH);
+		manager->setBlockPruning(false);
+		workers.push_back(manager);
+		workerAligners.push_back(worker);
+	}
+	if ((int)workers.size() != workersCount) {
+		for (size_t k = 0; k < workers.size(); k++) {
+			workerAligners[k]->finalize();
+			delete workers[k];
+		}
+		workers.clear();
+		workerAligners.clear();
+	}
+	fprintf(stats, "Workers: %d\n", workers.size() > 0 ? (int)workers.size() : 1);
+
 
 
 	CrosspointsFile* crosspoints = NULL;
@@ -327,6 +502,7 @@ void stage3(Job* job, int id) {
 	int min_interval = 1024;
 	bool saveSRA = true;
 	float step_sum = 0;
+	job->replanFlushIntervals(stats);
 
     // TODO calcular com melhor precisao?
 	int max_deep = 15;
@@ -356,10 +532,10 @@ void stage3(Job* job, int id) {
 			//sraStage3 = new SpecialRowsArea(job->getSpecialRowsPath(STAGE_3, id, deep), 12345678);
 			sraStage3 = job->getSpecialRowsArea(STAGE_3, id, deep);
 	    	if (flushInterval < min_interval) {
-	    		sw->setSpecialRowInterval(min_interval);
+	    		set_special_row_interval(min_interval);
 	    		saveSRA = false;
 	    	} else {
-	    		sw->setSpecialRowInterval(flushInterval);
+	    		set_special_row_interval(flushInterval);
 	    	}
 			if (!saveSRA) {
 				sraStage3->setPersistentPartitions(false);
@@ -367,6 +543,7 @@ void stage3(Job* job, int id) {
 			}
 
 	    	reduce_partitions(crosspointsPrev, crosspoints, seq_vertical, seq_horizontal, sraPrev, reverse, stats);
+	    	sraStage3->saveIndex();
 
 			fprintf(stderr, "Stage3: Crosspoints: %d/%d  Rows: %d/%d %s\n",
 					crosspointsPrev->size(), crosspoints->size(),
@@ -434,13 +611,31 @@ void stage3(Job* job, int id) {
 	float diff = timer.printStatistics(stats);
 	
 	fprintf(stats, "        Total: %.4f\n", diff);
-	fprintf(stats, "        Cells: %.4e\n", (double)aligner->getProcessedCells());
-	fprintf(stats, "        MCUPS: %.4f\n", aligner->getProcessedCells()/1000000.0f/(diff/1000.0f));
-	fprintf(stats, "Millions Cells Updates: %.3f\n", aligner->getProcessedCells() / 1000000.0f);
+	fprintf(stats, "        Cells: %.4e\n", (double)get_processed_cells());
+	double predicted = 0;
+	double predictedTime = 0;
+	for (int step=2; step<=deep+1; step++) {
+		predicted += job->getPredictedCells(step);
+		predictedTime += job->getPredictedTime(step);
+	}
+	if (predicted > 0) {
+		fprintf(stats, "    Predicted: %.4e cells (%.4f s)  actual: %.4e cells (%.4f s)\n",
+				predicted, predictedTime, (double)get_processed_cells(), diff/1000.0);
+	}
+	fprintf(stats, "        MCUPS: %.4f\n", get_processed_cells()/1000000.0f/(diff/1000.0f));
+	fprintf(stats, "Millions Cells Updates: %.3f\n", get_processed_cells() / 1000000.0f);
 	fprintf(stats, " Final VmSize: %d KB\n", getMasaProcessVmSize()/1024);
 	
 	//aligner->finalize();
 	aligner->printStatistics(stats);
+	for (size_t k = 0; k < workers.size(); k++) {
+		fprintf(stats, "Worker %d:\n", (int)k);
+		workerAligners[k]->printStatistics(stats);
+		workerAligners[k]->finalize();
+		delete workers[k];
+	}
+	workers.clear();
+	workerAligners.clear();
 	delete crosspoints;
 
 	delete seq_horizontal;
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/*
+ * SIMD strip kernel of the stage 4 split sweeps.
+ *
+ * This file has no include guard, since it is included once for each
+ * instruction set by SplitSimdKernels.hpp. Before the inclusion, the following
+ * macros must be defined:
+ *
+ * KERNEL_NAME      name of the generated function.
+ * LANES            number of int32 lanes of the vector.
+ * VEC, MASK        vector type and comparison mask type.
+ * V_SET1(x)        broadcasts x to all the lanes.
+ * V_LOADU(p)       loads LANES ints from p (unaligned).
+ * V_STOREU(p,v)    stores LANES ints to p (unaligned).
+ * V_ADD, V_SUB, V_MAX    lane-wise int32 operations.
+ * V_CMPGT, V_CMPEQ       lane-wise comparisons returning a MASK.
+ * V_MAND(m0,m1)    intersection of two masks.
+ * V_BLEND(a,b,m)   selects b where m is set, otherwise a.
+ * V_SHIFT(v,x)     moves lane k to lane k+1 and inserts x in lane 0.
+ * V_LAST(v)        extracts the last lane.
+ *
+ * The kernel computes LANES consecutive rows of the Myers-Miller half
+ * matrices, replacing LANES iterations of the scalar row loop of split()
+ * or LANES calls of processCol(). Lane k computes row k of the strip and it
+ * is delayed by k columns from lane 0, so the H and E cells of the row
+ * above are received from the previous lane with V_SHIFT. The arithmetic
+ * is done in 32 bits, exactly as the scalar loops, so the output is
+ * bit-identical to them.
+ *
+ * @param[in,out]	h		H cells of the row above the strip, in h[j*stride].
+ * 							Output: H cells of the last row of the strip.
+ * @param[in,out]	e		vertical gap cells, with the same layout of h.
+ * @param[in]		stride	distance (in ints) between two consecutive cells.
+ * @param[in]		width	number of cells of the rows.
+ * @param[in]		s0		char of row k is s0[k*s0_step].
+ * @param[in]		s1		char of column j is s1[j*s1_step].
+ * @param[in]		col0	H cell before the first column of row k is
+ * 							col0+k*col0_step.
+ * @param[in]		diag	H cell before the first column of the row above.
+ * @param[in]		scores	match/mismatch scores and gap penalties.
+ * @param[out]		last	if not NULL, the H and F cells of the last column
+ * 							of each row of the strip.
+ */
+static void KERNEL_NAME(int* h, int* e, const int stride, const int width,
+		const char* s0, const int s0_step, const char* s1, const int s1_step,
+		const int col0, const int col0_step, const int diag,
+		const split_scores_t* scores, cell_t* last) {
+	int bufH[LANES];
+	int bufF[LANES];
+	int bufC[LANES];
+	for (int k=0; k<LANES; k++) {
+		bufH[k] = col0 + k*col0_step;
+		bufC[k] = (unsigned char)s0[k*s0_step];
+	}
+
+	const VEC vGapFirst = V_SET1(scores->gap_first);
+	const VEC vGapExt = V_SET1(scores->gap_ext);
+	const VEC vMatch = V_SET1(scores->match);
+	const VEC vMismatch = V_SET1(scores->mismatch);
+	const VEC vOne = V_SET1(1);
+	const VEC vMinusOne = V_SET1(-1);
+	const VEC vWidth = V_SET1(width);
+
+	VEC vH = V_LOADU(bufH);   // H[i][j-1]
+	VEC vF = V_SET1(-INF);    // F[i][j-1]
+	VEC vE = V_SET1(-INF);    // E[i][j] of the previous step
+	VEC vC0 = V_LOADU(bufC);  // s0[i]
+	VEC vC1 = V_SET1(0);      // s1[j]
+	VEC vUp = V_SHIFT(V_SET1(0), diag); // H[i-1][j-1] of the next step
+	VEC vJ = V_LOADU(split_lane_offsets); // j = t-k
+
+	const int steps = width + LANES - 1;
+	for (int t=0; t<steps; t++) {
+		int hIn = 0;
+		int eIn = 0;
+		int cIn = 0;
+		if (t < width) {
+			hIn = h[t*stride];
+			eIn = e[t*stride];
+			cIn = (unsigned char)s1[t*s1_step];
+		}
+
+		const VEC vDiag = vUp;
+		vUp = V_SHIFT(vH, hIn);
+		const VEC vUpE = V_SHIFT(vE, eIn);
+		vC1 = V_SHIFT(vC1, cIn);
+
+		const VEC ee = V_MAX(V_SUB(vUp, vGapFirst), V_SUB(vUpE, vGapExt));
+		const VEC ff = V_MAX(V_SUB(vH, vGapFirst), V_SUB(vF, vGapExt));
+		const VEC s = V_BLEND(vMismatch, vMatch, V_CMPEQ(vC0, vC1));
+		const VEC hh = V_MAX(V_ADD(vDiag, s), V_MAX(ee, ff));
+
+		if (t >= LANES-1 && t < width) {
+			/* all the lanes are inside the rows */
+			vH = hh;
+			vF = ff;
+		} else {
+			/* prologue/epilogue: lanes outside the rows keep their cells */
+			const MASK valid = V_MAND(V_CMPGT(vJ, vMinusOne), V_CMPGT(vWidth, vJ));
+			vH = V_BLEND(vH, hh, valid);
+			vF = V_BLEND(vF, ff, valid);
+		}
+		vE = ee;
+		vJ = V_ADD(vJ, vOne);
+
+		/* The last lane produces the last row of the strip */
+		const int j = t - (LANES-1);
+		if (j >= 0) {
+			h[j*stride] = V_LAST(vH);
+			e[j*stride] = V_LAST(vE);
+		}
+	}
+
+	if (last != NULL) {
+		V_STOREU(bufH, vH);
+		V_STOREU(bufF, vF);
+		for (int k=0; k<LANES; k++) {
+			last[k].h = bufH[k];
+			last[k].f = bufF[k];
+		}
+	}
+}
@@ -0,0 +1,182 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/*
+ * Instantiations of the stage 4 strip kernel (SplitSimdKernel.hpp) for
+ * SSE4.1, AVX2 and AVX-512. The cell_t type and the INF constant must be
+ * defined before the inclusion.
+ */
+
+#ifndef SPLITSIMDKERNELS_HPP_
+#define SPLITSIMDKERNELS_HPP_
+
+/* Scores used by the SIMD strip kernels */
+typedef struct {
+	int match;
+	int mismatch;
+	int gap_first;
+	int gap_ext;
+} split_scores_t;
+
+/* Strip kernel (see SplitSimdKernel.hpp) */
+typedef void (*split_strip_t)(int* h, int* e, const int stride, const int width,
+		const char* s0, const int s0_step, const char* s1, const int s1_step,
+		const int col0, const int col0_step, const int diag,
+		const split_scores_t* scores, cell_t* last);
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_KERNELS (1)
+#include <immintrin.h>
+#else
+#define SIMD_KERNELS (0)
+#endif
+
+#if SIMD_KERNELS
+
+/* Initial column (t-k) of each lane of the SIMD kernels */
+static const int split_lane_offsets[16] = {0, -1, -2, -3, -4, -5, -6, -7,
+		-8, -9, -10, -11, -12, -13, -14, -15};
+
+/*
+ * SSE4.1 kernel: 4 lanes of 32 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#define LANES				(4)
+#define VEC					__m128i
+#define MASK				__m128i
+#define V_SET1(x)			_mm_set1_epi32(x)
+#define V_LOADU(p)			_mm_loadu_si128((const __m128i*)(p))
+#define V_STOREU(p,v)		_mm_storeu_si128((__m128i*)(p), (v))
+#define V_ADD(a,b)			_mm_add_epi32((a), (b))
+#define V_SUB(a,b)			_mm_sub_epi32((a), (b))
+#define V_MAX(a,b)			_mm_max_epi32((a), (b))
+#define V_CMPGT(a,b)		_mm_cmpgt_epi32((a), (b))
+#define V_CMPEQ(a,b)		_mm_cmpeq_epi32((a), (b))
+#define V_MAND(m0,m1)		_mm_and_si128((m0), (m1))
+#define V_BLEND(a,b,m)		_mm_blendv_epi8((a), (b), (m))
+#define V_SHIFT(v,x)		_mm_insert_epi32(_mm_slli_si128((v), 4), (x), 0)
+#define V_LAST(v)			_mm_extract_epi32((v), 3)
+#define KERNEL_NAME			split_strip_sse41
+#include "SplitSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+/*
+ * AVX2 kernel: 8 lanes of 32 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define LANES				(8)
+#define VEC					__m256i
+#define MASK				__m256i
+#define V_SET1(x)			_mm256_set1_epi32(x)
+#define V_LOADU(p)			_mm256_loadu_si256((const __m256i*)(p))
+#define V_STOREU(p,v)		_mm256_storeu_si256((__m256i*)(p), (v))
+#define V_ADD(a,b)			_mm256_add_epi32((a), (b))
+#define V_SUB(a,b)			_mm256_sub_epi32((a), (b))
+#define V_MAX(a,b)			_mm256_max_epi32((a), (b))
+#define V_CMPGT(a,b)		_mm256_cmpgt_epi32((a), (b))
+#define V_CMPEQ(a,b)		_mm256_cmpeq_epi32((a), (b))
+#define V_MAND(m0,m1)		_mm256_and_si256((m0), (m1))
+#define V_BLEND(a,b,m)		_mm256_blendv_epi8((a), (b), (m))
+#define V_SHIFT(v,x)		_mm256_blend_epi32(_mm256_permutevar8x32_epi32((v), \
+								_mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6)), _mm256_set1_epi32(x), 1)
+#define V_LAST(v)			_mm256_extract_epi32((v), 7)
+#define KERNEL_NAME			split_strip_avx2
+#include "SplitSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+/*
+ * AVX-512 kernel: 16 lanes of 32 bits.
+ */
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define LANES				(16)
+#define VEC					__m512i
+#define MASK				__mmask16
+#define V_SET1(x)			_mm512_set1_epi32(x)
+#define V_LOADU(p)			_mm512_loadu_si512((const void*)(p))
+#define V_STOREU(p,v)		_mm512_storeu_si512((void*)(p), (v))
+#define V_ADD(a,b)			_mm512_add_epi32((a), (b))
+#define V_SUB(a,b)			_mm512_sub_epi32((a), (b))
+#define V_MAX(a,b)			_mm512_max_epi32((a), (b))
+#define V_CMPGT(a,b)		_mm512_cmpgt_epi32_mask((a), (b))
+#define V_CMPEQ(a,b)		_mm512_cmpeq_epi32_mask((a), (b))
+#define V_MAND(m0,m1)		((MASK)((m0) & (m1)))
+#define V_BLEND(a,b,m)		_mm512_mask_blend_epi32((m), (a), (b))
+#define V_SHIFT(v,x)		_mm512_mask_set1_epi32(_mm512_permutexvar_epi32( \
+								_mm512_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14), (v)), 1, (x))
+#define V_LAST(v)			_mm_extract_epi32(_mm512_extracti32x4_epi32((v), 3), 3)
+#define KERNEL_NAME			split_strip_avx512
+#include "SplitSimdKernel.hpp"
+#undef KERNEL_NAME
+#undef LANES
+#undef VEC
+#undef MASK
+#undef V_SET1
+#undef V_LOADU
+#undef V_STOREU
+#undef V_ADD
+#undef V_SUB
+#undef V_MAX
+#undef V_CMPGT
+#undef V_CMPEQ
+#undef V_MAND
+#undef V_BLEND
+#undef V_SHIFT
+#undef V_LAST
+#pragma GCC pop_options
+
+#endif
+
+#endif /* SPLITSIMDKERNELS_HPP_ */
@@ -0,0 +1,253 @@
+/*******************************************************************************
+ *
+ * Copyright (c) 2010-2015   Edans Sandes
+ *
+ * This file is part of MASA-Core.
+ * 
+ * MASA-Core is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * MASA-Core is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with MASA-Core.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ******************************************************************************/
+
+/*
+ * Standalone check and benchmark of the stage 4 strip kernels. Each kernel
+ * supported by the running processor is compared with a scalar strip over
+ * random inputs and then timed against it. It is not part of the library:
+ *
+ *   g++ -O3 -o split_simd_check src/stage4/split_simd_check.cpp
+ *   ./split_simd_check [width] [repetitions]
+ *
+ * The exit status is 1 if some kernel differs from the scalar strip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../common/macros.hpp"
+#include "../libmasa/libmasaTypes.hpp"
+#include "SplitSimdKernels.hpp"
+
+/*
+ * Scalar strip with the same interface of the kernels: computes rows
+ * consecutive rows, one at a time, as the scalar loops of split().
+ */
+static void split_strip_scalar(int rows, int* h, int* e, const int stride, const int width,
+		const char* s0, const int s0_step, const char* s1, const int s1_step,
+		const int col0, const int col0_step, const int diag,
+		const split_scores_t* scores, cell_t* last) {
+	for (int k=0; k<rows; k++) {
+		int c0 = (unsigned char)s0[k*s0_step];
+		int left = col0 + k*col0_step;  // H[i][j-1]
+		int f = -INF;                   // F[i][j-1]
+		int up_left = (k == 0) ? diag : col0 + (k-1)*col0_step; // H[i-1][j-1]
+		for (int j=0; j<width; j++) {
+			int up = h[j*stride];
+			int ee = MAX(up - scores->gap_first, e[j*stride] - scores->gap_ext);
+			int ff = MAX(left - scores->gap_first, f - scores->gap_ext);
+			int s = (c0 == (unsigned char)s1[j*s1_step]) ? scores->match : scores->mismatch;
+			int hh = MAX(up_left + s, MAX(ee, ff));
+			up_left = up;
+			h[j*stride] = hh;
+			e[j*stride] = ee;
+			left = hh;
+			f = ff;
+		}
+		if (last != NULL) {
+			last[k].h = left;
+			last[k].f = f;
+		}
+	}
+}
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec/1000000.0;
+}
+
+static void random_bases(char* s, int len) {
+	static const char bases[] = "ACGT";
+	for (int k=0; k<len; k++) {
+		s[k] = bases[rand()%4];
+	}
+}
+
+typedef struct {
+	const char* name;
+	int lanes;
+	split_strip_t strip;
+	bool supported;
+} kernel_t;
+
+/*
+ * Runs the kernel and the scalar strip over the same random strip.
+ * Returns true if the outputs are identical.
+ */
+static bool check(const kernel_t* kernel, int width, int stride, bool reverse, const split_scores_t* scores) {
+	const int lanes = kernel->lanes;
+	int* h0 = new int[width*stride];
+	int* e0 = new int[width*stride];
+	int* h1 = new int[width*stride];
+	int* e1 = new int[width*stride];
+	char* s0 = new char[lanes];
+	char* s1 = new char[width];
+	cell_t last0[16];
+	cell_t last1[16];
+
+	for (int j=0; j<width*stride; j++) {
+		h0[j] = h1[j] = rand()%1000 - 500;
+		e0[j] = e1[j] = (rand()%8 == 0) ? -INF : rand()%1000 - 500;
+	}
+	random_bases(s0, lanes);
+	random_bases(s1, width);
+	int col0 = rand()%1000 - 500;
+	int col0_step = -(rand()%4);
+	int diag = rand()%1000 - 500;
+
+	/* reversed sequences are read backwards from their last char */
+	const char* p0 = reverse ? s0+lanes-1 : s0;
+	const char* p1 = reverse ? s1+width-1 : s1;
+	int step0 = reverse ? -1 : 1;
+	int step1 = reverse ? -1 : 1;
+
+	split_strip_scalar(lanes, h0, e0, stride, width, p0, step0, p1, step1,
+			col0, col0_step, diag, scores, last0);
+	kernel->strip(h1, e1, stride, width, p0, step0, p1, step1,
+			col0, col0_step, diag, scores, last1);
+
+	bool ok = true;
+	for (int j=0; j<width && ok; j++) {
+		if (h0[j*stride] != h1[j*stride] || e0[j*stride] != e1[j*stride]) {
+			fprintf(stderr, "%s: width %d stride %d reverse %d: cell %d differs (h: %d/%d, e: %d/%d)\n",
+					kernel->name, width, stride, reverse, j,
+					h0[j*stride], h1[j*stride], e0[j*stride], e1[j*stride]);
+			ok = false;
+		}
+	}
+	for (int k=0; k<lanes && ok; k++) {
+		if (last0[k].h != last1[k].h || last0[k].f != last1[k].f) {
+			fprintf(stderr, "%s: width %d stride %d reverse %d: last cell of row %d differs\n",
+					kernel->name, width, stride, reverse, k);
+			ok = false;
+		}
+	}
+
+	delete[] h0;
+	delete[] e0;
+	delete[] h1;
+	delete[] e1;
+	delete[] s0;
+	delete[] s1;
+	return ok;
+}
+
+/*
+ * Times rows*width cells with the kernel (or the scalar strip if kernel
+ * is NULL). Returns the rate in millions of cells per second.
+ */
+static double bench(const kernel_t* kernel, int lanes, int width, int repetitions, const split_scores_t* scores) {
+	int* h = new int[width];
+	int* e = new int[width];
+	char* s0 = new char[lanes*repetitions];
+	char* s1 = new char[width];
+	for (int j=0; j<width; j++) {
+		h[j] = -j;
+		e[j] = -INF;
+	}
+	random_bases(s0, lanes*repetitions);
+	random_bases(s1, width);
+
+	double start = now();
+	for (int r=0; r<repetitions; r++) {
+		if (kernel == NULL) {
+			split_strip_scalar(lanes, h, e, 1, width, s0+r*lanes, 1, s1, 1,
+					-r*lanes, -1, -r*lanes+1, scores, NULL);
+		} else {
+			kernel->strip(h, e, 1, width, s0+r*lanes, 1, s1, 1,
+					-r*lanes, -1, -r*lanes+1, scores, NULL);
+		}
+	}
+	double elapsed = now() - start;
+
+	delete[] h;
+	delete[] e;
+	delete[] s0;
+	delete[] s1;
+	return elapsed > 0 ? ((double)lanes)*width*repetitions/elapsed/1000000.0 : 0;
+}
+
+int main(int argc, char** argv) {
+	int width = (argc > 1) ? atoi(argv[1]) : 100000;
+	int repetitions = (argc > 2) ? atoi(argv[2]) : 200;
+	if (width < 1 || repetitions < 1) {
+		fprintf(stderr, "Usage: %s [width] [repetitions]\n", argv[0]);
+		return 2;
+	}
+
+#if SIMD_KERNELS
+	__builtin_cpu_init();
+	const kernel_t kernels[] = {
+		{"sse4.1", 4, split_strip_sse41, __builtin_cpu_supports("sse4.1") != 0},
+		{"avx2", 8, split_strip_avx2, __builtin_cpu_supports("avx2") != 0},
+		{"avx-512", 16, split_strip_avx512, __builtin_cpu_supports("avx512f") != 0},
+	};
+	const int count = sizeof(kernels)/sizeof(kernels[0]);
+#else
+	const kernel_t* kernels = NULL;
+	const int count = 0;
+#endif
+
+	split_scores_t scores;
+	scores.match = 1;
+	scores.mismatch = -3;
+	scores.gap_ext = 2;
+	scores.gap_first = 2+3;
+
+	srand(1);
+	bool ok = true;
+	for (int k=0; k<count; k++) {
+		const kernel_t* kernel = &kernels[k];
+		if (!kernel->supported) {
+			printf("%-8s not supported by this processor\n", kernel->name);
+			continue;
+		}
+		int tests = 0;
+		int failed = 0;
+		for (int w=1; w<=3*kernel->lanes; w++) {
+			for (int stride=1; stride<=2; stride++) {
+				for (int reverse=0; reverse<=1; reverse++) {
+					tests++;
+					failed += !check(kernel, w, stride, reverse, &scores);
+				}
+			}
+		}
+		for (int t=0; t<200; t++) {
+			tests++;
+			failed += !check(kernel, 1 + rand()%5000, 1 + rand()%2, rand()%2, &scores);
+		}
+		double scalar = bench(NULL, kernel->lanes, width, repetitions, &scores);
+		double simd = bench(kernel, kernel->lanes, width, repetitions, &scores);
+		printf("%-8s %d lanes: %d/%d checks ok, scalar %.1f MCUPS, simd %.1f MCUPS (%.2fx)\n",
+				kernel->name, kernel->lanes, tests-failed, tests, scalar, simd,
+				scalar > 0 ? simd/scalar : 0);
+		if (failed > 0) {
+			ok = false;
+		}
+	}
+	if (count == 0) {
+		printf("No SIMD kernels in this build\n");
+	}
+	return ok ? 0 : 1;
+}
@@ -36,8 +36,6 @@
 
 #define H_MAX (2*64*1024)
 
-#define NUM_THREADS 4
-
 #define DEBUG (0)
 
 /*#define dna_match       (1)
@@ -52,10 +50,45 @@ static int dna_gap_ext;
 static int dna_match;
 static int dna_mismatch;
 
+#include "SplitSimdKernels.hpp"
+
+static split_scores_t split_scores;
+/* Strip kernel of the running processor, or NULL for the scalar loops */
+static split_strip_t split_strip = NULL;
+static int split_lanes = 1;
+
+/*
+ * Selects the strip kernel based on the CPUID flags of the running processor.
+ */
+static void select_split_kernel() {
+	split_scores.match = dna_match;
+	split_scores.mismatch = dna_mismatch;
+	split_scores.gap_first = dna_gap_first;
+	split_scores.gap_ext = dna_gap_ext;
+	split_strip = NULL;
+	split_lanes = 1;
+#if SIMD_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		split_strip = split_strip_avx512;
+		split_lanes = 16;
+	} else if (__builtin_cpu_supports("avx2")) {
+		split_strip = split_strip_avx2;
+		split_lanes = 8;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		split_strip = split_strip_sse41;
+		split_lanes = 4;
+	}
+#endif
+}
+
+struct stage4_pool_t;
+
 typedef struct {
-    int partition0;
-    int partition1;
+    int id;
+    stage4_pool_t* pool;
 
+    /* scratch buffers, reused by all the steps */
     int h0[H_MAX];
     int e0[H_MAX];
 
@@ -67,11 +100,43 @@ typedef struct {
     cell_t c0[H_MAX];
     cell_t c1[H_MAX];
 
+    /* statistics */
+    Timer timer;
+    int ev_wait;
+    int ev_busy;
+    float busy_time;
+    int partitions;
+    int chunks;
+} split_args_t;
+
+/**
+ * Persistent pool of stage 4 threads. At each step, the threads take
+ * chunks of consecutive partitions from a shared counter, so that the
+ * partitions are balanced dynamically among the threads.
+ */
+struct stage4_pool_t {
     Job* job;
+    int count;
+    pthread_t* threads;
+    split_args_t** args;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    int generation;
+    int running;
+    bool finish;
+
+    /* current step */
     const CrosspointsFile* crosspoints;
-    /* OUT */
     crosspoint_t *out_pos;
-} split_args_t;
+    int next;
+    float last_percent;
+    Timer timer;
+    int ev_idle;
+    int ev_step;
+    float step_time;
+};
 
 static crosspoint_t split(Sequence *seq0, Sequence *seq1, int i0, int j0, int i1, int j1, 
 						int type_s, int type_e, int score_s, int score_e,
@@ -84,32 +149,28 @@ static crosspoint_t ort_split_2(Sequence *seq0, Sequence *seq1, int i0, int j0,
 						int type_s, int type_e, int score_s, int score_e,
 						int *h0, int *h1, int *e0, int *e1, cell_t *r0, cell_t *r1, cell_t *c0, cell_t *c1);
 
-static void *split_thread(void *thread_arg) {
+/*
+ * Splits the partitions between the crosspoints k0-1 and k1-1, storing
+ * each new crosspoint k in out_pos[k] (type -1 if the partition is not
+ * split).
+ */
+static void split_partitions(split_args_t* args, int k0, int k1) {
     static int inv_type[] = {0,2,1};
 
-    split_args_t* args = (split_args_t*)thread_arg;
-
-    Job* job = args->job;
-    const CrosspointsFile* crosspoints = args->crosspoints;
+    Job* job = args->pool->job;
+    const CrosspointsFile* crosspoints = args->pool->crosspoints;
+    crosspoint_t* out_pos = args->pool->out_pos;
 	Sequence* seq0 = job->getAlignmentParams()->getSequence(0);
 	Sequence* seq1 = job->getAlignmentParams()->getSequence(1);
 
     int i0, j0, i1, j1, type0, type1, score0, score1;
 
-    int partition_id = args->partition0;
-    i0 = crosspoints->at(partition_id).i;
-    j0 = crosspoints->at(partition_id).j;
-    type0 = crosspoints->at(partition_id).type;
-	score0 = crosspoints->at(partition_id).score;
-
-    float last_percent = 0;
-    for (int k=args->partition0+1; k<=args->partition1; k++) {
-        float percent = 100.0f*(k-args->partition0)/(args->partition1-args->partition0);
-        if (percent > last_percent+25) {
-            printf("Split: %5.1f (%6d/%6d)\n", percent , k, crosspoints->size());
-            last_percent = percent;
-        }
-        partition_id++;
+    i0 = crosspoints->at(k0-1).i;
+    j0 = crosspoints->at(k0-1).j;
+    type0 = crosspoints->at(k0-1).type;
+	score0 = crosspoints->at(k0-1).score;
+
+    for (int k=k0; k<k1; k++) {
         i1 = crosspoints->at(k).i;
         j1 = crosspoints->at(k).j;
         type1 = crosspoints->at(k).type;
@@ -122,16 +183,16 @@ static void *split_thread(void *thread_arg) {
 //        if (delta_i == 0) {
 //        	if (j0 < j1-job->stage4_maximum_partition_size) {
 //        		int len = delta_j/2;
-//        		args->out_pos[k].i = i1;
-//        		args->out_pos[k].j = j0+len;
-//        		args->out_pos[k].type = TYPE_GAP_1;
-//        		args->out_pos[k].score = score0 -len*dna_gap_ext - dna_gap_open*(score0!=TYPE_GAP_1);
+//        		out_pos[k].i = i1;
+//        		out_pos[k].j = j0+len;
+//        		out_pos[k].type = TYPE_GAP_1;
+//        		out_pos[k].score = score0 -len*dna_gap_ext - dna_gap_open*(score0!=TYPE_GAP_1);
 //        	} else {
-//                args->out_pos[k].type = -1;
+//                out_pos[k].type = -1;
 //        	}
 //        } else
         if (delta_i == 0 || delta_j == 0) {
-            args->out_pos[k].type = -1;
+            out_pos[k].type = -1;
         } else if (inverse) {
 			if (j0 < j1-job->stage4_maximum_partition_size) {
 				crosspoint_t out_tmp;
@@ -164,12 +225,12 @@ static void *split_thread(void *thread_arg) {
 						out_tmp.i, out_tmp.j, out_tmp.type, out_tmp.score,
 						out_tmp2.i, out_tmp2.j, out_tmp2.type, out_tmp2.score);
 				}*/
-				args->out_pos[k].i = out_tmp.j;
-                args->out_pos[k].j = out_tmp.i;
-                args->out_pos[k].type = inv_type[out_tmp.type];
-                args->out_pos[k].score = out_tmp.score;
+				out_pos[k].i = out_tmp.j;
+                out_pos[k].j = out_tmp.i;
+                out_pos[k].type = inv_type[out_tmp.type];
+                out_pos[k].score = out_tmp.score;
             } else {
-                args->out_pos[k].type = -1;
+                out_pos[k].type = -1;
             }
         } else {
 			if (i0 < i1-job->stage4_maximum_partition_size) {
@@ -204,19 +265,84 @@ static void *split_thread(void *thread_arg) {
 						out_tmp2.i, out_tmp2.j, out_tmp2.type, out_tmp2.score);
 				}*/
 										 
-				args->out_pos[k] = out_tmp;
+				out_pos[k] = out_tmp;
             } else {
-                args->out_pos[k].type = -1;
+                out_pos[k].type = -1;
             }
         }
 
-		//printf("%d,%d,%d,%d\n", args->out_pos[k].type, args->out_pos[k].i, args->out_pos[k].j, args->out_pos[k].score);
+		//printf("%d,%d,%d,%d\n", out_pos[k].type, out_pos[k].i, out_pos[k].j, out_pos[k].score);
 
         type0 = type1;
 		score0 = score1;
         i0 = i1;
         j0 = j1;
     }
+}
+
+/*
+ * Takes the next chunk [k0..k1) of partitions. The chunks get smaller
+ * as the step advances, so that the last partitions are spread among
+ * all the threads.
+ */
+static bool next_chunk(stage4_pool_t* pool, int* k0, int* k1) {
+    pthread_mutex_lock(&pool->mutex);
+    int size = pool->crosspoints->size();
+    int remaining = size - pool->next;
+    if (remaining <= 0) {
+        pthread_mutex_unlock(&pool->mutex);
+        return false;
+    }
+    int chunk = remaining/(2*pool->count);
+    if (chunk < 1) {
+        chunk = 1;
+    }
+    *k0 = pool->next;
+    *k1 = pool->next + chunk;
+    pool->next = *k1;
+
+    float percent = 100.0f*(*k1-1)/(size-1);
+    if (percent > pool->last_percent+25) {
+        printf("Split: %5.1f (%6d/%6d)\n", percent , *k1-1, size);
+        pool->last_percent = percent;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return true;
+}
+
+static void *split_thread(void *thread_arg) {
+    split_args_t* args = (split_args_t*)thread_arg;
+    stage4_pool_t* pool = args->pool;
+
+    int generation = 0;
+    while (true) {
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->finish && pool->generation == generation) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->finish) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        args->timer.eventRecord(args->ev_wait);
+        int k0, k1;
+        while (next_chunk(pool, &k0, &k1)) {
+            split_partitions(args, k0, k1);
+            args->partitions += k1-k0;
+            args->chunks++;
+        }
+        args->busy_time += args->timer.eventRecord(args->ev_busy);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->running--;
+        if (pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
 
     pthread_exit(NULL);
     return NULL;
@@ -233,6 +359,70 @@ static void create_split_thread(split_args_t* args, pthread_t* pthread) {
     }
 }
 
+static stage4_pool_t* create_pool(Job* job, int count) {
+    stage4_pool_t* pool = new stage4_pool_t();
+    pool->job = job;
+    pool->count = count;
+    pool->threads = new pthread_t[count];
+    pool->args = new split_args_t*[count];
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->generation = 0;
+    pool->running = 0;
+    pool->finish = false;
+    pool->crosspoints = NULL;
+    pool->out_pos = NULL;
+    pool->ev_idle = pool->timer.createEvent("IDLE");
+    pool->ev_step = pool->timer.createEvent("STEP");
+    pool->step_time = 0;
+
+    for (int i=0; i<count; i++) {
+        split_args_t* args = new split_args_t();
+        args->id = i;
+        args->pool = pool;
+        args->ev_wait = args->timer.createEvent("WAIT");
+        args->ev_busy = args->timer.createEvent("BUSY");
+        args->busy_time = 0;
+        args->partitions = 0;
+        args->chunks = 0;
+        pool->args[i] = args;
+        create_split_thread(args, &pool->threads[i]);
+    }
+    return pool;
+}
+
+static void destroy_pool(stage4_pool_t* pool, FILE* stats) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->finish = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i=0; i<pool->count; i++) {
+        int rc = pthread_join(pool->threads[i], NULL);
+        if (rc) {
+            printf("ERROR; return code from pthread_join() is %d\n", rc);
+            exit(-1);
+        }
+    }
+
+    fprintf(stats, "Threads: %d  (steps time: %.4f)\n", pool->count, pool->step_time);
+    for (int i=0; i<pool->count; i++) {
+        split_args_t* args = pool->args[i];
+        float utilization = pool->step_time > 0 ? 100.0f*args->busy_time/pool->step_time : 0;
+        fprintf(stats, "Thread %2d: partitions: %8d  chunks: %6d  busy: %12.4f  utilization: %5.1f%%\n",
+                i, args->partitions, args->chunks, args->busy_time, utilization);
+        delete args;
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+    delete[] pool->args;
+    delete[] pool->threads;
+    delete pool;
+}
+
 void processBlock(const char* s0, const char* s1, cell_t *row, cell_t *col,
 		const int i0, const int j0, const int i1, const int j1,
 		const int type_s) {
@@ -351,33 +541,54 @@ static crosspoint_t ort_split_2(Sequence *seq0, Sequence *seq1, int i0, int j0,
 
 	int d0 = (type_s!=TYPE_MATCH)?-INF:0;
 	int d1 = (type_e!=TYPE_MATCH)?-INF:0;
-	for (int j=0; j<seq1_len; j++) {
-		int h0 = -(j+1)*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_1);
-		cell_t rr0 = processCol(s0, s1[j], d0, h0, c0, imid0);
-		d0 = h0;
-
-		int h1 = -(j+1)*dna_gap_ext - dna_gap_open;//*(type_e!=TYPE_GAP_1);
-		cell_t rr1 = processCol(s0r, s1r[j], d1, h1, c1, imid1);
-		d1 = h1;
-
-		if (j+1<=jmid1) {
-			r0[j+1] = rr0;
-			r1[j+1] = rr1;
+	cell_t last0[16];
+	cell_t last1[16];
+	for (int j=0; j<seq1_len; ) {
+		int count = 1;
+		if (split_strip != NULL && j+split_lanes <= seq1_len) {
+			/* computes the next split_lanes columns with the strip kernel */
+			count = split_lanes;
+			int h0 = -(j+1)*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_1);
+			split_strip(&c0[0].h, &c0[0].e, 2, imid0, &s1[j], 1, s0, 1,
+					h0, -dna_gap_ext, d0, &split_scores, last0);
+			d0 = h0 - (count-1)*dna_gap_ext;
+
+			int h1 = -(j+1)*dna_gap_ext - dna_gap_open;//*(type_e!=TYPE_GAP_1);
+			split_strip(&c1[0].h, &c1[0].e, 2, imid1, &s1r[j], 1, s0r, 1,
+					h1, -dna_gap_ext, d1, &split_scores, last1);
+			d1 = h1 - (count-1)*dna_gap_ext;
+		} else {
+			int h0 = -(j+1)*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_1);
+			last0[0] = processCol(s0, s1[j], d0, h0, c0, imid0);
+			d0 = h0;
+
+			int h1 = -(j+1)*dna_gap_ext - dna_gap_open;//*(type_e!=TYPE_GAP_1);
+			last1[0] = processCol(s0r, s1r[j], d1, h1, c1, imid1);
+			d1 = h1;
 		}
-		if (DEBUG) printf("%d: %d %d  (%d %d) (%d %d)\n", j, rr0.h, rr1.h, imid0, imid1, jmid0, jmid1);
-
-		if (j+1>=jmid1) {
-			if (match(rr0, r1[seq1_len-(j+1)], diff, &cross)) {
-				cross.j = j0+(j+1);
-				cross.i = imid0+i0;
-				cross.score += score_s;
-				return cross;
+		for (int k=0; k<count; k++, j++) {
+			cell_t rr0 = last0[k];
+			cell_t rr1 = last1[k];
+
+			if (j+1<=jmid1) {
+				r0[j+1] = rr0;
+				r1[j+1] = rr1;
 			}
-			if (match(r0[seq1_len-(j+1)], rr1, diff, &cross)) {
-				cross.j = j0+(seq1_len-(j+1));
-				cross.i = imid0+i0;
-				cross.score += score_s;
-				return cross;
+			if (DEBUG) printf("%d: %d %d  (%d %d) (%d %d)\n", j, rr0.h, rr1.h, imid0, imid1, jmid0, jmid1);
+
+			if (j+1>=jmid1) {
+				if (match(rr0, r1[seq1_len-(j+1)], diff, &cross)) {
+					cross.j = j0+(j+1);
+					cross.i = imid0+i0;
+					cross.score += score_s;
+					return cross;
+				}
+				if (match(r0[seq1_len-(j+1)], rr1, diff, &cross)) {
+					cross.j = j0+(seq1_len-(j+1));
+					cross.i = imid0+i0;
+					cross.score += score_s;
+					return cross;
+				}
 			}
 		}
 	}
@@ -677,7 +888,16 @@ static crosspoint_t split(Sequence *seq0, Sequence *seq1, int i0, int j0, int i1
     h0[0] = (type_s!=TYPE_MATCH)?-INF:0;
     e0[0] = (type_s!=TYPE_GAP_2)?-INF:0;
 
-    for (int i=1; i<=mid0; i++) {
+    int i = 1;
+    if (split_strip != NULL) {
+        for (; i+split_lanes-1<=mid0; i+=split_lanes) {
+            int col0 = -i*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_2);
+            split_strip(&h0[1], &e0[1], 1, seq1_len, &s0[i], 1, &s1[1], 1,
+                    col0, -dna_gap_ext, h0[0], &split_scores, NULL);
+            h0[0] = e0[0] = col0 - (split_lanes-1)*dna_gap_ext;
+        }
+    }
+    for (; i<=mid0; i++) {
         int h_tmp = h0[0];
         int h_next;
         h_next = h0[0] = e0[0] = -i*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_2);
@@ -711,7 +931,16 @@ static crosspoint_t split(Sequence *seq0, Sequence *seq1, int i0, int j0, int i1
     h1[0] = (type_e!=TYPE_MATCH)?-INF:0;
     e1[0] = (type_e!=TYPE_GAP_2)?-INF:0;
 
-    for (int i=1; i<=mid1; i++) {
+    i = 1;
+    if (split_strip != NULL) {
+        for (; i+split_lanes-1<=mid1; i+=split_lanes) {
+            int col0 = -i*dna_gap_ext - dna_gap_open*(type_e!=TYPE_GAP_2);
+            split_strip(&h1[1], &e1[1], 1, seq1_len, &s0[-(i-1)], -1, &s1[0], -1,
+                    col0, -dna_gap_ext, h1[0], &split_scores, NULL);
+            h1[0] = e1[0] = col0 - (split_lanes-1)*dna_gap_ext;
+        }
+    }
+    for (; i<=mid1; i++) {
         int h_tmp = h1[0];
         int h_next;
         h_next = h1[0] = e1[0] = -i*dna_gap_ext - dna_gap_open*(type_e!=TYPE_GAP_2);
@@ -810,49 +1039,24 @@ int merge_partitions(CrosspointsFile* crosspoints, crosspoint_t *new_positions)
     return has_new_pos;
 }
 
-static int reduce_partitions(Job* job, CrosspointsFile* crosspoints) {
-    /*int i0, j0, i1, j1, start_type, prev_type, prev_score;
-
-    int partition_id = 0;
-    i1 = job->crosspoints[partition_id].i;
-    j1 = job->crosspoints[partition_id].j;
-    prev_type = job->crosspoints[partition_id].type;
-    prev_score = job->crosspoints[partition_id].score;*/
-
-    static pthread_t thread[NUM_THREADS];
-    static split_args_t args[NUM_THREADS];
+static int reduce_partitions(stage4_pool_t* pool, CrosspointsFile* crosspoints) {
     crosspoint_t *new_partitions = (crosspoint_t *)malloc(crosspoints->size()*sizeof(crosspoint_t));
 
-    int num_threads = NUM_THREADS;
-    if (num_threads >= crosspoints->size()-1) {
-    	num_threads = crosspoints->size()-1;
-    }
-
-    for (int i=0; i<num_threads; i++) {
-        args[i].job = job;
-        args[i].crosspoints = crosspoints;
-        args[i].out_pos = new_partitions;
-        args[i].partition1 = (crosspoints->size()-1)*(i+1)/num_threads;
-        if (i==0) {
-            args[0].partition0 = 0;
-        } else {
-            args[i].partition0 = args[i-1].partition1;
-        }
-        printf("Thread %d [%d..%d] (%d)\n", i, args[i].partition0, args[i].partition1, crosspoints->size());
+    pthread_mutex_lock(&pool->mutex);
+    pool->crosspoints = crosspoints;
+    pool->out_pos = new_partitions;
+    pool->next = 1;
+    pool->last_percent = 0;
+    pool->running = pool->count;
+    pool->generation++;
+    pool->timer.eventRecord(pool->ev_idle);
+    pthread_cond_broadcast(&pool->start);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
     }
-    //args[num_threads-1].partition1 = crosspoints->size()-1;
+    pool->step_time += pool->timer.eventRecord(pool->ev_step);
+    pthread_mutex_unlock(&pool->mutex);
 
-    for (int i=0; i<num_threads; i++) {
-        //printf("%d: %d-%d  (%d)\n", i, args[i].partition0, args[i].partition1, job->partitions_count);
-        create_split_thread(&args[i], &thread[i]);
-    }
-    for (int i=0; i<num_threads; i++) {
-        int rc = pthread_join(thread[i], NULL);
-        if (rc) {
-            printf("ERROR; return code from pthread_join() is %d\n", rc);
-            exit(-1);
-        }
-    }
     int has_new_partitions = merge_partitions(crosspoints, new_partitions);
     free(new_partitions);
     return has_new_partitions;
@@ -902,9 +1106,18 @@ void stage4(Job* job, int id) {
 	dna_match    = job->getAlignmentParams()->getMatch();
 	dna_mismatch = job->getAlignmentParams()->getMismatch();
 	dna_gap_first = dna_gap_ext + dna_gap_open;
+	select_split_kernel();
 	
 	fprintf(stats, "MAXIMUM PARTITION SIZE: %d\n", job->stage4_maximum_partition_size);
 	fprintf(stats, "ORTHOGONAL EXECUTION: %s\n", job->stage4_orthogonal_execution?"YES":"NO");
+
+	int threads = job->configs->getWorkers(STAGE_4);
+	if (threads < 1) {
+		threads = 1;
+	}
+	fprintf(stats, "THREADS: %d\n", threads);
+	fprintf(stats, "SIMD LANES: %d\n", split_lanes);
+	stage4_pool_t* pool = create_pool(job, threads);
 	
 	Timer timer2;
 	
@@ -937,7 +1150,7 @@ void stage4(Job* job, int id) {
 					0, max_i, max_j, crosspoints_count, 0.0f, 0.0f);
 			fflush(stats);
 		}
-		if (!reduce_partitions(job, crosspoints)) {
+		if (!reduce_partitions(pool, crosspoints)) {
 			fprintf(stderr, "Didn't reduce partition.\n");
             // TODO tratar erro? não houve redução!
             break;
@@ -955,6 +1168,7 @@ void stage4(Job* job, int id) {
 	fprintf(stats, "-step %2d  max size: %5dx%5d crosspoints: %8d   time: %.4f   sum:%.4f\n", 
 			step, max_i, max_j, crosspoints->size(), step_diff, step_sum);
 	fflush(stats);
+	destroy_pool(pool, stats);
 	timer2.eventRecord(ev_start);
 	
     crosspoints->save();
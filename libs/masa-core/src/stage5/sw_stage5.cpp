@@ -24,28 +24,57 @@
 #include <unistd.h>
 #include <string.h>
 
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
-#include "../common/Common.hpp"
-
-#define H_MAX (1*1024)
-#define W_MAX (1*1024)
-
-static int h[W_MAX][H_MAX];
-static int e[W_MAX][H_MAX];
-static int f[W_MAX][H_MAX];
-
+#include <vector>
+using namespace std;
 
+#include "../common/Common.hpp"
 
 #define DEBUG (0)
 
+/* Traceback bits of each cell */
+#define TRACE_H_MASK	(0x3)	/* origin of H: 0 (diagonal), 1 (E) or 2 (F) */
+#define TRACE_E_OPEN	(0x4)	/* E was opened from the H cell above */
+#define TRACE_F_OPEN	(0x8)	/* F was opened from the H cell at the left */
+
 static int dna_gap_first;
 static int dna_gap_open;
 static int dna_gap_ext;
 static int dna_match;
 static int dna_mismatch;
 
+/**
+ * Buffers of the banded DP, reused by all the partitions. Only the cells
+ * inside the band of each row are computed, keeping two rows of scores and
+ * 4 traceback bits per cell (two cells per byte).
+ */
+struct band_buffers_t {
+	vector<int> h0;
+	vector<int> h1;
+	vector<int> e0;
+	vector<int> e1;
+	/* band [lo,hi] of each row */
+	vector<int> lo;
+	vector<int> hi;
+	/* position of the first cell of each row in the traceback matrix */
+	vector<long long> offset;
+	vector<unsigned char> trace;
+
+	/* statistics */
+	long long bandCells;
+	long long fullCells;
+	int retries;
+
+	band_buffers_t() {
+		bandCells = 0;
+		fullCells = 0;
+		retries = 0;
+	}
+};
+
 struct total_score_t {
 	int score;
 	int matches;
@@ -63,8 +92,33 @@ struct total_score_t {
 };
 
 
+/**
+ * Gaps found by the traceback of one partition. The runs are merged in the
+ * same way of Alignment::addGap, so that the partitions can be traced in
+ * any order and stitched into the Alignment in crosspoint order.
+ */
+struct partition_gaps_t {
+	vector<gap_t> gaps[2];
+
+	void addGapInSeq0(int i) {
+		addGap(0, i);
+	}
+
+	void addGapInSeq1(int j) {
+		addGap(1, j);
+	}
+
+	void addGap(int seq, int pos) {
+		if (gaps[seq].size() != 0 && gaps[seq].back().pos == pos) {
+			gaps[seq].back().len++;
+		} else {
+			gaps[seq].push_back(gap_t(pos, 1));
+		}
+	}
+};
+
 // i,j 1-based
-static void dot(Alignment* alignment, Sequence *seq0, Sequence *seq1, int i, int j, int type) {
+static void dot(partition_gaps_t* alignment, Sequence *seq0, Sequence *seq1, int i, int j, int type) {
     //int pt;
     const char* s0 = seq0->getData()-1;
     const char* s1 = seq1->getData()-1;
@@ -82,8 +136,232 @@ static void dot(Alignment* alignment, Sequence *seq0, Sequence *seq1, int i, int
     }
 }
 
+/*
+ * Upper bound of the score of any path crossing di rows and dj columns,
+ * given the best substitution score. It is valid for any non-negative gap
+ * penalties.
+ */
+static long long path_bound(long long di, long long dj, int best) {
+    if (di < dj) {
+        return best*di - dna_gap_ext*(dj-di);
+    } else {
+        return best*dj - dna_gap_ext*(di-dj);
+    }
+}
+
+/*
+ * Upper bound of the score of any path from (0,0) to (rows,cols) crossing
+ * the cell (i,j).
+ */
+static long long cell_bound(int i, int j, int rows, int cols, int best) {
+    return path_bound(i, j, best) + path_bound(rows-i, cols-j, best);
+}
+
+/*
+ * Computes the band [lo,hi] of row i, that is, the columns whose bound is
+ * not lower than the threshold. Cells outside the band cannot belong to a
+ * path with score greater than or equal to the threshold. Since the bound is
+ * concave, the band is an interval around the diagonal, shifted by the
+ * drift of the partition. If the band is empty, lo > hi.
+ */
+static void row_band(int i, int rows, int cols, int best, long long threshold, int* lo, int* hi) {
+    /* ternary search of the column with the highest bound */
+    int a = 0;
+    int b = cols;
+    while (b-a > 2) {
+        int m1 = a + (b-a)/3;
+        int m2 = b - (b-a)/3;
+        if (cell_bound(i, m1, rows, cols, best) < cell_bound(i, m2, rows, cols, best)) {
+            a = m1+1;
+        } else {
+            b = m2;
+        }
+    }
+    int top = a;
+    for (int j=a+1; j<=b; j++) {
+        if (cell_bound(i, j, rows, cols, best) > cell_bound(i, top, rows, cols, best)) {
+            top = j;
+        }
+    }
+    if (cell_bound(i, top, rows, cols, best) < threshold) {
+        *lo = 1;
+        *hi = 0;
+        return;
+    }
+
+    /* the bound is non-decreasing at the left of top */
+    a = 0;
+    b = top;
+    while (a < b) {
+        int m = (a+b)/2;
+        if (cell_bound(i, m, rows, cols, best) >= threshold) {
+            b = m;
+        } else {
+            a = m+1;
+        }
+    }
+    *lo = a;
+
+    /* the bound is non-increasing at the right of top */
+    a = top;
+    b = cols;
+    while (a < b) {
+        int m = (a+b+1)/2;
+        if (cell_bound(i, m, rows, cols, best) >= threshold) {
+            a = m;
+        } else {
+            b = m-1;
+        }
+    }
+    *hi = a;
+}
+
+static inline int trace_get(const band_buffers_t* buffers, int i, int j) {
+    if (j < buffers->lo[i] || j > buffers->hi[i]) {
+        fprintf(stderr, "stage5: Traceback out of the band (%d,%d).\n", i, j);
+        exit(1);
+    }
+    long long pos = buffers->offset[i] + (j - buffers->lo[i]);
+    return (buffers->trace[pos>>1] >> ((pos&1)*4)) & 0xF;
+}
+
+/*
+ * Fills the DP matrix of the partition inside the band of the given
+ * threshold, storing the traceback bits of each cell. The cells outside
+ * the band are considered -INF. Rows and columns are 1-based, and s0 and s1
+ * are the chars of the first row and column.
+ *
+ * @return the score of the cell (rows,cols) in the component of type_e.
+ */
+static int band_fill(band_buffers_t* buffers, const char* s0, const char* s1,
+        int rows, int cols, int type_s, int type_e, int threshold) {
+    int best = MAX(dna_match, dna_mismatch);
+    if (best < 0) best = 0;
+    bool banded = (threshold > -INF && dna_gap_ext >= 0 && dna_gap_open >= 0);
+
+    buffers->lo.resize(rows+1);
+    buffers->hi.resize(rows+1);
+    buffers->offset.resize(rows+1);
+    long long total = 0;
+    for (int i=0; i<=rows; i++) {
+        if (banded) {
+            row_band(i, rows, cols, best, threshold, &buffers->lo[i], &buffers->hi[i]);
+        } else {
+            buffers->lo[i] = 0;
+            buffers->hi[i] = cols;
+        }
+        buffers->offset[i] = total;
+        if (buffers->hi[i] >= buffers->lo[i]) {
+            total += buffers->hi[i] - buffers->lo[i] + 1;
+        }
+    }
+    long long bytes = (total+1)/2;
+    if (buffers->trace.size() < (size_t)bytes) {
+        buffers->trace.resize(bytes);
+    }
+    if (bytes > 0) {
+        memset(&buffers->trace[0], 0, bytes);
+    }
+    buffers->bandCells += total;
+    buffers->fullCells += (rows+1LL)*(cols+1LL);
+
+    buffers->h0.resize(cols+1);
+    buffers->h1.resize(cols+1);
+    buffers->e0.resize(cols+1);
+    buffers->e1.resize(cols+1);
+    int* hp = &buffers->h1[0];
+    int* ep = &buffers->e1[0];
+    int* hc = &buffers->h0[0];
+    int* ec = &buffers->e0[0];
+    unsigned char* trace = bytes > 0 ? &buffers->trace[0] : NULL;
+
+    int score = -INF;
+
+    for (int j=buffers->lo[0]; j<=buffers->hi[0]; j++) {
+        if (j == 0) {
+            hc[0] = (type_s!=0?-INF:0);
+            ec[0] = (type_s!=1?-INF:0);
+        } else {
+            hc[j] = -j*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_1);
+            ec[j] = -INF;
+        }
+    }
+
+    for (int i=1; i<=rows; i++) {
+        int* tmp;
+        tmp = hp; hp = hc; hc = tmp;
+        tmp = ep; ep = ec; ec = tmp;
+
+        const int lo = buffers->lo[i];
+        const int hi = buffers->hi[i];
+        if (lo > hi) continue;
+
+        /* the cells of the previous row outside its band are -INF */
+        int plo = buffers->lo[i-1];
+        int phi = buffers->hi[i-1];
+        if (plo > phi) {
+            plo = cols+1;
+            phi = cols;
+        }
+        for (int j=MAX(lo-1, 0); j<=hi && j<plo; j++) {
+            hp[j] = -INF;
+            ep[j] = -INF;
+        }
+        for (int j=MAX(MAX(lo-1, 0), phi+1); j<=hi; j++) {
+            hp[j] = -INF;
+            ep[j] = -INF;
+        }
+
+        const char s=s0[i-1];
+        long long pos = buffers->offset[i];
+        int j = lo;
+        int h_left = -INF;
+        int f0 = -INF;
+        if (j == 0) {
+            h_left = hc[0] = -i*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_2);
+            ec[0] = -INF;
+            pos++;
+            j++;
+        }
+        for (; j<=hi; j++) {
+            int e0 = MAX(hp[j]-dna_gap_first, ep[j]-dna_gap_ext);
+            f0 = MAX(h_left-dna_gap_first, f0-dna_gap_ext);
+            int h11 = hp[j-1]+((s==s1[j-1])?dna_match:dna_mismatch);
+            int h0 = MAX3(h11, e0, f0);
+
+            int t;
+            if (h0 == h11) {
+                t = 0;
+            } else if (h0 == e0) {
+                t = 1;
+            } else {
+                t = 2;
+            }
+            if (e0 == hp[j]-dna_gap_first) t |= TRACE_E_OPEN;
+            if (f0 == h_left-dna_gap_first) t |= TRACE_F_OPEN;
+            trace[pos>>1] |= t << ((pos&1)*4);
+            pos++;
+
+            hc[j] = h0;
+            ec[j] = e0;
+            h_left = h0;
+        }
+
+        if (i == rows && cols >= lo && cols <= hi) {
+            if (type_e == TYPE_GAP_2) {
+                score = ec[cols];
+            } else if (type_e == TYPE_GAP_1) {
+                score = f0;
+            } else {
+                score = hc[cols];
+            }
+        }
+    }
+    return score;
+}
+
 // i0, j0, i1, j1: input as 0 based. Alignment includes (i0,j0) and excludes (i1,j1).
-static int sw(Alignment* alignment, Sequence *seq0, Sequence *seq1, int i0, int j0, int i1, int j1, int type_s, int type_e, total_score_t* sum_score) {
+static int sw(partition_gaps_t* alignment, Sequence *seq0, Sequence *seq1, int i0, int j0, int i1, int j1, int type_s, int type_e, int goal, band_buffers_t* buffers, total_score_t* sum_score) {
     if (i0 == i1) {
     	int sum = (j1-j0)*-dna_gap_ext;
     	if (type_s != TYPE_GAP_1) {
@@ -114,148 +392,67 @@ static int sw(Alignment* alignment, Sequence *seq0, Sequence *seq1, int i0, int
 	i0++;
     j0++;
 
-    // TODO conferir
-    if (type_e == 0) {
-        j1++;
-        i1++;
-    } else if (type_e == TYPE_GAP_2) {
-        //j1++;
-    }
-
     // Now i0,j0,i1,j1 are 1-based
 
     if (DEBUG) printf("%d %d %d %d %d %d\n", i0, j0, i1, j1, type_s, type_e);
 
+    /* the traceback starts at cell (seq0_len,seq1_len) */
     int seq0_len = i1-i0+1;
     int seq1_len = j1-j0+1;
 
-
     const char* s0 = seq0->getData()+(i0-1);
     const char* s1 = seq1->getData()+(j0-1);
 
-    for (int j=1; j<=seq1_len; j++) {
-        h[0][j] = -j*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_1);
-        e[0][j] = -INF;
-    }
-    h[0][0] = (type_s!=0?-INF:0);
-    e[0][0] = (type_s!=1?-INF:0);
-
-    for (int i=1; i<=seq0_len; i++) {
-        h[i][0] = -i*dna_gap_ext - dna_gap_open*(type_s!=TYPE_GAP_2);
-        f[i][0] = -INF;
-        const char s=s0[i-1];
-
-        int* h0 = h[i];
-        int* h1 = h[i-1];
-        int* e0 = e[i];
-        int* e1 = e[i-1];
-        int* f0 = f[i];
-        for (int j=1; j<=seq1_len; j++) {
-            e0[j] = MAX(h1[j]-dna_gap_first, e1[j]-dna_gap_ext);
-            f0[j] = MAX(h0[j-1]-dna_gap_first, f0[j-1]-dna_gap_ext);
-            h0[j] = MAX3(h1[j-1]+((s==s1[j-1])?dna_match:dna_mismatch), e0[j], f0[j]);
-        }
-        //printf("\nj:%4d %c SW: %4d\n", j1-j, s1[j-1], h[j][seq0_len]);
+    /*
+     * The band is first derived from the score difference of the
+     * crosspoints. If it was too narrow, the DP is repeated with the band
+     * derived from the score found inside the first band, that is always
+     * wide enough.
+     */
+    int threshold = goal - 2*dna_gap_first;
+    int score = band_fill(buffers, s0, s1, seq0_len, seq1_len, type_s, type_e, threshold);
+    if (score < threshold) {
+        buffers->retries++;
+        threshold = (score > -INF) ? score : -INF;
+        score = band_fill(buffers, s0, s1, seq0_len, seq1_len, type_s, type_e, threshold);
     }
 
-    if (false && DEBUG) {
-        printf("%8s:\t.\t", "HEADER");
-        for (int j=0; j<=seq1_len; j++) {
-            printf("%c(%2d)\t", j==0?'*':s1[j-1], (j+j0-1)%100);
-        }
-        printf("\n");
-        for (int i=0; i<=seq0_len; i++) {
-            printf("%8d:\t%c\t", i+i0-1, i==0?'*':s0[i-1]);
-            for (int j=0; j<=seq1_len; j++) {
-                int v=h[i][j];
-                if (v <= -INF) {
-                    printf("%5s\t", "INF");
-                } else {
-                    printf("%5d\t", v);
-                }
-            }
-            printf("\n");
-        }
-    }
-
-
-    int sum = 0;
     int i=seq0_len;
     int j=seq1_len;
-    int score;
     int c;
-    
-    score = h[seq0_len][seq1_len];
-    if (type_e==0) {
-        i--;
-        j--;
-        c=TYPE_MATCH;
-    } else if (type_e==TYPE_GAP_2) {
-        score -= dna_gap_open;
-        int ss = e[seq0_len][seq1_len];
-        if (true || ss >= score) { // TODO validar esse if
-            score = ss;
-            c=TYPE_GAP_2;
-        } else {
-            c=TYPE_MATCH;
-        }
+
+    if (type_e==TYPE_GAP_2) {
+        c=TYPE_GAP_2;
     } else if (type_e==TYPE_GAP_1) {
-        score -= dna_gap_open;
-        int ss = f[seq0_len][seq1_len];
-        if (true || ss > score) { // TODO validar esse if
-            score = ss;
-            c=TYPE_GAP_1;
-        } else {
-            c=TYPE_MATCH;
-        }
+        c=TYPE_GAP_1;
+    } else {
+        c=TYPE_MATCH;
     }
 
     if (DEBUG) printf ("Score: %5d %d%d\n", score, type_s, type_e);
 
+    int sum = 0;
     while (i>0 && j>0) {
 
         int dir;
 
-        int _eh = h[i-1][j]-dna_gap_first;
-        int _fh = h[i][j-1]-dna_gap_first;
-        int _h11 = h[i-1][j-1]+((s0[i-1]==s1[j-1])?dna_match:dna_mismatch);
-        int _h10 = e[i][j];
-        int _h01 = f[i][j];
-        int _h00 = h[i][j];
+        int t = trace_get(buffers, i, j);
 
         if (c==0) {
-            if (_h00 == _h11) {
-                dir = 0;
-                c=TYPE_MATCH;
-            } else if (_h00 == _h10) {
-                dir = 1;
-                if (_h10==_eh) {
-                    c=TYPE_MATCH;
-                } else {
-                    c=TYPE_GAP_2;
-                }
-            } else if (_h00 == _h01) {
-                dir = 2;
-                if (_h01==_fh) {
-                    c=TYPE_MATCH;
-                } else {
-                    c=TYPE_GAP_1;
-                }
-            }             
-        } else if (c==TYPE_GAP_2) {
-            dir = 1;
-            if (_h10==_eh) {
+            dir = t & TRACE_H_MASK;
+            if (dir == 0) {
                 c=TYPE_MATCH;
+            } else if (dir == 1) {
+                c=(t & TRACE_E_OPEN) ? TYPE_MATCH : TYPE_GAP_2;
             } else {
-                c=TYPE_GAP_2;
+                c=(t & TRACE_F_OPEN) ? TYPE_MATCH : TYPE_GAP_1;
             }
+        } else if (c==TYPE_GAP_2) {
+            dir = 1;
+            c=(t & TRACE_E_OPEN) ? TYPE_MATCH : TYPE_GAP_2;
         } else if (c==TYPE_GAP_1) {
             dir = 2;
-            if (_h01==_fh) {
-                c=TYPE_MATCH;
-            } else {
-                c=TYPE_GAP_1;
-            }
+            c=(t & TRACE_F_OPEN) ? TYPE_MATCH : TYPE_GAP_1;
         }
 
         int pt=0;
@@ -319,6 +516,79 @@ static int sw(Alignment* alignment, Sequence *seq0, Sequence *seq1, int i0, int
 }
 
 
+/*
+ * Partitions shared by the stage 5 threads. The result of partition k
+ * (between the crosspoints k-1 and k) is stored in gaps[k] and scores[k].
+ */
+struct stage5_queue_t {
+	Sequence* seq0;
+	Sequence* seq1;
+	const CrosspointsFile* crosspoints;
+	vector<partition_gaps_t> gaps;
+	vector<total_score_t> scores;
+	size_t next;
+	int count;
+	pthread_mutex_t mutex;
+};
+
+struct stage5_worker_arg_t {
+	stage5_queue_t* queue;
+	band_buffers_t* buffers;
+	int partitions;
+};
+
+/*
+ * Takes the next chunk [k0..k1) of partitions. The chunks get smaller
+ * as the queue is consumed.
+ */
+static bool next_partitions(stage5_queue_t* queue, size_t* k0, size_t* k1) {
+	pthread_mutex_lock(&queue->mutex);
+	if (queue->next >= queue->crosspoints->size()) {
+		pthread_mutex_unlock(&queue->mutex);
+		return false;
+	}
+	size_t remaining = queue->crosspoints->size() - queue->next;
+	size_t chunk = remaining/(2*queue->count);
+	if (chunk < 1) {
+		chunk = 1;
+	}
+	*k0 = queue->next;
+	*k1 = queue->next + chunk;
+	queue->next = *k1;
+	pthread_mutex_unlock(&queue->mutex);
+	return true;
+}
+
+static void process_partitions(stage5_worker_arg_t* arg) {
+	stage5_queue_t* queue = arg->queue;
+	size_t k0, k1;
+	while (next_partitions(queue, &k0, &k1)) {
+		for (size_t k=k0; k<k1; k++) {
+			crosspoint_t m0 = queue->crosspoints->at(k-1);
+			crosspoint_t m1 = queue->crosspoints->at(k);
+
+			int sum = sw(&queue->gaps[k], queue->seq0, queue->seq1, m0.i, m0.j, m1.i, m1.j,
+					m0.type, m1.type, m1.score-m0.score, arg->buffers, &queue->scores[k]);
+
+			if (DEBUG) printf("> SW   %5d\n", sum);
+			if (DEBUG) {
+				int goal_diff = (m1.score) - (m0.score);
+				if (goal_diff!=sum) {
+					fprintf(stderr, "[%s] GOAL DIFF: %8d   SUM: %8d   (%d,%d,%d)-(%d,%d,%d)\n", goal_diff==sum?"OK":"ERROR", goal_diff, sum,
+							m0.i, m0.j, m0.type, m1.i, m1.j, m1.type);
+					exit(1);
+				}
+			}
+		}
+		arg->partitions += (int)(k1-k0);
+	}
+}
+
+static void* stage5_worker_thread(void* arg) {
+	process_partitions((stage5_worker_arg_t*)arg);
+	return NULL;
+}
+
 int stage5(Job* job, int id) {
 	FILE* stats = job->fopenStatistics(STAGE_5, id);
 	Sequence* seq0 = job->getAlignmentParams()->getSequence(0);
@@ -376,50 +646,94 @@ int stage5(Job* job, int id) {
 
 	timer2.eventRecord(ev_msgs);
 
-	crosspoint_t m0 = stage4Crosspoints->front();
-	
 	Alignment* alignment = new Alignment(job->getAlignmentParams());
 
-    int partition_id = 1;
-
-
     int max_size = stage4Crosspoints->getLargestPartitionSize();
-    if (max_size > W_MAX || max_size > H_MAX) {
-        fprintf(stderr, "ERROR: MAX SIZE: %d\n", max_size);
-        exit(1);
-    }
     fprintf(stats, "Largest Block: %d\n", max_size);
 
 
 	timer2.eventRecord(ev_start);
 
-	
-	total_score_t sum_score;
-    for (; partition_id<stage4Crosspoints->size(); partition_id++) {
-        crosspoint_t m1 = stage4Crosspoints->at(partition_id);
-
-        //if (curr.i == 0 && curr.j == 0) break;
-
-        int sum = sw(alignment, seq0, seq1, m0.i, m0.j, m1.i, m1.j, m0.type, m1.type, &sum_score);
-		
-        //score += sum;
-        if (DEBUG) printf("> SW   %5d/%d\n", sum, sum_score.score);
-        if (DEBUG) {
-			int goal_diff = (m1.score) - (m0.score);
-            if (goal_diff!=sum) {
-                fprintf(stderr, "[%s] GOAL DIFF: %8d   SUM: %8d   (%d,%d,%d)-(%d,%d,%d)\n", goal_diff==sum?"OK":"ERROR", goal_diff, sum,
-                        m0.i, m0.j, m0.type, m1.i, m1.j, m1.type);
-                exit(1);
-            }
-        }
+	stage5_queue_t queue;
+	queue.seq0 = seq0;
+	queue.seq1 = seq1;
+	queue.crosspoints = stage4Crosspoints;
+	queue.next = 1;
+	queue.gaps.resize(stage4Crosspoints->size());
+	queue.scores.resize(stage4Crosspoints->size());
+	pthread_mutex_init(&queue.mutex, NULL);
+
+	int threads = job->configs->getWorkers(STAGE_5);
+	if (threads < 1) {
+		threads = 1;
+	}
+	int partitions = stage4Crosspoints->size()-1;
+	if (threads > partitions) {
+		threads = MAX(partitions, 1);
+	}
+	queue.count = threads;
+	fprintf(stats, "Threads: %d\n", threads);
+
+	vector<band_buffers_t> buffers(threads);
+	vector<stage5_worker_arg_t> args(threads);
+	vector<pthread_t> workers(threads);
+	for (int k=0; k<threads; k++) {
+		args[k].queue = &queue;
+		args[k].buffers = &buffers[k];
+		args[k].partitions = 0;
+		if (k == 0) {
+			continue;
+		}
+		int rc = pthread_create(&workers[k], NULL, stage5_worker_thread, (void*)&args[k]);
+		if (rc) {
+			fprintf(stderr, "Stage5: pthread_create() returned %d\n", rc);
+			exit(1);
+		}
+	}
+	/* the main thread is the worker 0 */
+	process_partitions(&args[0]);
+	for (int k=1; k<threads; k++) {
+		pthread_join(workers[k], NULL);
+	}
+	pthread_mutex_destroy(&queue.mutex);
 
-        if (DEBUG) printf("\n");
+	/* stitches the partitions in crosspoint order */
+	total_score_t sum_score;
+	for (size_t k=1; k<stage4Crosspoints->size(); k++) {
+		const total_score_t& partial = queue.scores[k];
+		sum_score.score += partial.score;
+		sum_score.matches += partial.matches;
+		sum_score.mismatches += partial.mismatches;
+		sum_score.gapOpen += partial.gapOpen;
+		sum_score.gapExtensions += partial.gapExtensions;
+
+		for (int seq=0; seq<2; seq++) {
+			const vector<gap_t>& gaps = queue.gaps[k].gaps[seq];
+			for (size_t g=0; g<gaps.size(); g++) {
+				for (int l=0; l<gaps[g].len; l++) {
+					if (seq == 0) {
+						alignment->addGapInSeq0(gaps[g].pos);
+					} else {
+						alignment->addGapInSeq1(gaps[g].pos);
+					}
+				}
+			}
+		}
+		queue.gaps[k] = partition_gaps_t();
+	}
 
-        m0 = m1;
-    }
-    // TODO efetuar um sanity check no score/sum. Esse valor deve ser identico ao stage1.
+	band_buffers_t total;
+	for (int k=0; k<threads; k++) {
+		total.bandCells += buffers[k].bandCells;
+		total.fullCells += buffers[k].fullCells;
+		total.retries += buffers[k].retries;
+		fprintf(stats, "Thread %2d: partitions: %8d\n", k, args[k].partitions);
+	}
 
 	timer2.eventRecord(ev_step);
+
+	fprintf(stats, "Band cells: %lld/%lld (%.2f%%)  retries: %d\n", total.bandCells, total.fullCells,
+			total.fullCells > 0 ? 100.0*total.bandCells/total.fullCells : 0.0, total.retries);
 	
     crosspoint_t start = stage4Crosspoints->front();
     crosspoint_t end = stage4Crosspoints->back();
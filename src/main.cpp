@@ -20,7 +20,11 @@
  ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "libmasa/libmasa.hpp"
+#include "libmasa/aligners/CPUBlockAligner.hpp"
+#include "libmasa/aligners/CPUDiagonalAligner.hpp"
 #include "config.h"
 #include "CUDAligner.hpp"
 
@@ -30,6 +34,40 @@
 #define HEADER 		PACKAGE_STRING"  -  GPU tool for huge sequences alignment\033[0m\n"
 
 
+/**
+ * Creates the CPU aligner selected by the --cpu[=block|diagonal] and
+ * --cpu-threads=COUNT options, removing them from argv, so nodes without
+ * a GPU can execute the stages. Returns NULL if --cpu was not given.
+ */
+static IAligner* createCPUAligner(int* argc, char** argv) {
+     const char* type = NULL;
+     int threads = 0; // one thread per online processor
+     int count = 1;
+     for (int k = 1; k < *argc; k++) {
+          if (strcmp(argv[k], "--cpu") == 0) {
+               type = "block";
+          } else if (strncmp(argv[k], "--cpu=", 6) == 0) {
+               type = argv[k] + 6;
+          } else if (strncmp(argv[k], "--cpu-threads=", 14) == 0) {
+               threads = atoi(argv[k] + 14);
+          } else {
+               argv[count++] = argv[k];
+          }
+     }
+     argv[count] = NULL;
+     *argc = count;
+
+     if (type == NULL) {
+          return NULL;
+     } else if (strcmp(type, "block") == 0) {
+          return new CPUBlockAligner(NULL, NULL, threads);
+     } else if (strcmp(type, "diagonal") == 0) {
+          return new CPUDiagonalAligner(NULL, NULL, threads);
+     }
+     fprintf(stderr, "Unknown CPU aligner: --cpu=%s (use block or diagonal).\n", type);
+     exit(1);
+}
+
 /**
  * C entry point.
  *
@@ -38,5 +76,9 @@
  * @return return code.
  */
 int main ( int argc, char** argv ) {
+     IAligner* aligner = createCPUAligner(&argc, argv);
+     if (aligner != NULL) {
+          return libmasa_entry_point(argc, argv, aligner, (char*)PACKAGE_STRING"  -  CPU aligner\033[0m\n");
+     }
      return libmasa_entry_point(argc, argv, new CUDAligner(), HEADER);
 }